@@ -10,10 +10,14 @@
 #include "cliInterface.h"
 #include "jungle.h"
 #include "jungleTrain.h"
+#include "featureShards.h"
+#include "columnStore.h"
 #include <iostream>
 #include <iomanip>
 #include <random>
 #include <exception>
+#include <sstream>
+#include <cstdlib>
 #include <boost/timer.hpp>
 
 
@@ -26,6 +30,10 @@ AbstractCLIFunction::Factory::ClassMap AbstractCLIFunction::Factory::functionMap
 AbstractCLIFunction::RegisterFunction<HelpCLIFunction> HelpCLIFunction::reg("help");
 AbstractCLIFunction::RegisterFunction<ClassifyCLIFunction> ClassifyCLIFunction::reg("classify");
 AbstractCLIFunction::RegisterFunction<TrainCLIFunction> TrainCLIFunction::reg("train");
+AbstractCLIFunction::RegisterFunction<WorkerCLIFunction> WorkerCLIFunction::reg("worker");
+AbstractCLIFunction::RegisterFunction<ShardCLIFunction> ShardCLIFunction::reg("shard");
+AbstractCLIFunction::RegisterFunction<RefitCLIFunction> RefitCLIFunction::reg("refit");
+AbstractCLIFunction::RegisterFunction<MergeCLIFunction> MergeCLIFunction::reg("merge");
 AbstractCLIFunction::RegisterFunction<VersionCLIFunction> VersionCLIFunction::reg("version");
 
 int main(int argc, const char** argv)
@@ -263,7 +271,7 @@ void TrainCLIFunction::loadParametersToTrainer(JungleTrainer::ptr _trainer)
                 break;
                 
             case 'N':
-                _trainer->setNumTrainingSamples(ParameterConverter::getInt(it->second));
+                _trainer->setNumTrainingSamples(ParameterConverter::getCount(it->second));
                 break;
             
             case 'F':
@@ -309,6 +317,115 @@ void TrainCLIFunction::loadParametersToTrainer(JungleTrainer::ptr _trainer)
             case 'p':
                 showProgressBars = ParameterConverter::getBool(it->second);
                 break;
+                
+            case 'H':
+                _trainer->setUseHugePages(ParameterConverter::getBool(it->second));
+                break;
+                
+            case 'E':
+                _trainer->setEarlyStoppingWindow(ParameterConverter::getInt(it->second));
+                break;
+                
+            case 'e':
+                _trainer->setEarlyStoppingTolerance(ParameterConverter::getFloat(it->second));
+                break;
+                
+            case 't':
+                _trainer->setTimeBudget(ParameterConverter::getFloat(it->second));
+                break;
+                
+            case 'k':
+                _trainer->setKeepInterruptedDAGs(ParameterConverter::getBool(it->second));
+                break;
+                
+            case 'c':
+                _trainer->setCheckpointFileName(it->second);
+                break;
+                
+            case 'r':
+                _trainer->setResume(ParameterConverter::getBool(it->second));
+                break;
+                
+            case 'S':
+                streamModel = ParameterConverter::getBool(it->second);
+                break;
+                
+            case 'i':
+                initialModelFileName = it->second;
+                break;
+                
+            case 's':
+                _trainer->setSeed(ParameterConverter::getInt(it->second));
+                break;
+                
+            case 'l':
+                listenAddress = it->second;
+                break;
+                
+            case 'f':
+                featureShardCount = ParameterConverter::getInt(it->second);
+                break;
+                
+            case 'w':
+                workerTimeout = ParameterConverter::getFloat(it->second);
+                break;
+                
+            case 'x':
+                columnDirectory = it->second;
+                break;
+                
+            case 'm':
+                columnMemoryBudget = ParameterConverter::getInt(it->second);
+                break;
+                
+            case 'O':
+                _trainer->setOutOfBagLevel(ParameterConverter::getInt(it->second));
+                break;
+                
+            case 'Q':
+                _trainer->setFeatureBinCount(ParameterConverter::getInt(it->second));
+                break;
+                
+            case 'C':
+                switch (ParameterConverter::getChar(it->second))
+                {
+                    case 'e':
+                    case 'E':
+                        _trainer->setSplitCriterion(SplitCriterionEntropy);
+                        break;
+                        
+                    case 'g':
+                    case 'G':
+                        _trainer->setSplitCriterion(SplitCriterionGini);
+                        break;
+                        
+                    default:
+                        throw ConfigurationException("Unknown split criterion. Use entropy or gini.");
+                }
+                break;
+                
+            case 'L':
+                switch (ParameterConverter::getChar(it->second))
+                {
+                    case 'n':
+                    case 'N':
+                        _trainer->setFeatureSampling(FeatureSamplingNode);
+                        break;
+                        
+                    case 'l':
+                    case 'L':
+                        _trainer->setFeatureSampling(FeatureSamplingLevel);
+                        break;
+                        
+                    case 'i':
+                    case 'I':
+                        _trainer->setFeatureSampling(FeatureSamplingIteration);
+                        break;
+                        
+                    default:
+                        throw ConfigurationException("Unknown feature sampling. Use node, level or iteration.");
+                }
+                break;
         }
         
         validationLevel = std::max(std::abs(validationLevel), 0);
@@ -328,6 +445,13 @@ int TrainCLIFunction::execute()
     showProgressBars = true;
     dumpSettings = false;
     validationLevel = 0;
+    streamModel = false;
+    initialModelFileName = "";
+    listenAddress = "";
+    featureShardCount = 0;
+    workerTimeout = 0;
+    columnDirectory = "";
+    columnMemoryBudget = 256;
     
     // There must be a model file and a training set
     if (getArguments()->getArguments().size() != 2)
@@ -345,6 +469,13 @@ int TrainCLIFunction::execute()
     jungleTrainer->setVerboseMode(true);
     loadParametersToTrainer(jungleTrainer);
     
+    // When streaming, the model file is the checkpoint file and the DAGs are not kept in memory
+    if (streamModel)
+    {
+        jungleTrainer->setCheckpointFileName(getArguments()->getArguments().at(1));
+        jungleTrainer->setKeepDAGs(false);
+    }
+    
     if (dumpSettings)
     {
         std::cout << "Settings dump:" << std::endl;
@@ -356,14 +487,102 @@ int TrainCLIFunction::execute()
         std::cout << "numDAGs " << jungleTrainer->getNumDAGs() << std::endl;
         std::cout << "numTrainingSamples " << jungleTrainer->getNumTrainingSamples() << std::endl;
         std::cout << "maxParallel " << jungleTrainer->getMaxParallel() << std::endl;
-        std::cout << "sortParentNodes " << jungleTrainer->getSortParentNodes() << std::endl << std::endl;
+        std::cout << "sortParentNodes " << jungleTrainer->getSortParentNodes() << std::endl;
+        std::cout << "useHugePages " << jungleTrainer->getUseHugePages() << std::endl;
+        std::cout << "outOfBagLevel " << jungleTrainer->getOutOfBagLevel() << std::endl;
+        std::cout << "earlyStoppingWindow " << jungleTrainer->getEarlyStoppingWindow() << std::endl;
+        std::cout << "earlyStoppingTolerance " << jungleTrainer->getEarlyStoppingTolerance() << std::endl;
+        std::cout << "timeBudget " << jungleTrainer->getTimeBudget() << std::endl;
+        std::cout << "keepInterruptedDAGs " << jungleTrainer->getKeepInterruptedDAGs() << std::endl;
+        std::cout << "checkpointFileName " << jungleTrainer->getCheckpointFileName() << std::endl;
+        std::cout << "resume " << jungleTrainer->getResume() << std::endl;
+        std::cout << "streamModel " << streamModel << std::endl;
+        std::cout << "initialModel " << initialModelFileName << std::endl;
+        std::cout << "seed " << jungleTrainer->getSeed() << std::endl;
+        std::cout << "listen " << listenAddress << std::endl;
+        std::cout << "featureShards " << featureShardCount << std::endl;
+        std::cout << "workerTimeout " << workerTimeout << std::endl;
+        std::cout << "columnDirectory " << columnDirectory << std::endl;
+        std::cout << "columnMemoryBudget " << columnMemoryBudget << std::endl;
+        std::cout << "splitCriterion " << (jungleTrainer->getSplitCriterion() == SplitCriterionGini ? "gini" : "entropy") << std::endl;
+        std::cout << "featureSampling " << (jungleTrainer->getFeatureSampling() == FeatureSamplingLevel ? "level" : 
+                (jungleTrainer->getFeatureSampling() == FeatureSamplingIteration ? "iteration" : "node")) << std::endl;
+        std::cout << "featureBins " << jungleTrainer->getFeatureBinCount() << std::endl;
+        std::cout << "entropyKernels " << EntropyKernels::getInstructionSet() << std::endl << std::endl;
     }
     
-    // Load the training set
+    // The workers and the feature shards load the training set themselves
+    std::string trainingSetPath = getArguments()->getArguments().at(0);
+    char* path = realpath(trainingSetPath.c_str(), 0);
+    if (path != 0)
+    {
+        trainingSetPath = path;
+        free(path);
+    }
+    
+    if (columnDirectory.size() > 0)
+    {
+        if (featureShardCount > 0 || listenAddress.size() > 0)
+        {
+            std::cout << "Out-of-core training (-x) cannot be combined with -l or -f." << std::endl;
+            delete jungleTrainer;
+            return 1;
+        }
+        
+        ColumnStore::ptr columnStore = ColumnStore::Factory::create(trainingSetPath, columnDirectory, 
+                static_cast<size_t>(std::max(1, columnMemoryBudget)) << 20);
+        columnStore->setVerboseMode(showProgressBars);
+        jungleTrainer->setFeatureColumns(columnStore);
+    }
+    else if (featureShardCount > 0)
+    {
+        if (listenAddress.size() == 0)
+        {
+            std::cout << "Feature shards require a coordinator address (-l)." << std::endl;
+            delete jungleTrainer;
+            return 1;
+        }
+        
+        FeatureShardCoordinator::ptr featureShards = FeatureShardCoordinator::Factory::create(listenAddress, featureShardCount, trainingSetPath);
+        featureShards->setVerboseMode(true);
+        jungleTrainer->setFeatureColumns(featureShards);
+    }
+    else if (listenAddress.size() > 0)
+    {
+        // The workers use the same parameters
+        std::ostringstream configuration;
+        configuration << trainingSetPath << '\n';
+        
+        std::map<std::string, std::string> & parameters = getArguments()->getParameters();
+        for (std::map<std::string, std::string>::iterator it = parameters.begin(); it != parameters.end(); ++it)
+        {
+            configuration << it->first << '=' << it->second << '\n';
+        }
+        
+        Coordinator::ptr coordinator = Coordinator::Factory::create(listenAddress, configuration.str());
+        coordinator->setVerboseMode(true);
+        
+        // Every DAG is handed out with the time that remains of the budget and its worker stops at the deadline. A 
+        // worker that has not sent its DAG another time budget after the deadline is lost
+        coordinator->setWorkerTimeout(workerTimeout > 0 ? workerTimeout : jungleTrainer->getTimeBudget());
+        jungleTrainer->setCoordinator(coordinator);
+    }
+    
+    // Load the training set. The feature columns are held by the feature shards or the column store
     std::cout << "Loading training set" << std::endl;
-    TrainingSet::ptr trainingSet = TrainingSet::Factory::createFromFile(getArguments()->getArguments().at(0), showProgressBars);
+    const bool externalColumns = featureShardCount > 0 || columnDirectory.size() > 0;
+    TrainingSet::ptr trainingSet = externalColumns ? 
+            TrainingSet::Factory::createFromFile(getArguments()->getArguments().at(0), showProgressBars, std::vector<int>()) :
+            TrainingSet::Factory::createFromFile(getArguments()->getArguments().at(0), showProgressBars);
     TrainingSet::ptr testSet;
     
+    // Load the initial model for a warm start
+    if (initialModelFileName.size() > 0)
+    {
+        std::cout << "Loading initial model" << std::endl;
+        jungleTrainer->setInitialJungle(Jungle::Factory::createFromFile(initialModelFileName, showProgressBars));
+    }
+    
     // If there is a validation set, load it
     if (validationLevel > 0 && validationSetFileName != "")
     {
@@ -374,6 +593,15 @@ int TrainCLIFunction::execute()
     
     std::cout << std::endl;
     
+    if (featureShardCount > 0)
+    {
+        std::cout << "Waiting for " << featureShardCount << " feature shards on " << listenAddress << std::endl;
+    }
+    else if (listenAddress.size() > 0)
+    {
+        std::cout << "Waiting for workers on " << listenAddress << std::endl;
+    }
+    
     // Train the jungle
     // start timing
     boost::timer t; 
@@ -385,17 +613,49 @@ int TrainCLIFunction::execute()
     // Display some error statistics
     TrainingStatistics::ptr statisticsTool = TrainingStatistics::Factory::create();
     
-    std::cout << "Training error: " << statisticsTool->trainingError(jungle, trainingSet) << std::endl;
+    // A streamed model is only on disk. Without the feature columns, the training set has no features
+    if (!streamModel && !externalColumns)
+    {
+        std::cout << "Training error: " << statisticsTool->trainingError(jungle, trainingSet) << std::endl;
+    }
+    
+    // The out-of-bag estimate does not require a validation set
+    OutOfBagEstimate::ptr outOfBagEstimate = jungleTrainer->getOutOfBagEstimate();
+    if (outOfBagEstimate)
+    {
+        std::cout << "OOB error: " << outOfBagEstimate->error() << " (" << outOfBagEstimate->getCoverage() << "/" << trainingSet->size() << " examples)" << std::endl;
+        
+        if (jungleTrainer->getOutOfBagLevel() >= 2)
+        {
+            // Rows: true class label, columns: predicted class label
+            std::cout << "OOB confusion matrix:" << std::endl;
+            Matrix confusion = outOfBagEstimate->confusionMatrix();
+            for (size_t i = 0; i < confusion.size(); i++)
+            {
+                for (size_t j = 0; j < confusion[i].size(); j++)
+                {
+                    std::cout << std::setw(7) << confusion[i][j];
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
     
     if (validationLevel > 0 && testSet)
     {
-        std::cout << "Test error: " << statisticsTool->trainingError(jungle, testSet) << std::endl;
+        if (!streamModel)
+        {
+            std::cout << "Test error: " << statisticsTool->trainingError(jungle, testSet) << std::endl;
+        }
         TrainingSet::freeTrainingExamples(testSet);
     }
     TrainingSet::freeTrainingExamples(trainingSet);
     
     // Save the jungle in a file
-    Jungle::Factory::serialize(jungle, getArguments()->getArguments().at(1));
+    if (!streamModel)
+    {
+        Jungle::Factory::serialize(jungle, getArguments()->getArguments().at(1));
+    }
     
     delete jungleTrainer;
     
@@ -420,8 +680,45 @@ const char* TrainCLIFunction::help()
             " -P [bool]     Whether or not the parent nodes shall be sorted by their entropy\n"
             " -V [string]   The filename of a validation set\n"
             " -v [int]      Validation level. 1: After training, 2: After each DAG, 3: After each level \n"
-            " -T [int]      Maximum number of DAGs to train parallel\n"
-            " -p [bool]     Whether or not the progress bars shall be displayed\n\n"
+            " -T [int]      Maximum number of DAGs to train parallel. If there are fewer DAGs than\n"
+            "               threads, the levels of a DAG are partitioned in parallel\n"
+            " -p [bool]     Whether or not the progress bars shall be displayed\n"
+            " -H [bool]     Whether or not the DAG memory shall be backed by huge pages\n"
+            " -C [string]   Split criterion: entropy (default) or gini\n"
+            " -L [string]   Feature sampling: node (default), level or iteration. With level or iteration,\n"
+            "               all nodes of a level or LSearch iteration share the sampled features and\n"
+            "               every feature is sorted once for all nodes\n"
+            " -Q [int]      Quantize every feature into at most this many bins (2 to 256). The thresholds\n"
+            "               are searched on the class histograms of the bins. With -L=level, the bins are\n"
+            "               counted once per level. 0 (default) disables binning\n"
+            " -O [int]      Out-of-bag estimation, requires -B. 1: Error, 2: Error and confusion matrix\n"
+            " -E [int]      Stop training DAGs if the validation or out-of-bag error did not improve over\n"
+            "               this many DAGs. 0 (default) disables early stopping\n"
+            " -e [float]    Minimum improvement of the error for early stopping (default 0.001)\n"
+            " -t [float]    Training time budget in seconds (e.g. -time-budget=3600). 0 (default) means\n"
+            "               unlimited. The jungle contains all DAGs that were completed in time\n"
+            " -k [bool]     Whether or not DAGs that are interrupted by the time budget are kept,\n"
+            "               truncated at their last finished level\n"
+            " -c [string]   Checkpoint file. Every completed DAG is appended to this file\n"
+            " -r [bool]     Whether or not to resume from the checkpoint file (e.g. -resume). Only\n"
+            "               the remaining DAGs are trained\n"
+            " -S [bool]     Whether or not every DAG is written to {model} as soon as it is trained\n"
+            "               instead of keeping all DAGs in memory. {model} serves as checkpoint file\n"
+            " -i [string]   Initial model (e.g. -init=model.txt). Its DAGs are kept and only the DAGs up\n"
+            "               to -M are trained\n"
+            " -s [int]      Random seed. DAG i uses the seed s + i. -1 (default): nondeterministic\n"
+            " -l [string]   Coordinator address (e.g. -listen=unix:/tmp/jungle.sock or -listen=host:port).\n"
+            "               The DAGs are trained by workers, see '$ jungle help worker'\n"
+            " -w [float]    Seconds a worker may take for a DAG (e.g. -worker-timeout=600). A worker that\n"
+            "               exceeds it is lost and its DAG is handed out again. With -t, the workers stop\n"
+            "               at the deadline and the seconds count from there. Default: -t, or no limit\n"
+            "               without a time budget\n"
+            " -f [int]      Number of feature shards (e.g. -feature-shards=4). Requires -l. The shards hold\n"
+            "               the feature columns and search the thresholds, see '$ jungle help shard'\n"
+            " -x [string]   Out-of-core training (e.g. -x=/scratch/columns). The feature columns are\n"
+            "               written to sorted column files in this directory and streamed from disk.\n"
+            "               Only the class labels are kept in memory\n"
+            " -m [int]      Memory budget of the column buffers in MB for -x (default 256)\n\n"
             "DESCRIPTION\n"
             " This command trains a new decision jungle on the training set\n"
             " stored in {trainingset}. The trained model will be saved in\n"
@@ -434,6 +731,283 @@ const char* TrainCLIFunction::shortHelp()
     return "Trains a new decision jungle on a training set";
 }
 
+int WorkerCLIFunction::execute()
+{
+    showProgressBars = false;
+    dumpSettings = false;
+    validationLevel = 0;
+    streamModel = false;
+    initialModelFileName = "";
+    listenAddress = "";
+    featureShardCount = 0;
+    columnDirectory = "";
+    columnMemoryBudget = 256;
+    
+    // There must be a coordinator address
+    if (getArguments()->getArguments().size() != 1)
+    {
+        std::cout << "Please use the command as follows:" << std::endl;
+        std::cout << " $ jungle worker {address}" << std::endl;
+        std::cout << "See '$ jungle help worker' for more information." << std::endl;
+        return 1;
+    }
+    
+    JungleTrainer::ptr jungleTrainer = JungleTrainer::Factory::create();
+    TrainingSet::ptr trainingSet;
+    
+    std::cout << "Connecting to " << getArguments()->getArguments().at(0) << std::endl;
+    Worker::ptr worker = Worker::Factory::create(getArguments()->getArguments().at(0));
+    
+    const int dagCount = worker->run(
+        [this, jungleTrainer, &trainingSet](const std::string & configuration) {
+            // The first line is the training set, the other lines are the parameters of the coordinator
+            std::istringstream in(configuration);
+            std::string trainingSetFileName;
+            std::getline(in, trainingSetFileName);
+            
+            std::string line;
+            while (std::getline(in, line))
+            {
+                const std::string::size_type equalPos = line.find('=');
+                getArguments()->getParameters()[line.substr(0, equalPos)] = line.substr(equalPos + 1);
+            }
+            loadParametersToTrainer(jungleTrainer);
+            
+            std::cout << "Loading training set" << std::endl;
+            trainingSet = TrainingSet::Factory::createFromFile(trainingSetFileName, showProgressBars);
+        },
+        [jungleTrainer, &trainingSet](int index, unsigned int seed, float budget, MemoryArena::ptr & arena, bool & interrupted) {
+            std::cout << "Train DAG " << (index+1) << std::endl;
+            
+            // The DAG trainer takes over the deadline of the coordinator
+            if (budget > 0)
+            {
+                jungleTrainer->setDeadline(std::chrono::steady_clock::now() + 
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(budget)));
+            }
+            else
+            {
+                jungleTrainer->setDeadline(std::chrono::steady_clock::time_point::max());
+            }
+            
+            std::vector<int> weights;
+            DAGTrainer::ptr trainer = jungleTrainer->createDAGTrainer(trainingSet, seed, weights);
+            DAGNode::ptr dag = trainer->train();
+            interrupted = trainer->isInterrupted();
+            
+            // The DAG lives in the arena of the trainer
+            arena = trainer->getArena();
+            delete trainer;
+            
+            return dag;
+        });
+    
+    std::cout << "Trained " << dagCount << " DAGs" << std::endl;
+    
+    if (trainingSet)
+    {
+        TrainingSet::freeTrainingExamples(trainingSet);
+    }
+    delete jungleTrainer;
+    
+    return 0;
+}
+
+const char* WorkerCLIFunction::help()
+{
+    return  "USAGE \n"
+            " $ jungle worker {address} \n\n"
+            "PARAMETERS\n"
+            " {address}     The address of the coordinator (e.g. unix:/tmp/jungle.sock or host:port)\n\n"
+            "DESCRIPTION\n"
+            " This command trains DAGs for a coordinator that is started with '$ jungle train -l=...'.\n"
+            " The worker loads the training set itself and uses the parameters of the coordinator.\n"
+            " Start as many workers as you like. The DAGs of a failed worker are handed out again.\n";
+}
+
+const char* WorkerCLIFunction::shortHelp()
+{
+    return "Trains DAGs for a coordinator (distributed training)";
+}
+
+int ShardCLIFunction::execute()
+{
+    // There must be a coordinator address
+    if (getArguments()->getArguments().size() != 1)
+    {
+        std::cout << "Please use the command as follows:" << std::endl;
+        std::cout << " $ jungle shard {address}" << std::endl;
+        std::cout << "See '$ jungle help shard' for more information." << std::endl;
+        return 1;
+    }
+    
+    std::cout << "Connecting to " << getArguments()->getArguments().at(0) << std::endl;
+    FeatureShardWorker::ptr worker = FeatureShardWorker::Factory::create(getArguments()->getArguments().at(0));
+    worker->setVerboseMode(true);
+    
+    const int dagCount = worker->run();
+    std::cout << "Served " << dagCount << " DAGs" << std::endl;
+    
+    return 0;
+}
+
+const char* ShardCLIFunction::help()
+{
+    return  "USAGE \n"
+            " $ jungle shard {address} \n\n"
+            "PARAMETERS\n"
+            " {address}     The address of the coordinator (e.g. unix:/tmp/jungle.sock or host:port)\n\n"
+            "DESCRIPTION\n"
+            " This command holds some feature columns for a coordinator that is started with\n"
+            " '$ jungle train -l=... -f=K'. Exactly K shards must be started. Shard k loads the\n"
+            " features f with f % K == k of the training set and searches the thresholds of\n"
+            " these features for all nodes.\n";
+}
+
+const char* ShardCLIFunction::shortHelp()
+{
+    return "Holds feature columns for a coordinator (feature-sharded training)";
+}
+
+int RefitCLIFunction::execute()
+{
+    // There must be a training set, a model file and an output file
+    if (getArguments()->getArguments().size() != 3)
+    {
+        std::cout << "Please use the command as follows:" << std::endl;
+        std::cout << " $ jungle refit [parameters] {trainingset} {model} {output}" << std::endl;
+        std::cout << "See '$ jungle help refit' for more information." << std::endl;
+        return 1;
+    }
+    
+    JungleRefitter::ptr refitter = JungleRefitter::Factory::create();
+    
+    // Iterate over all parameters given and ignore unknown parameters
+    std::map<std::string, std::string> parameters = getArguments()->getParameters();
+    for (std::map<std::string, std::string>::iterator it = parameters.begin(); it != parameters.end(); ++it)
+    {
+        switch (ParameterConverter::getChar(it->first))
+        {
+            case 'b':
+                refitter->setOldCountWeight(ParameterConverter::getFloat(it->second));
+                break;
+                
+            case 'T':
+                refitter->setMaxParallel(ParameterConverter::getInt(it->second));
+                break;
+        }
+    }
+    
+    // Load the jungle
+    std::cout << "Loading jungle" << std::endl;
+    Jungle::ptr jungle = Jungle::Factory::createFromFile(getArguments()->getArguments().at(1), true);
+    
+    // Load the training set
+    std::cout << "Loading training set" << std::endl;
+    TrainingSet::ptr trainingSet = TrainingSet::Factory::createFromFile(getArguments()->getArguments().at(0), true);
+    
+    std::cout << std::endl;
+    
+    TrainingStatistics::ptr statisticsTool = TrainingStatistics::Factory::create();
+    std::cout << "Error before refit: " << statisticsTool->trainingError(jungle, trainingSet) << std::endl;
+    
+    const int reachedLeaves = refitter->refit(jungle, trainingSet);
+    
+    std::cout << "Error after refit: " << statisticsTool->trainingError(jungle, trainingSet) << std::endl;
+    std::cout << "Refitted leaves: " << reachedLeaves << " of " << refitter->getLeafCount() << std::endl;
+    
+    Jungle::Factory::serialize(jungle, getArguments()->getArguments().at(2));
+    
+    TrainingSet::freeTrainingExamples(trainingSet);
+    
+    return 0;
+}
+
+const char* RefitCLIFunction::help()
+{
+    return  "USAGE \n"
+            " $ jungle refit [parameters] {trainingset} {model} {output} \n\n"
+            "PARAMETERS\n"
+            " {trainingset} The filename of the new data\n"
+            " {model}       The filename of the existing model\n"
+            " {output}      The output filename of the refitted model\n"
+            " -b [float]    The weight of the old leaf counts. The new leaf histograms are the counts of the\n"
+            "               new data plus the old counts times this weight. 0 (default) discards them\n"
+            " -T [int]      Maximum number of DAGs to refit parallel\n\n"
+            "DESCRIPTION\n"
+            " This command keeps the splits of an existing model and recomputes the class histograms\n"
+            " and class labels of its leaves from new data. Leaves that are not reached by the new data\n"
+            " keep their old histograms.\n";
+}
+
+const char* RefitCLIFunction::shortHelp()
+{
+    return "Refits the leaves of an existing model to new data";
+}
+
+int MergeCLIFunction::execute()
+{
+    // There must be an output file and at least one model file
+    if (getArguments()->getArguments().size() < 2)
+    {
+        std::cout << "Please use the command as follows:" << std::endl;
+        std::cout << " $ jungle merge [parameters] {output} {model} [{model} ...]" << std::endl;
+        std::cout << "See '$ jungle help merge' for more information." << std::endl;
+        return 1;
+    }
+    
+    const std::vector<std::string> & arguments = getArguments()->getArguments();
+    std::vector<std::string> models(arguments.begin() + 1, arguments.end());
+    int maxParallel = static_cast<int>(models.size());
+    bool framed = false;
+    
+    // Iterate over all parameters given and ignore unknown parameters
+    std::map<std::string, std::string> parameters = getArguments()->getParameters();
+    for (std::map<std::string, std::string>::iterator it = parameters.begin(); it != parameters.end(); ++it)
+    {
+        switch (ParameterConverter::getChar(it->first))
+        {
+            case 'f':
+                framed = ParameterConverter::getBool(it->second);
+                break;
+                
+            case 'T':
+                maxParallel = std::max(1, ParameterConverter::getInt(it->second));
+                break;
+        }
+    }
+    
+    std::cout << "Loading " << models.size() << " models" << std::endl;
+    Jungle::ptr jungle = Jungle::Factory::merge(models, maxParallel);
+    
+    std::cout << "Writing " << jungle->getDAGs().size() << " DAGs with " << jungle->getClassCount() << " classes" << std::endl;
+    Jungle::Factory::serialize(jungle, arguments.at(0), framed);
+    
+    return 0;
+}
+
+const char* MergeCLIFunction::help()
+{
+    return  "USAGE \n"
+            " $ jungle merge [parameters] {output} {model} [{model} ...] \n\n"
+            "PARAMETERS\n"
+            " {output}      The output filename of the combined model\n"
+            " {model}       The filenames of the models to combine\n"
+            " -f [bool]     If 1, every DAG is written as a block of its own (e.g. -framed), such that\n"
+            "               more DAGs can be appended like to a checkpoint file. Default: 0, all DAGs\n"
+            "               form a single block with consecutive node IDs\n"
+            " -T [int]      Maximum number of models to load parallel. Default: all\n\n"
+            "DESCRIPTION\n"
+            " This command combines the DAGs of several models into one jungle, e.g. of jungles that\n"
+            " were trained independently on different machines. All models must have the same number\n"
+            " of classes.\n";
+}
+
+const char* MergeCLIFunction::shortHelp()
+{
+    return "Combines several models into one";
+}
+
 int VersionCLIFunction::execute()
 {
     std::cout << "Everything except sse.h and fastlog.h is licensed under the following BSD license:" << std::endl;
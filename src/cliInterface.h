@@ -314,6 +314,7 @@ namespace LibJungle {
          */
         static AbstractCLIFunction::RegisterFunction<TrainCLIFunction> reg;
         
+    protected:
         /**
          * Stores the loads the parameters from the cli input and stores them in the
          * jungle trainer
@@ -342,7 +343,158 @@ namespace LibJungle {
          */
         bool showProgressBars;
         
+        /**
+         * Whether or not the DAGs are written to the model file as soon as they are trained
+         */
+        bool streamModel;
+        
+        /**
+         * The filename of an initial model for a warm start
+         */
+        std::string initialModelFileName;
+        
+        /**
+         * The address on which the coordinator waits for workers. Empty if the DAGs are trained locally
+         */
+        std::string listenAddress;
+        
+        /**
+         * The number of feature shards. If greater than 0, the shards connect to the listen address instead of workers
+         */
+        int featureShardCount;
+        
+        /**
+         * The number of seconds a worker may take for a DAG. 0 means no limit
+         */
+        float workerTimeout;
+        
+        /**
+         * The directory of the column files for out-of-core training. Empty if the training set is loaded into memory
+         */
+        std::string columnDirectory;
+        
+        /**
+         * The memory budget of the column store in MB
+         */
+        int columnMemoryBudget;
+        
+    public:
+        /**
+         * Executes the command/function
+         */
+        virtual int execute();
+        
+        /**
+         * Returns the help documentation of the function
+         */
+        virtual const char* help();
+        
+        /**
+         * Returns the short help text for the overview
+         */
+        virtual const char* shortHelp();
+    };
+    
+    /**
+     * This function trains DAGs for a coordinator, see the -l parameter of the train function
+     */
+    class WorkerCLIFunction : public TrainCLIFunction {
+    private:
+        /**
+         * This is needed in order to register the function
+         */
+        static AbstractCLIFunction::RegisterFunction<WorkerCLIFunction> reg;
+        
+    public:
+        virtual ~WorkerCLIFunction() {}
+        
+        /**
+         * Executes the command/function
+         */
+        virtual int execute();
+        
+        /**
+         * Returns the help documentation of the function
+         */
+        virtual const char* help();
+        
+        /**
+         * Returns the short help text for the overview
+         */
+        virtual const char* shortHelp();
+    };
+    
+    /**
+     * This function holds some feature columns for a coordinator, see the -f parameter of the train function
+     */
+    class ShardCLIFunction : public AbstractCLIFunction {
+    private:
+        /**
+         * This is needed in order to register the function
+         */
+        static AbstractCLIFunction::RegisterFunction<ShardCLIFunction> reg;
+        
+    public:
+        virtual ~ShardCLIFunction() {}
+        
+        /**
+         * Executes the command/function
+         */
+        virtual int execute();
+        
+        /**
+         * Returns the help documentation of the function
+         */
+        virtual const char* help();
+        
+        /**
+         * Returns the short help text for the overview
+         */
+        virtual const char* shortHelp();
+    };
+    
+    /**
+     * This function refits the leaves of an existing model to new data
+     */
+    class RefitCLIFunction : public AbstractCLIFunction {
+    private:
+        /**
+         * This is needed in order to register the function
+         */
+        static AbstractCLIFunction::RegisterFunction<RefitCLIFunction> reg;
+        
+    public:
+        virtual ~RefitCLIFunction() {}
+        
+        /**
+         * Executes the command/function
+         */
+        virtual int execute();
+        
+        /**
+         * Returns the help documentation of the function
+         */
+        virtual const char* help();
+        
+        /**
+         * Returns the short help text for the overview
+         */
+        virtual const char* shortHelp();
+    };
+    
+    /**
+     * This function combines several models into one
+     */
+    class MergeCLIFunction : public AbstractCLIFunction {
+    private:
+        /**
+         * This is needed in order to register the function
+         */
+        static AbstractCLIFunction::RegisterFunction<MergeCLIFunction> reg;
+        
     public:
+        virtual ~MergeCLIFunction() {}
+        
         /**
          * Executes the command/function
          */
@@ -426,6 +578,28 @@ namespace LibJungle {
             return atoi(_param.c_str());
         }
         
+        /**
+         * Converts a parameter to a count. Counts are 64 bit wide in builds with wide counts. 
+         * 
+         * @param _param
+         * @return Count
+         */
+        static Count getCount(const std::string & _param)
+        {
+            return static_cast<Count>(atoll(_param.c_str()));
+        }
+        
+        /**
+         * Converts a parameter to float
+         * 
+         * @param _param
+         * @return float value
+         */
+        static float getFloat(const std::string & _param)
+        {
+            return static_cast<float>(atof(_param.c_str()));
+        }
+        
         /**
          * Converts a string to a single character by returning the first char
          * 
@@ -0,0 +1,651 @@
+#include "columnStore.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/tokenizer.hpp>
+
+using namespace LibJungle;
+
+namespace {
+    /**
+     * The position of rows that are not used by the current DAG
+     */
+    const ColumnStore::RowIndex noPosition = static_cast<ColumnStore::RowIndex>(-1);
+
+    /**
+     * Orders the entries of a column by their value. Equal values are ordered by their row
+     */
+    bool entryLess(const ColumnStore::Entry & a, const ColumnStore::Entry & b)
+    {
+        return a.value < b.value || (a.value == b.value && a.row < b.row);
+    }
+
+    /**
+     * The next entry of a run during the merge
+     */
+    struct RunHead {
+        ColumnStore::Entry entry;
+        size_t run;
+
+        /**
+         * The priority queue returns the largest element first, hence the order is reversed
+         */
+        bool operator<(const RunHead & other) const
+        {
+            return entryLess(other.entry, entry);
+        }
+    };
+
+    /**
+     * Reads the next entries of a run into its buffer
+     */
+    size_t readRun(std::ifstream & in, std::streamoff position, size_t count, ColumnStore::Entry* buffer)
+    {
+        in.clear();
+        in.seekg(position);
+        in.read(reinterpret_cast<char*>(buffer), count * sizeof(ColumnStore::Entry));
+        if (static_cast<size_t>(in.gcount()) != count * sizeof(ColumnStore::Entry))
+        {
+            throw RuntimeException("Could not read column file.");
+        }
+        return count;
+    }
+}
+
+std::string ColumnStore::getColumnFile(int _feature) const
+{
+    std::ostringstream path;
+    path << directory << "/column" << _feature << ".bin";
+    return path.str();
+}
+
+std::vector<size_t> ColumnStore::writeRuns() throw(RuntimeException)
+{
+    std::ifstream in(trainingSetFile.c_str());
+    if (!in.is_open())
+    {
+        throw RuntimeException("Could not open training set file.");
+    }
+
+    std::ofstream runs((directory + "/runs.bin").c_str(), std::ios::binary | std::ios::trunc);
+    if (!runs.is_open())
+    {
+        throw RuntimeException("Could not write column file.");
+    }
+
+    typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
+    std::vector<std::string> row;
+    std::string line;
+
+    // A chunk holds as many rows as fit into the memory budget. Its entries are stored feature by feature
+    std::vector<Entry> chunk;
+    size_t chunkRows = 0;
+    size_t rows = 0;
+    std::vector<size_t> runLengths;
+
+    // Sorts the current chunk and appends a run per feature
+    auto flushChunk = [&]() {
+        if (rows == 0) return;
+        for (int f = 0; f < featureDimension; f++)
+        {
+            Entry* begin = chunk.data() + f * chunkRows;
+            std::sort(begin, begin + rows, entryLess);
+            runs.write(reinterpret_cast<const char*>(begin), rows * sizeof(Entry));
+        }
+        if (!runs)
+        {
+            throw RuntimeException("Could not write column file.");
+        }
+        runLengths.push_back(rows);
+        rows = 0;
+    };
+
+    labels.clear();
+    while (std::getline(in, line))
+    {
+        Tokenizer tok(line);
+        row.assign(tok.begin(), tok.end());
+
+        // Do not consider blank line
+        if (row.size() == 0) continue;
+        if (row.size() < 2)
+        {
+            throw RuntimeException("Illegal training set row.");
+        }
+
+        // The first row determines the feature dimension
+        if (featureDimension == 0)
+        {
+            featureDimension = static_cast<int>(row.size()) - 1;
+            chunkRows = std::max(static_cast<size_t>(1), memoryBudget / (featureDimension * sizeof(Entry)));
+            chunk.resize(chunkRows * featureDimension);
+        }
+        if (static_cast<int>(row.size()) - 1 != featureDimension)
+        {
+            throw RuntimeException("Illegal training set row.");
+        }
+
+        const RowIndex rowID = static_cast<RowIndex>(labels.size());
+        labels.push_back(atoi(row[0].c_str()));
+        for (int f = 0; f < featureDimension; f++)
+        {
+            Entry entry = {static_cast<float>(atof(row[f + 1].c_str())), rowID};
+            chunk[f * chunkRows + rows] = entry;
+        }
+
+        if (++rows == chunkRows)
+        {
+            flushChunk();
+        }
+    }
+    flushChunk();
+
+    return runLengths;
+}
+
+void ColumnStore::mergeRuns(int _feature, const std::vector<size_t> & _runLengths) throw(RuntimeException)
+{
+    std::ifstream in((directory + "/runs.bin").c_str(), std::ios::binary);
+    std::ofstream out(getColumnFile(_feature).c_str(), std::ios::binary | std::ios::trunc);
+    if (!in.is_open() || !out.is_open())
+    {
+        throw RuntimeException("Could not write column file.");
+    }
+
+    // The runs of a chunk are stored feature by feature
+    const size_t runCount = _runLengths.size();
+    std::vector<std::streamoff> position(runCount);
+    std::vector<size_t> remaining(runCount);
+    std::streamoff chunkBegin = 0;
+    for (size_t r = 0; r < runCount; r++)
+    {
+        position[r] = chunkBegin + static_cast<std::streamoff>(_feature * _runLengths[r] * sizeof(Entry));
+        remaining[r] = _runLengths[r];
+        chunkBegin += static_cast<std::streamoff>(featureDimension * _runLengths[r] * sizeof(Entry));
+    }
+
+    // Every run and the output get an equal share of the memory budget
+    const size_t bufferSize = std::max(static_cast<size_t>(1), memoryBudget / sizeof(Entry) / (runCount + 1));
+    std::vector<Entry> runBuffers(runCount * bufferSize);
+    std::vector<size_t> bufferBegin(runCount, 0);
+    std::vector<size_t> bufferEnd(runCount, 0);
+    std::vector<Entry> output;
+    output.reserve(bufferSize);
+
+    // Returns the next entry of a run. The buffer is refilled when it is empty
+    auto next = [&](size_t r, Entry & entry) -> bool {
+        if (bufferBegin[r] == bufferEnd[r])
+        {
+            if (remaining[r] == 0) return false;
+            const size_t count = std::min(remaining[r], bufferSize);
+            readRun(in, position[r], count, runBuffers.data() + r * bufferSize);
+            position[r] += static_cast<std::streamoff>(count * sizeof(Entry));
+            remaining[r] -= count;
+            bufferBegin[r] = 0;
+            bufferEnd[r] = count;
+        }
+        entry = runBuffers[r * bufferSize + bufferBegin[r]++];
+        return true;
+    };
+
+    std::priority_queue<RunHead> heads;
+    for (size_t r = 0; r < runCount; r++)
+    {
+        RunHead head;
+        head.run = r;
+        if (next(r, head.entry))
+        {
+            heads.push(head);
+        }
+    }
+
+    while (!heads.empty())
+    {
+        RunHead head = heads.top();
+        heads.pop();
+        output.push_back(head.entry);
+        if (output.size() == bufferSize)
+        {
+            out.write(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(Entry));
+            output.clear();
+        }
+        if (next(head.run, head.entry))
+        {
+            heads.push(head);
+        }
+    }
+    out.write(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(Entry));
+
+    if (!out)
+    {
+        throw RuntimeException("Could not write column file.");
+    }
+}
+
+template <class Handler>
+void ColumnStore::streamColumn(int _feature, Handler _handler) throw(RuntimeException)
+{
+    std::ifstream in(getColumnFile(_feature).c_str(), std::ios::binary);
+    if (!in.is_open())
+    {
+        throw RuntimeException("Could not read column file.");
+    }
+
+    while (in)
+    {
+        in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(Entry));
+        const size_t count = static_cast<size_t>(in.gcount()) / sizeof(Entry);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!_handler(buffer[i], rowPosition[buffer[i].row]))
+            {
+                return;
+            }
+        }
+    }
+}
+
+void ColumnStore::connect(size_t _rows) throw(RuntimeException)
+{
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        throw RuntimeException("Could not create the column directory.");
+    }
+
+    if (verboseMode)
+    {
+        std::cout << "Building column files in " << directory << std::endl;
+    }
+
+    featureDimension = 0;
+    const std::vector<size_t> runLengths = writeRuns();
+    if (labels.size() != _rows)
+    {
+        throw RuntimeException("The column store holds a different training set.");
+    }
+
+    ProgressBar::ptr progressBar = ProgressBar::Factory::create(featureDimension);
+    for (int f = 0; f < featureDimension; f++)
+    {
+        if (verboseMode)
+        {
+            progressBar->update();
+        }
+        mergeRuns(f, runLengths);
+    }
+    std::remove((directory + "/runs.bin").c_str());
+
+    // The columns are streamed through a single buffer
+    buffer.resize(std::max(static_cast<size_t>(1), memoryBudget / sizeof(Entry)));
+}
+
+void ColumnStore::beginDAG(const std::vector<int> & _weights, size_t _rows, int _classCount, SplitCriterion _criterion,
+        Count _totalWeight) throw(RuntimeException)
+{
+    if (_rows != labels.size())
+    {
+        throw RuntimeException("The column store holds a different training set.");
+    }
+
+    classCount = _classCount;
+    criterion = _criterion;
+    histogramBins = selectHistogramBins(_classCount);
+    nlognTable = NLogNTable::Factory::create(_totalWeight);
+
+    // Set up the example index in the same way as DAGTrainer::train()
+    weights.assign(_rows, 1);
+    rowPosition.assign(_rows, noPosition);
+    positionRow.clear();
+    for (size_t i = 0; i < _rows; i++)
+    {
+        if (!_weights.empty())
+        {
+            weights[i] = _weights[i];
+        }
+        if (weights[i] > 0)
+        {
+            rowPosition[i] = static_cast<RowIndex>(positionRow.size());
+            positionRow.push_back(static_cast<RowIndex>(i));
+        }
+    }
+    positionRowBuffer.resize(positionRow.size());
+}
+
+template <int Bins, class Criterion>
+int ColumnStore::sweepColumns(size_t _offset, size_t _size, const std::vector<int> & _features, const ClassHistogram & _leftBase,
+        const ClassHistogram & _rightBase, const ClassHistogram & _nodeHistogram, float & _bestError, float & _bestThreshold)
+{
+    ThresholdEntropyErrorFunction<Bins, Criterion> error(_leftBase, _rightBase, _nodeHistogram, *nlognTable);
+
+    int bestPosition = -1;
+    for (size_t i = 0; i < _features.size(); i++)
+    {
+        error.resetHistograms();
+
+        // The examples of the node arrive sorted by the feature. Every threshold lies between two adjacent examples
+        Entry previous = {0, 0};
+        bool hasPrevious = false;
+        bool found = false;
+        size_t remaining = _size;
+        streamColumn(_features[i], [&](const Entry & entry, RowIndex position) -> bool {
+            if (position == noPosition || position < _offset || position >= _offset + _size) return true;
+
+            if (hasPrevious && error.advance(labels[previous.row], weights[previous.row], previous.value, entry.value, _bestError, _bestThreshold))
+            {
+                found = true;
+            }
+            previous = entry;
+            hasPrevious = true;
+            return --remaining > 0;
+        });
+
+        if (found)
+        {
+            bestPosition = static_cast<int>(i);
+        }
+    }
+    return bestPosition;
+}
+
+template <class Criterion>
+int ColumnStore::sweepColumns(size_t _offset, size_t _size, const std::vector<int> & _features, const ClassHistogram & _leftBase,
+        const ClassHistogram & _rightBase, const ClassHistogram & _nodeHistogram, float & _bestError, float & _bestThreshold)
+{
+    switch (histogramBins)
+    {
+        case 2:
+            return sweepColumns<2, Criterion>(_offset, _size, _features, _leftBase, _rightBase, _nodeHistogram, _bestError, _bestThreshold);
+        case 4:
+            return sweepColumns<4, Criterion>(_offset, _size, _features, _leftBase, _rightBase, _nodeHistogram, _bestError, _bestThreshold);
+        case 8:
+            return sweepColumns<8, Criterion>(_offset, _size, _features, _leftBase, _rightBase, _nodeHistogram, _bestError, _bestThreshold);
+        case 16:
+            return sweepColumns<16, Criterion>(_offset, _size, _features, _leftBase, _rightBase, _nodeHistogram, _bestError, _bestThreshold);
+        case 32:
+            return sweepColumns<32, Criterion>(_offset, _size, _features, _leftBase, _rightBase, _nodeHistogram, _bestError, _bestThreshold);
+        default:
+            return sweepColumns<0, Criterion>(_offset, _size, _features, _leftBase, _rightBase, _nodeHistogram, _bestError, _bestThreshold);
+    }
+}
+
+bool ColumnStore::findThreshold(size_t _offset, size_t _size, const std::vector<int> & _features, const std::vector<Count> & _leftBase,
+        const std::vector<Count> & _rightBase, float & _bestError, int & _bestFeature, float & _bestThreshold) throw(RuntimeException)
+{
+    // Histograms with compile-time bins read all of their bins, see TrainingDAGNode::Factory::create()
+    const int bins = std::max(classCount, histogramBins);
+    ClassHistogram leftBase(bins);
+    ClassHistogram rightBase(bins);
+    for (size_t i = 0; i < _leftBase.size(); i++)
+    {
+        if (_leftBase[i] != 0) leftBase.add(static_cast<int>(i), _leftBase[i]);
+        if (_rightBase[i] != 0) rightBase.add(static_cast<int>(i), _rightBase[i]);
+    }
+
+    ClassHistogram nodeHistogram(bins);
+    for (size_t i = _offset; i < _offset + _size; i++)
+    {
+        nodeHistogram.add(labels[positionRow[i]], weights[positionRow[i]]);
+    }
+
+    int position;
+    switch (criterion)
+    {
+        case SplitCriterionGini:
+            position = sweepColumns<GiniCriterion>(_offset, _size, _features, leftBase, rightBase, nodeHistogram, _bestError, _bestThreshold);
+            break;
+        default:
+            position = sweepColumns<EntropyCriterion>(_offset, _size, _features, leftBase, rightBase, nodeHistogram, _bestError, _bestThreshold);
+            break;
+    }
+
+    if (position < 0)
+    {
+        return false;
+    }
+    _bestFeature = _features[position];
+    return true;
+}
+
+void ColumnStore::partition(size_t _offset, size_t _size, int _feature, float _threshold, char* _left) throw(RuntimeException)
+{
+    std::fill(_left, _left + _size, 0);
+    if (_size == 0) return;
+
+    // The examples that go to the left child node come first
+    streamColumn(_feature, [&](const Entry & entry, RowIndex position) -> bool {
+        if (!(entry.value <= _threshold)) return false;
+        if (position != noPosition && position >= _offset && position < _offset + _size)
+        {
+            _left[position - _offset] = 1;
+        }
+        return true;
+    });
+}
+
+template <class Node>
+void ColumnStore::setPositionNodes(const std::vector<Node> & _nodes)
+{
+    positionNode.assign(positionRow.size(), -1);
+    for (size_t k = 0; k < _nodes.size(); k++)
+    {
+        std::fill(positionNode.begin() + _nodes[k].offset, positionNode.begin() + _nodes[k].offset + _nodes[k].size, static_cast<int>(k));
+    }
+}
+
+template <int Bins, class Criterion>
+void ColumnStore::sweepColumns(const std::vector<int> & _features, const std::vector<ClassHistogram> & _leftBases,
+        const std::vector<ClassHistogram> & _rightBases, const std::vector<ClassHistogram> & _nodeHistograms,
+        std::vector<NodeSearch> & _nodes)
+{
+    typedef ThresholdEntropyErrorFunction<Bins, Criterion> ErrorFunction;
+
+    // The error functions don't copy their histograms, hence they stay in place
+    std::vector< std::unique_ptr<ErrorFunction> > errors(_nodes.size());
+    size_t total = 0;
+    for (size_t k = 0; k < _nodes.size(); k++)
+    {
+        errors[k].reset(new ErrorFunction(_leftBases[k], _rightBases[k], _nodeHistograms[k], *nlognTable));
+        total += _nodes[k].size;
+    }
+    if (total == 0) return;
+
+    std::vector<Entry> previous(_nodes.size());
+    std::vector<char> hasPrevious(_nodes.size());
+    for (size_t i = 0; i < _features.size(); i++)
+    {
+        for (size_t k = 0; k < _nodes.size(); k++)
+        {
+            errors[k]->resetHistograms();
+            hasPrevious[k] = 0;
+        }
+
+        // The examples of every node arrive sorted by the feature. Every threshold lies between two adjacent examples
+        // of the same node
+        size_t remaining = total;
+        streamColumn(_features[i], [&](const Entry & entry, RowIndex position) -> bool {
+            if (position == noPosition || positionNode[position] < 0) return true;
+
+            const int k = positionNode[position];
+            NodeSearch & node = _nodes[k];
+            if (hasPrevious[k] && errors[k]->advance(labels[previous[k].row], weights[previous[k].row], previous[k].value, entry.value,
+                    node.bestError, node.bestThreshold))
+            {
+                node.bestFeature = _features[i];
+                node.found = true;
+            }
+            previous[k] = entry;
+            hasPrevious[k] = 1;
+            return --remaining > 0;
+        });
+    }
+}
+
+template <class Criterion>
+void ColumnStore::sweepColumns(const std::vector<int> & _features, const std::vector<ClassHistogram> & _leftBases,
+        const std::vector<ClassHistogram> & _rightBases, const std::vector<ClassHistogram> & _nodeHistograms,
+        std::vector<NodeSearch> & _nodes)
+{
+    switch (histogramBins)
+    {
+        case 2:
+            sweepColumns<2, Criterion>(_features, _leftBases, _rightBases, _nodeHistograms, _nodes);
+            break;
+        case 4:
+            sweepColumns<4, Criterion>(_features, _leftBases, _rightBases, _nodeHistograms, _nodes);
+            break;
+        case 8:
+            sweepColumns<8, Criterion>(_features, _leftBases, _rightBases, _nodeHistograms, _nodes);
+            break;
+        case 16:
+            sweepColumns<16, Criterion>(_features, _leftBases, _rightBases, _nodeHistograms, _nodes);
+            break;
+        case 32:
+            sweepColumns<32, Criterion>(_features, _leftBases, _rightBases, _nodeHistograms, _nodes);
+            break;
+        default:
+            sweepColumns<0, Criterion>(_features, _leftBases, _rightBases, _nodeHistograms, _nodes);
+            break;
+    }
+}
+
+void ColumnStore::findThresholds(const std::vector<int> & _features, std::vector<NodeSearch> & _nodes) throw(RuntimeException)
+{
+    // Histograms with compile-time bins read all of their bins, see TrainingDAGNode::Factory::create()
+    const int bins = std::max(classCount, histogramBins);
+    std::vector<ClassHistogram> leftBases(_nodes.size(), ClassHistogram(bins));
+    std::vector<ClassHistogram> rightBases(_nodes.size(), ClassHistogram(bins));
+    std::vector<ClassHistogram> nodeHistograms(_nodes.size(), ClassHistogram(bins));
+    for (size_t k = 0; k < _nodes.size(); k++)
+    {
+        const NodeSearch & node = _nodes[k];
+        for (size_t i = 0; i < node.leftBase.size(); i++)
+        {
+            if (node.leftBase[i] != 0) leftBases[k].add(static_cast<int>(i), node.leftBase[i]);
+            if (node.rightBase[i] != 0) rightBases[k].add(static_cast<int>(i), node.rightBase[i]);
+        }
+        for (size_t i = node.offset; i < node.offset + node.size; i++)
+        {
+            nodeHistograms[k].add(labels[positionRow[i]], weights[positionRow[i]]);
+        }
+        _nodes[k].found = false;
+    }
+    setPositionNodes(_nodes);
+
+    switch (criterion)
+    {
+        case SplitCriterionGini:
+            sweepColumns<GiniCriterion>(_features, leftBases, rightBases, nodeHistograms, _nodes);
+            break;
+        default:
+            sweepColumns<EntropyCriterion>(_features, leftBases, rightBases, nodeHistograms, _nodes);
+            break;
+    }
+}
+
+void ColumnStore::partition(const std::vector<NodePartition> & _nodes) throw(RuntimeException)
+{
+    std::vector<int> features;
+    for (size_t k = 0; k < _nodes.size(); k++)
+    {
+        std::fill(_nodes[k].left, _nodes[k].left + _nodes[k].size, 0);
+        if (_nodes[k].size > 0 && std::find(features.begin(), features.end(), _nodes[k].feature) == features.end())
+        {
+            features.push_back(_nodes[k].feature);
+        }
+    }
+    setPositionNodes(_nodes);
+
+    for (size_t i = 0; i < features.size(); i++)
+    {
+        const int feature = features[i];
+        float maxThreshold = -std::numeric_limits<float>::infinity();
+        for (size_t k = 0; k < _nodes.size(); k++)
+        {
+            if (_nodes[k].feature == feature) maxThreshold = std::max(maxThreshold, _nodes[k].threshold);
+        }
+
+        // The examples that go to the left child nodes come first
+        streamColumn(feature, [&](const Entry & entry, RowIndex position) -> bool {
+            if (!(entry.value <= maxThreshold)) return false;
+            if (position == noPosition || positionNode[position] < 0) return true;
+
+            const NodePartition & node = _nodes[positionNode[position]];
+            if (node.feature == feature && entry.value <= node.threshold)
+            {
+                node.left[position - node.offset] = 1;
+            }
+            return true;
+        });
+    }
+}
+
+void ColumnStore::split(int _childCount, const std::vector<Split> & _parents, const std::vector<char> & _left) throw(RuntimeException)
+{
+    // Count the examples of every child node and assign the ranges
+    std::vector<size_t> childExampleCounts(_childCount, 0);
+    for (size_t i = 0; i < _parents.size(); i++)
+    {
+        for (size_t j = 0; j < _parents[i].size; j++)
+        {
+            childExampleCounts[_left[_parents[i].offset + j] ? _parents[i].left : _parents[i].right]++;
+        }
+    }
+    size_t offset = 0;
+    for (int i = 0; i < _childCount; i++)
+    {
+        const size_t childSize = childExampleCounts[i];
+        childExampleCounts[i] = offset;
+        offset += childSize;
+    }
+
+    // Propagate the rows. The partition is stable
+    for (size_t i = 0; i < positionRow.size(); i++)
+    {
+        rowPosition[positionRow[i]] = noPosition;
+    }
+    for (size_t i = 0; i < _parents.size(); i++)
+    {
+        for (size_t j = 0; j < _parents[i].size; j++)
+        {
+            const int child = _left[_parents[i].offset + j] ? _parents[i].left : _parents[i].right;
+            const size_t position = childExampleCounts[child]++;
+            positionRowBuffer[position] = positionRow[_parents[i].offset + j];
+            rowPosition[positionRowBuffer[position]] = static_cast<RowIndex>(position);
+        }
+    }
+    positionRow.swap(positionRowBuffer);
+}
+
+void ColumnStore::endDAG() throw(RuntimeException)
+{
+    std::vector<int>().swap(weights);
+    std::vector<RowIndex>().swap(rowPosition);
+    std::vector<RowIndex>().swap(positionRow);
+    std::vector<RowIndex>().swap(positionRowBuffer);
+    std::vector<int>().swap(positionNode);
+    nlognTable.reset();
+}
+
+void ColumnStore::close()
+{
+    // Nothing to do if the columns were never built
+    if (labels.empty()) return;
+    
+    for (int f = 0; f < featureDimension; f++)
+    {
+        std::remove(getColumnFile(f).c_str());
+    }
+    featureDimension = 0;
+    std::vector<int>().swap(labels);
+    std::vector<Entry>().swap(buffer);
+
+    // The directory is only removed if it is empty
+    rmdir(directory.c_str());
+}
@@ -0,0 +1,266 @@
+/**
+ * This file contains the column store for out-of-core training. The store writes every feature column of the training
+ * set to a file of its own on local disk. A column file holds (value, row) entries sorted by value. The columns are
+ * built from the CSV file in chunks of rows: every chunk is sorted into a run per feature, and the runs of a feature
+ * are merged into its column file afterwards.
+ *
+ * During training, the store only holds the class labels, the example weights and the position of every row in the
+ * example index of the DAG trainer, i.e. the node of every row. The threshold search and the partition of a node
+ * stream the column of a feature and pick the rows of the node. Since the columns are sorted, the examples of the node
+ * arrive in the order that the sweep requires. The memory that the buffers use is bounded by a budget.
+ *
+ * @version 1.0
+ */
+#ifndef COLUMNSTORE_H
+#define COLUMNSTORE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "jungleTrain.h"
+
+namespace LibJungle
+{
+    /**
+     * Feature columns that are kept in files on local disk instead of in memory
+     */
+    class ColumnStore : public FeatureColumns {
+    public:
+        typedef ColumnStore self;
+        typedef std::shared_ptr<self> ptr;
+
+        /**
+         * The type of row indices. Builds with wide counts use 64 bit indices, which enlarges the column files.
+         */
+        typedef LibJungle::RowIndex RowIndex;
+
+        /**
+         * An entry of a column file
+         */
+        struct Entry {
+            float value;
+            RowIndex row;
+        };
+
+    private:
+        /**
+         * The path of the training set
+         */
+        std::string trainingSetFile;
+
+        /**
+         * The directory of the column files
+         */
+        std::string directory;
+
+        /**
+         * The number of bytes that the buffers may use
+         */
+        size_t memoryBudget;
+
+        /**
+         * Whether or not the progress of building the columns is reported
+         */
+        bool verboseMode;
+
+        /**
+         * The feature dimension of the training set
+         */
+        int featureDimension;
+
+        /**
+         * The class label of every row
+         */
+        std::vector<int> labels;
+
+        /**
+         * The weight of every row in the current DAG
+         */
+        std::vector<int> weights;
+
+        /**
+         * The position of every row in the example index or -1 if the row is not used by the current DAG
+         */
+        std::vector<RowIndex> rowPosition;
+
+        /**
+         * The row of every position of the example index and its partition buffer
+         */
+        std::vector<RowIndex> positionRow;
+        std::vector<RowIndex> positionRowBuffer;
+
+        /**
+         * The node of every position of the example index during a search or partition of several nodes, -1 if
+         * the position belongs to none of them
+         */
+        std::vector<int> positionNode;
+
+        /**
+         * The entries of a column are read into this buffer
+         */
+        std::vector<Entry> buffer;
+
+        /**
+         * The settings of the current DAG
+         */
+        int classCount;
+        int histogramBins;
+        SplitCriterion criterion;
+        NLogNTable::ptr nlognTable;
+
+        /**
+         * Sorts the feature columns of the training set into runs. Returns the number of rows of every run
+         */
+        std::vector<size_t> writeRuns() throw(RuntimeException);
+
+        /**
+         * Merges the runs of a feature into its column file
+         */
+        void mergeRuns(int _feature, const std::vector<size_t> & _runLengths) throw(RuntimeException);
+
+        /**
+         * Streams the column of a feature. The handler is called with every entry and the position of its row in
+         * the example index. Streaming stops as soon as the handler returns false.
+         */
+        template <class Handler>
+        void streamColumn(int _feature, Handler _handler) throw(RuntimeException);
+
+        /**
+         * Tests the sampled features on a node. Returns the position of the best feature or -1.
+         */
+        template <int Bins, class Criterion>
+        int sweepColumns(size_t _offset, size_t _size, const std::vector<int> & _features, const ClassHistogram & _leftBase,
+                const ClassHistogram & _rightBase, const ClassHistogram & _nodeHistogram, float & _bestError, float & _bestThreshold);
+
+        /**
+         * Selects the histogram implementation for the class count of the current DAG
+         */
+        template <class Criterion>
+        int sweepColumns(size_t _offset, size_t _size, const std::vector<int> & _features, const ClassHistogram & _leftBase,
+                const ClassHistogram & _rightBase, const ClassHistogram & _nodeHistogram, float & _bestError, float & _bestThreshold);
+
+        /**
+         * Assigns the positions of the example index to the given nodes
+         */
+        template <class Node>
+        void setPositionNodes(const std::vector<Node> & _nodes);
+
+        /**
+         * Tests the sampled features on several nodes. Every column is streamed once for all nodes.
+         */
+        template <int Bins, class Criterion>
+        void sweepColumns(const std::vector<int> & _features, const std::vector<ClassHistogram> & _leftBases,
+                const std::vector<ClassHistogram> & _rightBases, const std::vector<ClassHistogram> & _nodeHistograms,
+                std::vector<NodeSearch> & _nodes);
+
+        /**
+         * Selects the histogram implementation for the class count of the current DAG
+         */
+        template <class Criterion>
+        void sweepColumns(const std::vector<int> & _features, const std::vector<ClassHistogram> & _leftBases,
+                const std::vector<ClassHistogram> & _rightBases, const std::vector<ClassHistogram> & _nodeHistograms,
+                std::vector<NodeSearch> & _nodes);
+
+    public:
+        ColumnStore() : memoryBudget(0), verboseMode(false), featureDimension(0), classCount(0), histogramBins(0),
+                criterion(SplitCriterionEntropy) {}
+
+        virtual ~ColumnStore()
+        {
+            close();
+        }
+
+        virtual int getFeatureDimension() const
+        {
+            return featureDimension;
+        }
+
+        /**
+         * Sets whether or not the progress of building the columns is reported
+         *
+         * @param _verboseMode The new verbose mode
+         */
+        void setVerboseMode(bool _verboseMode)
+        {
+            verboseMode = _verboseMode;
+        }
+
+        /**
+         * Returns the path of the column file of a feature
+         *
+         * @param _feature The feature
+         * @return path of the column file
+         */
+        std::string getColumnFile(int _feature) const;
+
+        /**
+         * Builds the column files from the training set
+         *
+         * @param _rows The number of rows of the training set of the DAG trainer
+         * @throws RuntimeException If the column files cannot be written or don't match the training set
+         */
+        virtual void connect(size_t _rows) throw(RuntimeException);
+
+        virtual void beginDAG(const std::vector<int> & _weights, size_t _rows, int _classCount, SplitCriterion _criterion, Count _totalWeight) throw(RuntimeException);
+
+        /**
+         * Every sampled feature is streamed once.
+         */
+        virtual bool findThreshold(size_t _offset, size_t _size, const std::vector<int> & _features, const std::vector<Count> & _leftBase,
+                const std::vector<Count> & _rightBase, float & _bestError, int & _bestFeature, float & _bestThreshold) throw(RuntimeException);
+
+        /**
+         * The column is only streamed up to the threshold.
+         */
+        virtual void partition(size_t _offset, size_t _size, int _feature, float _threshold, char* _left) throw(RuntimeException);
+
+        virtual bool searchesNodes() const
+        {
+            return true;
+        }
+
+        /**
+         * Every sampled feature is streamed once for all nodes.
+         */
+        virtual void findThresholds(const std::vector<int> & _features, std::vector<NodeSearch> & _nodes) throw(RuntimeException);
+
+        /**
+         * Every feature of the nodes is streamed once, up to the largest threshold of its nodes.
+         */
+        virtual void partition(const std::vector<NodePartition> & _nodes) throw(RuntimeException);
+
+        virtual void split(int _childCount, const std::vector<Split> & _parents, const std::vector<char> & _left) throw(RuntimeException);
+
+        virtual void endDAG() throw(RuntimeException);
+
+        /**
+         * Removes the column files
+         */
+        virtual void close();
+
+        /**
+         * Factory class for column stores
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new column store
+             *
+             * @param _trainingSetFile The path of the training set
+             * @param _directory The directory of the column files. It is created if it does not exist
+             * @param _memoryBudget The number of bytes that the buffers may use
+             * @return new column store
+             */
+            static ColumnStore::ptr create(const std::string & _trainingSetFile, const std::string & _directory, size_t _memoryBudget)
+            {
+                ColumnStore::ptr store(new ColumnStore());
+                store->trainingSetFile = _trainingSetFile;
+                store->directory = _directory;
+                store->memoryBudget = _memoryBudget;
+                return store;
+            }
+        };
+    };
+}
+
+#endif
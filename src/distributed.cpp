@@ -0,0 +1,463 @@
+#include "distributed.h"
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace LibJungle;
+
+namespace {
+    /**
+     * The prefix of Unix domain socket addresses
+     */
+    const std::string unixPrefix = "unix:";
+
+    /**
+     * Returns true if the address is a Unix domain socket address
+     */
+    bool isUnixAddress(const std::string & address)
+    {
+        return address.compare(0, unixPrefix.size(), unixPrefix) == 0;
+    }
+
+    /**
+     * Splits a TCP address into host and port. The host is empty if the address only consists of the port.
+     */
+    void splitAddress(const std::string & address, std::string & host, std::string & port)
+    {
+        const std::string::size_type colon = address.rfind(':');
+        if (colon == std::string::npos)
+        {
+            host = "";
+            port = address;
+        }
+        else
+        {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+        }
+    }
+
+    /**
+     * The state that is shared by all workers of a coordinator
+     */
+    struct Progress {
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        /**
+         * The DAGs that have not been handed out yet
+         */
+        std::deque<int> pending;
+
+        /**
+         * The number of DAGs that are currently trained by a worker
+         */
+        int inFlight;
+
+        /**
+         * The number of DAGs that are not completed yet
+         */
+        int remaining;
+
+        /**
+         * Whether or not a completion handler failed
+         */
+        bool failed;
+
+        /**
+         * The first error of a completion handler
+         */
+        RuntimeException failure;
+
+        Progress() : inFlight(0), remaining(0), failed(false) {}
+
+        /**
+         * Returns true if the coordinator is done. The mutex must be held.
+         */
+        bool finished(const Coordinator::StopCondition & _stop)
+        {
+            return remaining == 0 || failed || (inFlight == 0 && _stop());
+        }
+    };
+
+    /**
+     * Lets the operations of a socket stream fail after the given number of seconds. 0 removes the timeout. Other 
+     * streams don't time out.
+     */
+    void setStreamTimeout(std::iostream & stream, float seconds)
+    {
+        const std::chrono::steady_clock::time_point expiry = seconds > 0 ? std::chrono::steady_clock::now() + 
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(seconds)) : 
+                std::chrono::steady_clock::time_point::max();
+        if (boost::asio::local::stream_protocol::iostream* local = dynamic_cast<boost::asio::local::stream_protocol::iostream*>(&stream))
+        {
+            local->expires_at(expiry);
+        }
+        else if (boost::asio::ip::tcp::iostream* tcp = dynamic_cast<boost::asio::ip::tcp::iostream*>(&stream))
+        {
+            tcp->expires_at(expiry);
+        }
+    }
+
+    /**
+     * Serves a single worker until there are no DAGs left or the worker is lost. The DAG of a lost worker is handed
+     * out again. A worker that does not send its DAG within the worker timeout is lost as well.
+     */
+    void serveWorker(std::iostream & stream, const Coordinator & coordinator, Progress & progress,
+            Coordinator::SeedFunction & _seed, Coordinator::CompletionHandler & _complete, Coordinator::StopCondition & _stop)
+    {
+        stream << "CONFIG " << coordinator.getConfiguration().size() << '\n' << coordinator.getConfiguration() << std::flush;
+
+        while (true)
+        {
+            int index;
+            unsigned int seed;
+            {
+                // Wait for a DAG. A DAG in progress may come back if its worker is lost
+                std::unique_lock<std::mutex> lock(progress.mutex);
+                while (!progress.finished(_stop) && (progress.pending.empty() || _stop()))
+                {
+                    progress.changed.wait_for(lock, std::chrono::milliseconds(100));
+                }
+                if (progress.pending.empty() || _stop() || progress.failed)
+                {
+                    break;
+                }
+
+                index = progress.pending.front();
+                progress.pending.pop_front();
+                progress.inFlight++;
+                seed = _seed(index);
+            }
+
+            // The worker stops at the deadline as well, hence it gets the time that remains
+            float budget = 0;
+            if (coordinator.getDeadline() != std::chrono::steady_clock::time_point::max())
+            {
+                budget = std::max(1e-3f, std::chrono::duration<float>(coordinator.getDeadline() - std::chrono::steady_clock::now()).count());
+            }
+
+            // A worker that hangs without closing its connection is lost after the worker timeout. The worker may use
+            // its whole budget before
+            setStreamTimeout(stream, coordinator.getWorkerTimeout() > 0 ? budget + coordinator.getWorkerTimeout() : 0);
+            stream << "DAG " << index << ' ' << seed << ' ' << budget << '\n' << std::flush;
+
+            // Receive the reply and the block of the DAG up to its trailer
+            std::string block;
+            std::string line;
+            size_t lineCount = 0;
+            bool complete = false;
+            bool interrupted = false;
+            bool replied = false;
+            if (std::getline(stream, line))
+            {
+                std::istringstream reply(line);
+                std::string keyword;
+                int replyIndex;
+                reply >> keyword >> replyIndex >> interrupted;
+                replied = keyword == "DAG" && reply && replyIndex == index;
+            }
+            while (replied && std::getline(stream, line))
+            {
+                block += line;
+                block += '\n';
+                lineCount++;
+                if (line.size() > 0 && line[0] == '#')
+                {
+                    complete = true;
+                    break;
+                }
+            }
+            setStreamTimeout(stream, 0);
+
+            Jungle::ptr jungle;
+            if (complete)
+            {
+                try {
+                    std::istringstream in(block);
+                    jungle = Jungle::Factory::createFromStream(in, lineCount, false);
+                }
+                catch (std::exception &) {
+                    jungle.reset();
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(progress.mutex);
+            progress.inFlight--;
+            progress.changed.notify_all();
+
+            if (!jungle || jungle->getDAGs().size() != 1)
+            {
+                progress.pending.push_front(index);
+                if (coordinator.getVerboseMode())
+                {
+                    std::cout << "Lost a worker, DAG " << (index + 1) << " is handed out again" << std::endl;
+                }
+                return;
+            }
+
+            try {
+                _complete(index, seed, *jungle->getDAGs().begin(), jungle->getArenas().front(), interrupted);
+                progress.remaining--;
+            }
+            catch (RuntimeException & e) {
+                progress.failed = true;
+                progress.failure = e;
+                return;
+            }
+            catch (std::exception &) {
+                progress.failed = true;
+                progress.failure = RuntimeException("Could not process a completed DAG.");
+                return;
+            }
+        }
+
+        stream << "DONE\n" << std::flush;
+    }
+
+    /**
+     * Accepts the connections of a socket acceptor
+     */
+    template <class Protocol>
+    class SocketListener : public Listener {
+    private:
+        boost::asio::io_context context;
+        typename Protocol::acceptor acceptor;
+
+        /**
+         * The path of a Unix domain socket that is removed when the listener is closed
+         */
+        std::string path;
+
+    public:
+        SocketListener(const typename Protocol::endpoint & _endpoint, const std::string & _path) :
+                acceptor(context, _endpoint), path(_path)
+        {
+            // Poll the acceptor in order to be able to give up waiting
+            acceptor.non_blocking(true);
+        }
+
+        virtual ~SocketListener()
+        {
+            acceptor.close();
+            if (path.size() > 0)
+            {
+                unlink(path.c_str());
+            }
+        }
+
+        virtual std::shared_ptr<std::iostream> accept(int _timeout)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            while (true)
+            {
+                typename Protocol::socket socket(acceptor.get_executor());
+                boost::system::error_code error;
+                acceptor.accept(socket, error);
+
+                if (!error)
+                {
+                    socket.non_blocking(false);
+                    return std::shared_ptr<std::iostream>(new typename Protocol::iostream(std::move(socket)));
+                }
+                if (_timeout >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(_timeout))
+                {
+                    return std::shared_ptr<std::iostream>();
+                }
+
+                // There is no connection waiting
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+    };
+}
+
+Listener::ptr Listener::Factory::create(const std::string & _address) throw(RuntimeException)
+{
+    try {
+        if (isUnixAddress(_address))
+        {
+            typedef boost::asio::local::stream_protocol Protocol;
+            const std::string path = _address.substr(unixPrefix.size());
+
+            // Remove the socket of a previous run
+            unlink(path.c_str());
+            return Listener::ptr(new SocketListener<Protocol>(Protocol::endpoint(path), path));
+        }
+        else
+        {
+            typedef boost::asio::ip::tcp Protocol;
+            std::string host, port;
+            splitAddress(_address, host, port);
+
+            Protocol::endpoint endpoint(Protocol::v4(), static_cast<unsigned short>(atoi(port.c_str())));
+            if (host.size() > 0)
+            {
+                boost::asio::io_context context;
+                Protocol::resolver resolver(context);
+                endpoint = *resolver.resolve(host, port).begin();
+            }
+            return Listener::ptr(new SocketListener<Protocol>(endpoint, ""));
+        }
+    }
+    catch (boost::system::system_error &) {
+        throw RuntimeException("Could not listen on the coordinator address.");
+    }
+}
+
+std::shared_ptr<std::iostream> Connection::open(const std::string & _address) throw(RuntimeException)
+{
+    try {
+        if (isUnixAddress(_address))
+        {
+            typedef boost::asio::local::stream_protocol Protocol;
+            std::shared_ptr<Protocol::iostream> stream(new Protocol::iostream());
+            stream->connect(Protocol::endpoint(_address.substr(unixPrefix.size())));
+            if (!*stream)
+            {
+                throw RuntimeException("Could not connect to the coordinator.");
+            }
+            return stream;
+        }
+        else
+        {
+            typedef boost::asio::ip::tcp Protocol;
+            std::string host, port;
+            splitAddress(_address, host, port);
+
+            std::shared_ptr<Protocol::iostream> stream(new Protocol::iostream(host.size() > 0 ? host : "localhost", port));
+            if (!*stream)
+            {
+                throw RuntimeException("Could not connect to the coordinator.");
+            }
+            return stream;
+        }
+    }
+    catch (boost::system::system_error &) {
+        throw RuntimeException("Could not connect to the coordinator.");
+    }
+}
+
+void Coordinator::run(const std::vector<int> & _indices, SeedFunction _seed, CompletionHandler _complete, StopCondition _stop) throw(RuntimeException)
+{
+    Progress progress;
+    progress.pending.assign(_indices.begin(), _indices.end());
+    progress.remaining = static_cast<int>(_indices.size());
+
+    std::function<bool()> finished = [&progress, &_stop]() {
+        std::lock_guard<std::mutex> lock(progress.mutex);
+        return progress.finished(_stop);
+    };
+    std::function<void(std::iostream &)> serve = [this, &progress, &_seed, &_complete, &_stop](std::iostream & stream) {
+        if (getVerboseMode())
+        {
+            std::lock_guard<std::mutex> lock(progress.mutex);
+            std::cout << "Worker connected" << std::endl;
+        }
+        serveWorker(stream, *this, progress, _seed, _complete, _stop);
+    };
+
+    Listener::ptr listener = Listener::Factory::create(address);
+    std::vector<std::thread> threads;
+
+    // Every worker is served by a thread of its own
+    while (!finished())
+    {
+        std::shared_ptr<std::iostream> stream = listener->accept(20);
+        if (!stream)
+        {
+            continue;
+        }
+
+        threads.push_back(std::thread([stream, &serve]() {
+            try {
+                serve(*stream);
+            }
+            catch (std::exception &) {
+                // The worker is lost
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    listener.reset();
+
+    if (progress.failed)
+    {
+        throw progress.failure;
+    }
+}
+
+int Worker::serve(std::iostream & _stream, ConfigurationHandler _configure, TrainFunction _train)
+{
+    std::string line;
+    std::string keyword;
+
+    // The configuration comes first
+    std::string::size_type size = 0;
+    if (!std::getline(_stream, line))
+    {
+        throw RuntimeException("Could not connect to the coordinator.");
+    }
+    std::istringstream header(line);
+    header >> keyword >> size;
+    if (keyword != "CONFIG" || !header)
+    {
+        throw RuntimeException("Unexpected message from the coordinator.");
+    }
+
+    std::string configuration(size, ' ');
+    _stream.read(&configuration[0], size);
+    if (!_stream)
+    {
+        throw RuntimeException("Lost the connection to the coordinator.");
+    }
+    _configure(configuration);
+
+    // Train the DAGs until the coordinator is done
+    int dagCount = 0;
+    while (std::getline(_stream, line))
+    {
+        if (line == "DONE")
+        {
+            return dagCount;
+        }
+
+        std::istringstream message(line);
+        int index;
+        unsigned int seed;
+        float budget;
+        message >> keyword >> index >> seed >> budget;
+        if (keyword != "DAG" || !message)
+        {
+            throw RuntimeException("Unexpected message from the coordinator.");
+        }
+
+        MemoryArena::ptr arena;
+        bool interrupted = false;
+        DAGNode::ptr dag = _train(index, seed, budget, arena, interrupted);
+
+        std::ostringstream block;
+        block << "DAG " << index << ' ' << (interrupted ? 1 : 0) << '\n';
+        DAGNode::Factory::serializeDAG(dag, block);
+        _stream << block.str() << std::flush;
+        dagCount++;
+    }
+
+    throw RuntimeException("Lost the connection to the coordinator.");
+}
+
+int Worker::run(ConfigurationHandler _configure, TrainFunction _train)
+{
+    std::shared_ptr<std::iostream> stream = Connection::open(address);
+    return serve(*stream, _configure, _train);
+}
@@ -0,0 +1,328 @@
+/**
+ * This file contains the coordinator and the worker for distributed training. The coordinator hands out DAG indices
+ * and seeds to the workers, the workers train the DAGs and send them back.
+ *
+ * Addresses are either "unix:{path}" for a Unix domain socket or "{host}:{port}" for TCP. A coordinator address may
+ * omit the host in order to listen on all interfaces.
+ *
+ * The protocol is line based:
+ *  coordinator -> worker: "CONFIG {size}\n" followed by {size} bytes of configuration (once)
+ *  coordinator -> worker: "DAG {index} {seed} {budget}\n", {budget} is the remaining time budget in seconds or 0
+ *  worker -> coordinator: "DAG {index} {interrupted}\n" followed by the DAG in the model file format, terminated by
+ *                         its "#{rows}" trailer
+ *  coordinator -> worker: "DONE\n" when there are no DAGs left
+ *
+ * The DAG of a worker that disconnects before it sends its DAG or that exceeds the worker timeout is handed out again.
+ * With a time budget, the worker timeout starts at the deadline.
+ *
+ * @version 1.0
+ */
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "jungle.h"
+
+namespace LibJungle
+{
+    /**
+     * A listener accepts the connections of workers on an address
+     */
+    class Listener {
+    public:
+        typedef Listener self;
+        typedef std::shared_ptr<self> ptr;
+
+        virtual ~Listener() {}
+
+        /**
+         * Waits for a connection
+         *
+         * @param _timeout The number of milliseconds to wait. A negative timeout waits forever.
+         * @return The stream of the connection or an empty pointer if no one connected in time
+         */
+        virtual std::shared_ptr<std::iostream> accept(int _timeout) = 0;
+
+        /**
+         * Factory class for listeners
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new listener. The socket file of a Unix domain socket is removed when the listener is
+             * destroyed.
+             *
+             * @param _address The address to listen on
+             * @return new listener
+             * @throws RuntimeException If the address cannot be listened on
+             */
+            static Listener::ptr create(const std::string & _address) throw(RuntimeException);
+        };
+    };
+
+    /**
+     * Connects workers to their coordinator
+     */
+    class Connection {
+    public:
+        /**
+         * Connects to a coordinator
+         *
+         * @param _address The address of the coordinator
+         * @return The stream of the connection
+         * @throws RuntimeException If the connection fails
+         */
+        static std::shared_ptr<std::iostream> open(const std::string & _address) throw(RuntimeException);
+    };
+
+    /**
+     * The coordinator hands out the DAGs to the connected workers and collects the results
+     */
+    class Coordinator {
+    public:
+        typedef Coordinator self;
+        typedef std::shared_ptr<self> ptr;
+
+        /**
+         * Returns the seed of a DAG
+         */
+        typedef std::function<unsigned int(int)> SeedFunction;
+
+        /**
+         * Is called for every completed DAG with its index, the seed it was handed out with, its compact root node, 
+         * its arena and whether or not it was interrupted by the time budget
+         */
+        typedef std::function<void(int, unsigned int, DAGNode::ptr, MemoryArena::ptr, bool)> CompletionHandler;
+
+        /**
+         * Returns true if no more DAGs shall be handed out
+         */
+        typedef std::function<bool()> StopCondition;
+
+    private:
+        /**
+         * The address to listen on
+         */
+        std::string address;
+
+        /**
+         * The configuration that is sent to every worker
+         */
+        std::string configuration;
+
+        /**
+         * Whether or not the coordinator reports connected and lost workers
+         */
+        bool verboseMode;
+
+        /**
+         * The number of seconds a worker may take for a DAG, counted from the deadline if there is one. A worker 
+         * that exceeds it is considered lost. 0 means no limit
+         */
+        float workerTimeout;
+
+        /**
+         * The workers don't start any new levels after the deadline. The remaining time is sent with every DAG
+         */
+        std::chrono::steady_clock::time_point deadline;
+
+    public:
+        Coordinator() : verboseMode(false), workerTimeout(0), deadline(std::chrono::steady_clock::time_point::max()) {}
+
+        /**
+         * Returns the address to listen on
+         *
+         * @return address
+         */
+        const std::string & getAddress() const
+        {
+            return address;
+        }
+
+        /**
+         * Returns the configuration that is sent to every worker
+         *
+         * @return configuration
+         */
+        const std::string & getConfiguration() const
+        {
+            return configuration;
+        }
+
+        /**
+         * Returns whether or not the coordinator reports connected and lost workers
+         *
+         * @return verbose mode
+         */
+        bool getVerboseMode() const
+        {
+            return verboseMode;
+        }
+
+        /**
+         * Sets whether or not the coordinator reports connected and lost workers
+         *
+         * @param _verboseMode The new verbose mode
+         */
+        void setVerboseMode(bool _verboseMode)
+        {
+            verboseMode = _verboseMode;
+        }
+
+        /**
+         * Returns the number of seconds a worker may take for a DAG
+         *
+         * @return worker timeout, 0 means no limit
+         */
+        float getWorkerTimeout() const
+        {
+            return workerTimeout;
+        }
+
+        /**
+         * Sets the number of seconds a worker may take for a DAG. A worker that hangs without closing its connection 
+         * is considered lost after this time and its DAG is handed out again. With a deadline, the worker stops at 
+         * the deadline and the time is counted from there
+         *
+         * @param _workerTimeout The new worker timeout, 0 means no limit
+         */
+        void setWorkerTimeout(float _workerTimeout)
+        {
+            workerTimeout = _workerTimeout;
+        }
+
+        /**
+         * Returns the deadline of the workers
+         *
+         * @return deadline
+         */
+        std::chrono::steady_clock::time_point getDeadline() const
+        {
+            return deadline;
+        }
+
+        /**
+         * Sets the deadline of the workers. The time that remains when a DAG is handed out is the time budget of its
+         * worker
+         *
+         * @param _deadline The new deadline, time_point::max() means no limit
+         */
+        void setDeadline(std::chrono::steady_clock::time_point _deadline)
+        {
+            deadline = _deadline;
+        }
+
+        /**
+         * Hands out the given DAGs to the workers. Returns as soon as all DAGs are completed or the stop condition
+         * holds and no DAG is in progress. The completion handler is never called concurrently.
+         *
+         * @param _indices The indices of the DAGs to train
+         * @param _seed Returns the seed of a DAG
+         * @param _complete Is called for every completed DAG
+         * @param _stop Returns true if no more DAGs shall be handed out
+         * @throws RuntimeException If the coordinator cannot listen on its address or the completion handler fails
+         */
+        void run(const std::vector<int> & _indices, SeedFunction _seed, CompletionHandler _complete, StopCondition _stop) throw(RuntimeException);
+
+        /**
+         * Factory class for coordinators
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new coordinator
+             *
+             * @param _address The address to listen on
+             * @param _configuration The configuration that is sent to every worker
+             * @return new coordinator
+             */
+            static Coordinator::ptr create(const std::string & _address, const std::string & _configuration)
+            {
+                Coordinator::ptr coordinator(new Coordinator());
+                coordinator->address = _address;
+                coordinator->configuration = _configuration;
+                return coordinator;
+            }
+        };
+    };
+
+    /**
+     * A worker trains the DAGs that are handed out by a coordinator
+     */
+    class Worker {
+    public:
+        typedef Worker self;
+        typedef std::shared_ptr<self> ptr;
+
+        /**
+         * Is called once with the configuration of the coordinator
+         */
+        typedef std::function<void(const std::string &)> ConfigurationHandler;
+
+        /**
+         * Trains the DAG with the given index, seed and time budget in seconds (0 means no limit). Returns the compact
+         * root node, stores the arena that holds the DAG in the fourth parameter and whether or not the DAG was 
+         * interrupted by the time budget in the last parameter.
+         */
+        typedef std::function<DAGNode::ptr(int, unsigned int, float, MemoryArena::ptr &, bool &)> TrainFunction;
+
+    private:
+        /**
+         * The address of the coordinator
+         */
+        std::string address;
+
+        /**
+         * Processes the messages of the coordinator
+         *
+         * @return The number of trained DAGs
+         */
+        int serve(std::iostream & _stream, ConfigurationHandler _configure, TrainFunction _train);
+
+    public:
+        /**
+         * Returns the address of the coordinator
+         *
+         * @return address
+         */
+        const std::string & getAddress() const
+        {
+            return address;
+        }
+
+        /**
+         * Connects to the coordinator and trains DAGs until the coordinator has no DAGs left
+         *
+         * @param _configure Is called once with the configuration of the coordinator
+         * @param _train Trains a single DAG
+         * @return The number of trained DAGs
+         * @throws RuntimeException If the connection fails. The exceptions of the handlers are passed on.
+         */
+        int run(ConfigurationHandler _configure, TrainFunction _train);
+
+        /**
+         * Factory class for workers
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new worker
+             *
+             * @param _address The address of the coordinator
+             * @return new worker
+             */
+            static Worker::ptr create(const std::string & _address)
+            {
+                Worker::ptr worker(new Worker());
+                worker->address = _address;
+                return worker;
+            }
+        };
+    };
+}
+
+#endif
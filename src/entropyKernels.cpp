@@ -0,0 +1,232 @@
+#include "entropyKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !USE_WIDE_COUNTS
+    #define ENTROPY_KERNELS_DISPATCH 1
+    #include <immintrin.h>
+#else
+    #define ENTROPY_KERNELS_DISPATCH 0
+#endif
+
+using namespace LibJungle;
+
+namespace {
+    /**
+     * The kernels process up to three histograms at once. The template parameter K determines how many of them
+     * are used.
+     */
+    typedef float (*Kernel)(const Count*, const Count*, const Count*, int);
+
+    /**
+     * Returns the sum of the i-th bins
+     */
+    template <int K>
+    inline Count binSum(const Count* a, const Count* b, const Count* c, int i)
+    {
+        Count result = a[i];
+        if (K > 1) result += b[i];
+        if (K > 2) result += c[i];
+        return result;
+    }
+
+    /**
+     * Scalar fallback. Empty bins don't need a branch because fastlog2(0) is finite.
+     */
+    template <int K>
+    float sumNLogNScalar(const Count* a, const Count* b, const Count* c, int n)
+    {
+        float result = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const float x = static_cast<float>(binSum<K>(a, b, c, i));
+            result += x * fastlog2(x);
+        }
+        return result;
+    }
+
+#if defined(__SSE2__) && !USE_WIDE_COUNTS
+    /**
+     * SSE2 version. This uses vfastlog2 from fastlog.h
+     */
+    template <int K>
+    float sumNLogNSSE2(const Count* a, const Count* b, const Count* c, int n)
+    {
+        v4sf acc = _mm_setzero_ps();
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            v4si counts = _mm_loadu_si128(reinterpret_cast<const v4si*>(a + i));
+            if (K > 1) counts = _mm_add_epi32(counts, _mm_loadu_si128(reinterpret_cast<const v4si*>(b + i)));
+            if (K > 2) counts = _mm_add_epi32(counts, _mm_loadu_si128(reinterpret_cast<const v4si*>(c + i)));
+
+            const v4sf x = _mm_cvtepi32_ps(counts);
+            acc = _mm_add_ps(acc, _mm_mul_ps(x, vfastlog2(x)));
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, acc);
+        float result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+        return result + sumNLogNScalar<K>(a + i, K > 1 ? b + i : b, K > 2 ? c + i : c, n - i);
+    }
+#endif
+
+#if ENTROPY_KERNELS_DISPATCH
+    /**
+     * fastlog2 for 8 floats
+     */
+    __attribute__((target("avx2")))
+    inline __m256 fastlog2AVX2(__m256 x)
+    {
+        const __m256i bits = _mm256_castps_si256(x);
+        const __m256 mx = _mm256_castsi256_ps(_mm256_or_si256(
+                _mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3f000000)));
+        const __m256 y = _mm256_mul_ps(_mm256_cvtepi32_ps(bits), _mm256_set1_ps(1.1920928955078125e-7f));
+
+        return _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(y, _mm256_set1_ps(124.22551499f)),
+                _mm256_mul_ps(_mm256_set1_ps(1.498030302f), mx)),
+                _mm256_div_ps(_mm256_set1_ps(1.72587999f), _mm256_add_ps(_mm256_set1_ps(0.3520887068f), mx)));
+    }
+
+    /**
+     * AVX2 version
+     */
+    template <int K>
+    __attribute__((target("avx2")))
+    float sumNLogNAVX2(const Count* a, const Count* b, const Count* c, int n)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i counts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            if (K > 1) counts = _mm256_add_epi32(counts, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+            if (K > 2) counts = _mm256_add_epi32(counts, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c + i)));
+
+            const __m256 x = _mm256_cvtepi32_ps(counts);
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(x, fastlog2AVX2(x)));
+        }
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, acc);
+        float result = 0;
+        for (int j = 0; j < 8; j++)
+        {
+            result += lanes[j];
+        }
+
+        return result + sumNLogNScalar<K>(a + i, K > 1 ? b + i : b, K > 2 ? c + i : c, n - i);
+    }
+
+    /**
+     * fastlog2 for 16 floats
+     */
+    __attribute__((target("avx512f")))
+    inline __m512 fastlog2AVX512(__m512 x)
+    {
+        const __m512i bits = _mm512_castps_si512(x);
+        const __m512 mx = _mm512_castsi512_ps(_mm512_or_si512(
+                _mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3f000000)));
+        const __m512 y = _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(0xFFFF, bits), _mm512_set1_ps(1.1920928955078125e-7f));
+
+        return _mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(y, _mm512_set1_ps(124.22551499f)),
+                _mm512_mul_ps(_mm512_set1_ps(1.498030302f), mx)),
+                _mm512_div_ps(_mm512_set1_ps(1.72587999f), _mm512_add_ps(_mm512_set1_ps(0.3520887068f), mx)));
+    }
+
+    /**
+     * AVX-512 version
+     */
+    template <int K>
+    __attribute__((target("avx512f")))
+    float sumNLogNAVX512(const Count* a, const Count* b, const Count* c, int n)
+    {
+        __m512 acc = _mm512_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512i counts = _mm512_loadu_si512(a + i);
+            if (K > 1) counts = _mm512_add_epi32(counts, _mm512_loadu_si512(b + i));
+            if (K > 2) counts = _mm512_add_epi32(counts, _mm512_loadu_si512(c + i));
+
+            // The masked conversion avoids a spurious uninitialized warning in some GCC versions
+            const __m512 x = _mm512_maskz_cvtepi32_ps(0xFFFF, counts);
+            acc = _mm512_add_ps(acc, _mm512_mul_ps(x, fastlog2AVX512(x)));
+        }
+
+        float lanes[16];
+        _mm512_storeu_ps(lanes, acc);
+        float result = 0;
+        for (int j = 0; j < 16; j++)
+        {
+            result += lanes[j];
+        }
+
+        // The remaining bins are handled by the AVX2 kernel
+        return result + sumNLogNAVX2<K>(a + i, K > 1 ? b + i : b, K > 2 ? c + i : c, n - i);
+    }
+#endif
+
+    /**
+     * The selected kernels for one, two and three histograms
+     */
+    struct KernelTable {
+        Kernel kernels[3];
+        const char* name;
+    };
+
+    /**
+     * Selects the best kernels for the executing CPU
+     */
+    KernelTable selectKernels()
+    {
+#if ENTROPY_KERNELS_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            KernelTable table = {{sumNLogNAVX512<1>, sumNLogNAVX512<2>, sumNLogNAVX512<3>}, "AVX-512"};
+            return table;
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            KernelTable table = {{sumNLogNAVX2<1>, sumNLogNAVX2<2>, sumNLogNAVX2<3>}, "AVX2"};
+            return table;
+        }
+#endif
+#if USE_WIDE_COUNTS
+        KernelTable table = {{sumNLogNScalar<1>, sumNLogNScalar<2>, sumNLogNScalar<3>}, "scalar (wide counts)"};
+#elif defined(__SSE2__)
+        KernelTable table = {{sumNLogNSSE2<1>, sumNLogNSSE2<2>, sumNLogNSSE2<3>}, "SSE2"};
+#else
+        KernelTable table = {{sumNLogNScalar<1>, sumNLogNScalar<2>, sumNLogNScalar<3>}, "scalar"};
+#endif
+        return table;
+    }
+
+    const KernelTable kernelTable = selectKernels();
+}
+
+float EntropyKernels::sumNLogN(const Count* a, int n)
+{
+    return kernelTable.kernels[0](a, 0, 0, n);
+}
+
+float EntropyKernels::sumNLogN(const Count* a, const Count* b, int n)
+{
+    return kernelTable.kernels[1](a, b, 0, n);
+}
+
+float EntropyKernels::sumNLogN(const Count* a, const Count* b, const Count* c, int n)
+{
+    return kernelTable.kernels[2](a, b, c, n);
+}
+
+const char* EntropyKernels::getInstructionSet()
+{
+    return kernelTable.name;
+}
+
+const NLogNTable & NLogNTable::getDefault()
+{
+    static const NLogNTable table(4096);
+    return table;
+}
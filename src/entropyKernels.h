@@ -0,0 +1,193 @@
+/**
+ * This file contains vectorized kernels for the entropy computations on class histograms. There are SSE2, AVX2 and
+ * AVX-512 variants as well as a scalar fallback. The best variant for the executing CPU is selected at run time.
+ *
+ * @version 1.0
+ */
+#ifndef ENTROPY_KERNELS_H
+#define ENTROPY_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "config.h"
+#include "fastlog.h"
+
+namespace LibJungle
+{
+    /**
+     * The type of class counts and histogram masses. Builds with wide counts (cmake -DDecisionJungle_WIDE_COUNTS=ON)
+     * use 64 bit counts, so that a histogram can hold more than 2^31 examples. This doubles the size of every bin.
+     */
+#if USE_WIDE_COUNTS
+    typedef long long Count;
+#else
+    typedef int Count;
+#endif
+
+    /**
+     * Entropy kernels over contiguous integer bins. The vectorized variants work on 32 bit lanes and are only used
+     * if Count is 32 bit wide.
+     *
+     * All entropies are computed based on the identity
+     * H = -sum_i c_i/S log2(c_i/S) = log2(S) - 1/S sum_i c_i log2(c_i)
+     * where S is the mass of the histogram. The sum on the right hand side does not depend on S and can be
+     * evaluated without any branches.
+     */
+    class EntropyKernels {
+    public:
+        /**
+         * Computes sum_i a_i log2(a_i)
+         *
+         * @param a The bins
+         * @param n The number of bins
+         * @return The sum
+         */
+        static float sumNLogN(const Count* a, int n);
+
+        /**
+         * Computes sum_i (a_i + b_i) log2(a_i + b_i)
+         *
+         * @param a The bins of the first histogram
+         * @param b The bins of the second histogram
+         * @param n The number of bins
+         * @return The sum
+         */
+        static float sumNLogN(const Count* a, const Count* b, int n);
+
+        /**
+         * Computes sum_i (a_i + b_i + c_i) log2(a_i + b_i + c_i)
+         *
+         * @param a The bins of the first histogram
+         * @param b The bins of the second histogram
+         * @param c The bins of the third histogram
+         * @param n The number of bins
+         * @return The sum
+         */
+        static float sumNLogN(const Count* a, const Count* b, const Count* c, int n);
+
+        /**
+         * Computes the entropy of a histogram from its mass and sum_i c_i log2(c_i)
+         *
+         * @param mass The mass of the histogram
+         * @param sumNLogN The sum as computed by sumNLogN()
+         * @return The entropy
+         */
+        static float entropy(float mass, float sumNLogN)
+        {
+            if (mass < 1) return 0;
+            return fastlog2(mass) - sumNLogN / mass;
+        }
+
+        /**
+         * Computes the entropy of a histogram weighted by its mass, i.e. S * H.
+         *
+         * @param mass The mass of the histogram
+         * @param sumNLogN The sum as computed by sumNLogN()
+         * @return The weighted entropy
+         */
+        static float weightedEntropy(float mass, float sumNLogN)
+        {
+            if (mass < 1) return 0;
+            return mass * fastlog2(mass) - sumNLogN;
+        }
+
+        /**
+         * Returns the name of the instruction set that is used by the kernels
+         *
+         * @return name of the instruction set
+         */
+        static const char* getInstructionSet();
+    };
+    
+    /**
+     * A lookup table for n log2(n) on integer counts. The incremental entropy updates during threshold search 
+     * only need these values. The entries are computed with std::log2 in double precision, because the weighted 
+     * impurity subtracts the terms from the one of the mass. The table covers the counts up to the training set 
+     * size of a DAG, but at most maxTableSize entries in order to stay cache resident. Larger counts are computed 
+     * with std::log2 as well.
+     */
+    class NLogNTable {
+    private:
+        /**
+         * The precomputed values n log2(n)
+         */
+        std::vector<double> values;
+        
+    public:
+        typedef NLogNTable self;
+        typedef std::shared_ptr<self> ptr;
+        
+        /**
+         * The maximum number of entries
+         */
+        static const int maxTableSize = 1 << 16;
+        
+        /**
+         * Default constructor
+         * 
+         * @param _maxCount The largest count that shall be looked up
+         */
+        explicit NLogNTable(Count _maxCount)
+        {
+            const int size = static_cast<int>(std::max<Count>(1, std::min<Count>(_maxCount + 1, maxTableSize)));
+            values.resize(size);
+            values[0] = 0;
+            for (int n = 1; n < size; n++)
+            {
+                values[n] = n * std::log2(static_cast<double>(n));
+            }
+        }
+        
+        /**
+         * Returns n log2(n). Counts beyond the table are computed on the fly
+         * 
+         * @param n The count
+         * @return n log2(n)
+         */
+        double get(Count n) const
+        {
+            if (n < static_cast<Count>(values.size())) return values[n];
+            
+            const double x = static_cast<double>(n);
+            return x * std::log2(x);
+        }
+        
+        /**
+         * Returns the number of entries in the table
+         * 
+         * @return table size
+         */
+        int size() const
+        {
+            return static_cast<int>(values.size());
+        }
+        
+        /**
+         * Returns a small table that is shared by all histograms that don't have a table of their own
+         * 
+         * @return the default table
+         */
+        static const NLogNTable & getDefault();
+        
+        /**
+         * Factory class for tables
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new table
+             * 
+             * @param _maxCount The largest count that shall be looked up
+             * @return new table
+             */
+            static NLogNTable::ptr create(Count _maxCount)
+            {
+                return NLogNTable::ptr(new NLogNTable(_maxCount));
+            }
+        };
+    };
+}
+
+#endif
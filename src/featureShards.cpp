@@ -0,0 +1,659 @@
+#include "featureShards.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <boost/tokenizer.hpp>
+
+using namespace LibJungle;
+
+namespace {
+    /**
+     * Returns the bit pattern of a float
+     */
+    unsigned int floatToBits(float value)
+    {
+        unsigned int bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    /**
+     * Returns the float of a bit pattern
+     */
+    float bitsToFloat(unsigned int bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /**
+     * Appends a dense histogram in its sparse form "{bins} {class} {count} ..."
+     */
+    void writeHistogram(std::ostream & out, const std::vector<Count> & histogram)
+    {
+        int bins = 0;
+        for (size_t i = 0; i < histogram.size(); i++)
+        {
+            if (histogram[i] != 0) bins++;
+        }
+        out << ' ' << bins;
+        for (size_t i = 0; i < histogram.size(); i++)
+        {
+            if (histogram[i] != 0)
+            {
+                out << ' ' << i << ' ' << histogram[i];
+            }
+        }
+    }
+
+    /**
+     * Reads a sparse histogram
+     */
+    bool readHistogram(std::istream & in, ClassHistogram & histogram)
+    {
+        int bins = 0;
+        in >> bins;
+        for (int i = 0; i < bins && in; i++)
+        {
+            int bin;
+            Count count;
+            in >> bin >> count;
+            if (!in || bin < 0 || bin >= histogram.size())
+            {
+                return false;
+            }
+            histogram.add(bin, count);
+        }
+        return static_cast<bool>(in);
+    }
+
+    /**
+     * The state of a shard worker
+     */
+    struct ShardState {
+        /**
+         * The class labels and the feature columns of this shard
+         */
+        TrainingSet::ptr trainingSet;
+
+        /**
+         * The column of every feature in the data points of this shard or -1 if the feature belongs to another shard
+         */
+        std::vector<int> localFeature;
+
+        /**
+         * The mirrored example index of the coordinator and its partition buffer
+         */
+        std::vector<WeightedExample> exampleIndex;
+        std::vector<WeightedExample> exampleIndexBuffer;
+
+        /**
+         * The examples of a node are sorted in this buffer. The example index keeps the order of the coordinator
+         */
+        std::vector<WeightedExample> sortBuffer;
+
+        /**
+         * The settings of the current DAG
+         */
+        int classCount;
+        int histogramBins;
+        SplitCriterion criterion;
+        NLogNTable::ptr nlognTable;
+
+        ShardState() : classCount(0), histogramBins(0), criterion(SplitCriterionEntropy) {}
+    };
+
+    /**
+     * Tests the sampled features of this shard on a node. Returns the position of the best feature or -1.
+     */
+    template <int Bins, class Criterion>
+    int sweepFeatures(ShardState & state, size_t offset, size_t size, const std::vector<int> & features,
+            const ClassHistogram & leftBase, const ClassHistogram & rightBase, const ClassHistogram & nodeHistogram,
+            float & bestError, float & bestThreshold)
+    {
+        ThresholdEntropyErrorFunction<Bins, Criterion> error(leftBase, rightBase, nodeHistogram, *state.nlognTable);
+
+        int bestPosition = -1;
+        for (size_t i = 0; i < features.size(); i++)
+        {
+            const int feature = state.localFeature[features[i]];
+            if (feature < 0) continue;
+
+            state.sortBuffer.assign(state.exampleIndex.begin() + offset, state.exampleIndex.begin() + offset + size);
+            TrainingExampleComparator compare(feature);
+            std::sort(state.sortBuffer.begin(), state.sortBuffer.end(), compare);
+
+            if (error.sweep(state.sortBuffer.data(), size, feature, bestError, bestThreshold))
+            {
+                bestPosition = static_cast<int>(i);
+            }
+        }
+        return bestPosition;
+    }
+
+    /**
+     * Selects the histogram implementation for the class count of the current DAG
+     */
+    template <class Criterion>
+    int sweepFeatures(ShardState & state, size_t offset, size_t size, const std::vector<int> & features,
+            const ClassHistogram & leftBase, const ClassHistogram & rightBase, const ClassHistogram & nodeHistogram,
+            float & bestError, float & bestThreshold)
+    {
+        switch (state.histogramBins)
+        {
+            case 2:
+                return sweepFeatures<2, Criterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+            case 4:
+                return sweepFeatures<4, Criterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+            case 8:
+                return sweepFeatures<8, Criterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+            case 16:
+                return sweepFeatures<16, Criterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+            case 32:
+                return sweepFeatures<32, Criterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+            default:
+                return sweepFeatures<0, Criterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+        }
+    }
+
+    /**
+     * Answers a THRESHOLD request
+     */
+    std::string findThreshold(ShardState & state, std::istringstream & message)
+    {
+        size_t offset, size, count;
+        unsigned int errorBits;
+        message >> offset >> size >> errorBits >> count;
+        if (!message || offset + size > state.exampleIndex.size())
+        {
+            throw RuntimeException("Unexpected message from the coordinator.");
+        }
+
+        const int featureDimension = static_cast<int>(state.localFeature.size());
+        std::vector<int> features(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            message >> features[i];
+            if (features[i] < 0 || features[i] >= featureDimension)
+            {
+                throw RuntimeException("Unexpected message from the coordinator.");
+            }
+        }
+
+        // Histograms with compile-time bins read all of their bins, see TrainingDAGNode::Factory::create()
+        const int bins = std::max(state.classCount, state.histogramBins);
+        ClassHistogram leftBase(bins);
+        ClassHistogram rightBase(bins);
+        if (!readHistogram(message, leftBase) || !readHistogram(message, rightBase))
+        {
+            throw RuntimeException("Unexpected message from the coordinator.");
+        }
+
+        ClassHistogram nodeHistogram(bins);
+        WeightedExample* begin = state.exampleIndex.data() + offset;
+        TrainingUtil::computHistogram(nodeHistogram, begin, begin + size);
+
+        float bestError = bitsToFloat(errorBits);
+        float bestThreshold = 0;
+        int position;
+        switch (state.criterion)
+        {
+            case SplitCriterionGini:
+                position = sweepFeatures<GiniCriterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+                break;
+            default:
+                position = sweepFeatures<EntropyCriterion>(state, offset, size, features, leftBase, rightBase, nodeHistogram, bestError, bestThreshold);
+                break;
+        }
+
+        std::ostringstream reply;
+        reply << position;
+        if (position >= 0)
+        {
+            reply << ' ' << floatToBits(bestThreshold) << ' ' << floatToBits(bestError);
+        }
+        reply << '\n';
+        return reply.str();
+    }
+
+    /**
+     * Answers a PARTITION request
+     */
+    std::string partition(ShardState & state, std::istringstream & message)
+    {
+        size_t offset, size;
+        int feature;
+        unsigned int thresholdBits;
+        message >> offset >> size >> feature >> thresholdBits;
+        if (!message || offset + size > state.exampleIndex.size() || feature < 0 ||
+                feature >= static_cast<int>(state.localFeature.size()) || state.localFeature[feature] < 0)
+        {
+            throw RuntimeException("Unexpected message from the coordinator.");
+        }
+
+        const int local = state.localFeature[feature];
+        const float threshold = bitsToFloat(thresholdBits);
+        std::string reply(size + 1, '\n');
+        for (size_t i = 0; i < size; i++)
+        {
+            reply[i] = state.exampleIndex[offset + i].example->getDataPoint()->at(local) <= threshold ? '1' : '0';
+        }
+        return reply;
+    }
+
+    /**
+     * Carries out a SPLIT request in the same way as DAGTrainer::trainLevel()
+     */
+    void split(ShardState & state, std::istringstream & message, std::istream & stream)
+    {
+        int childCount, parentCount;
+        message >> childCount >> parentCount;
+        if (!message || childCount < 1 || parentCount < 0)
+        {
+            throw RuntimeException("Unexpected message from the coordinator.");
+        }
+
+        std::vector<FeatureColumns::Split> parents(parentCount);
+        std::string line;
+        for (int i = 0; i < parentCount; i++)
+        {
+            std::getline(stream, line);
+            std::istringstream parent(line);
+            parent >> parents[i].offset >> parents[i].size >> parents[i].left >> parents[i].right;
+            if (!parent || parents[i].offset + parents[i].size > state.exampleIndex.size() ||
+                    parents[i].left < 0 || parents[i].left >= childCount || parents[i].right < 0 || parents[i].right >= childCount)
+            {
+                throw RuntimeException("Unexpected message from the coordinator.");
+            }
+        }
+
+        std::string left;
+        std::getline(stream, left);
+        if (!stream)
+        {
+            throw RuntimeException("Lost the connection to the coordinator.");
+        }
+
+        // Count the examples of every child node and assign the ranges
+        std::vector<size_t> childExampleCounts(childCount, 0);
+        size_t position = 0;
+        for (int i = 0; i < parentCount; i++)
+        {
+            for (size_t j = 0; j < parents[i].size; j++, position++)
+            {
+                if (position >= left.size())
+                {
+                    throw RuntimeException("Unexpected message from the coordinator.");
+                }
+                childExampleCounts[left[position] == '1' ? parents[i].left : parents[i].right]++;
+            }
+        }
+        size_t offset = 0;
+        for (int i = 0; i < childCount; i++)
+        {
+            const size_t childSize = childExampleCounts[i];
+            childExampleCounts[i] = offset;
+            offset += childSize;
+        }
+
+        // Propagate the examples. The partition is stable
+        position = 0;
+        for (int i = 0; i < parentCount; i++)
+        {
+            for (size_t j = 0; j < parents[i].size; j++, position++)
+            {
+                const int child = left[position] == '1' ? parents[i].left : parents[i].right;
+                state.exampleIndexBuffer[childExampleCounts[child]++] = state.exampleIndex[parents[i].offset + j];
+            }
+        }
+        state.exampleIndex.swap(state.exampleIndexBuffer);
+    }
+
+    /**
+     * Returns the number of features of the first row of a training set file
+     */
+    int countFeatures(const std::string & fileName)
+    {
+        std::ifstream in(fileName.c_str());
+        if (!in.is_open())
+        {
+            throw RuntimeException("Could not open training set file.");
+        }
+
+        typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            Tokenizer tok(line);
+            const int columns = static_cast<int>(std::distance(tok.begin(), tok.end()));
+            if (columns > 0)
+            {
+                return columns - 1;
+            }
+        }
+        return 0;
+    }
+}
+
+void FeatureShardCoordinator::send(int _shard, const std::string & _message) throw(RuntimeException)
+{
+    std::iostream & stream = *shards[_shard];
+    stream << _message << std::flush;
+    if (!stream)
+    {
+        throw RuntimeException("Lost a feature shard.");
+    }
+}
+
+std::string FeatureShardCoordinator::receive(int _shard) throw(RuntimeException)
+{
+    std::string line;
+    if (!std::getline(*shards[_shard], line))
+    {
+        throw RuntimeException("Lost a feature shard.");
+    }
+    return line;
+}
+
+void FeatureShardCoordinator::connect(size_t _rows) throw(RuntimeException)
+{
+    // The listener must outlive the connections
+    listener = Listener::Factory::create(address);
+    shards.assign(shardCount, std::shared_ptr<std::iostream>());
+
+    for (int k = 0; k < shardCount; k++)
+    {
+        shards[k] = listener->accept(-1);
+
+        std::ostringstream configuration;
+        configuration << "CONFIG " << k << ' ' << shardCount << ' ' << trainingSetFile.size() << '\n' << trainingSetFile;
+        send(k, configuration.str());
+
+        if (verboseMode)
+        {
+            std::cout << "Feature shard " << (k+1) << "/" << shardCount << " connected" << std::endl;
+        }
+    }
+
+    // Every shard loads its columns of the same training set
+    for (int k = 0; k < shardCount; k++)
+    {
+        std::istringstream reply(receive(k));
+        std::string keyword;
+        int dimension;
+        size_t rows;
+        reply >> keyword >> dimension >> rows;
+        if (keyword != "READY" || !reply)
+        {
+            throw RuntimeException("Unexpected message from a feature shard.");
+        }
+        if (rows != _rows || (k > 0 && dimension != featureDimension))
+        {
+            throw RuntimeException("The feature shards hold a different training set.");
+        }
+        featureDimension = dimension;
+    }
+}
+
+void FeatureShardCoordinator::beginDAG(const std::vector<int> & _weights, size_t _rows, int _classCount, SplitCriterion _criterion,
+        Count _totalWeight) throw(RuntimeException)
+{
+    std::ostringstream message;
+    message << "DAG " << _classCount << ' ' << static_cast<int>(_criterion) << ' ' << _totalWeight << '\n';
+    for (size_t i = 0; i < _rows; i++)
+    {
+        message << (i > 0 ? " " : "") << (_weights.empty() ? 1 : _weights[i]);
+    }
+    message << '\n';
+
+    for (int k = 0; k < shardCount; k++)
+    {
+        send(k, message.str());
+    }
+}
+
+bool FeatureShardCoordinator::findThreshold(size_t _offset, size_t _size, const std::vector<int> & _features,
+        const std::vector<Count> & _leftBase, const std::vector<Count> & _rightBase, float & _bestError, int & _bestFeature,
+        float & _bestThreshold) throw(RuntimeException)
+{
+    std::ostringstream message;
+    message << "THRESHOLD " << _offset << ' ' << _size << ' ' << floatToBits(_bestError) << ' ' << _features.size();
+    for (size_t i = 0; i < _features.size(); i++)
+    {
+        message << ' ' << _features[i];
+    }
+    writeHistogram(message, _leftBase);
+    writeHistogram(message, _rightBase);
+    message << '\n';
+
+    // All shards search at the same time
+    for (int k = 0; k < shardCount; k++)
+    {
+        send(k, message.str());
+    }
+
+    // Every shard only answers with a threshold that beats the given error. The order of the sampled features
+    // decides between equally good thresholds
+    int bestPosition = -1;
+    for (int k = 0; k < shardCount; k++)
+    {
+        std::istringstream reply(receive(k));
+        int position;
+        unsigned int thresholdBits, errorBits;
+        reply >> position;
+        if (!reply || position >= static_cast<int>(_features.size()))
+        {
+            throw RuntimeException("Unexpected message from a feature shard.");
+        }
+        if (position < 0) continue;
+
+        reply >> thresholdBits >> errorBits;
+        if (!reply)
+        {
+            throw RuntimeException("Unexpected message from a feature shard.");
+        }
+
+        const float error = bitsToFloat(errorBits);
+        if (bestPosition < 0 || error < _bestError || (error == _bestError && position < bestPosition))
+        {
+            bestPosition = position;
+            _bestError = error;
+            _bestThreshold = bitsToFloat(thresholdBits);
+        }
+    }
+
+    if (bestPosition < 0)
+    {
+        return false;
+    }
+    _bestFeature = _features[bestPosition];
+    return true;
+}
+
+void FeatureShardCoordinator::partition(size_t _offset, size_t _size, int _feature, float _threshold, char* _left) throw(RuntimeException)
+{
+    if (_size == 0) return;
+
+    // Only the shard of the feature knows its values
+    const int shard = _feature % shardCount;
+    std::ostringstream message;
+    message << "PARTITION " << _offset << ' ' << _size << ' ' << _feature << ' ' << floatToBits(_threshold) << '\n';
+    send(shard, message.str());
+
+    const std::string reply = receive(shard);
+    if (reply.size() != _size)
+    {
+        throw RuntimeException("Unexpected message from a feature shard.");
+    }
+    for (size_t i = 0; i < _size; i++)
+    {
+        _left[i] = reply[i] == '1' ? 1 : 0;
+    }
+}
+
+void FeatureShardCoordinator::split(int _childCount, const std::vector<Split> & _parents, const std::vector<char> & _left) throw(RuntimeException)
+{
+    std::ostringstream message;
+    message << "SPLIT " << _childCount << ' ' << _parents.size() << '\n';
+    for (size_t i = 0; i < _parents.size(); i++)
+    {
+        message << _parents[i].offset << ' ' << _parents[i].size << ' ' << _parents[i].left << ' ' << _parents[i].right << '\n';
+    }
+    for (size_t i = 0; i < _parents.size(); i++)
+    {
+        for (size_t j = 0; j < _parents[i].size; j++)
+        {
+            message << (_left[_parents[i].offset + j] ? '1' : '0');
+        }
+    }
+    message << '\n';
+
+    for (int k = 0; k < shardCount; k++)
+    {
+        send(k, message.str());
+    }
+}
+
+void FeatureShardCoordinator::endDAG() throw(RuntimeException)
+{
+    for (int k = 0; k < shardCount; k++)
+    {
+        send(k, "END\n");
+    }
+}
+
+void FeatureShardCoordinator::close()
+{
+    for (size_t k = 0; k < shards.size(); k++)
+    {
+        if (shards[k])
+        {
+            *shards[k] << "DONE\n" << std::flush;
+        }
+    }
+    shards.clear();
+    listener.reset();
+}
+
+int FeatureShardWorker::run() throw(RuntimeException)
+{
+    std::shared_ptr<std::iostream> connection = Connection::open(address);
+    std::iostream & stream = *connection;
+
+    // The configuration comes first
+    std::string line;
+    std::string keyword;
+    int shard = 0, shardCount = 0;
+    std::string::size_type size = 0;
+    if (!std::getline(stream, line))
+    {
+        throw RuntimeException("Could not connect to the coordinator.");
+    }
+    std::istringstream header(line);
+    header >> keyword >> shard >> shardCount >> size;
+    if (keyword != "CONFIG" || !header || shardCount < 1 || shard < 0 || shard >= shardCount)
+    {
+        throw RuntimeException("Unexpected message from the coordinator.");
+    }
+    std::string trainingSetFile(size, ' ');
+    stream.read(&trainingSetFile[0], size);
+    if (!stream)
+    {
+        throw RuntimeException("Lost the connection to the coordinator.");
+    }
+
+    // Load the columns of this shard
+    ShardState state;
+    const int featureDimension = countFeatures(trainingSetFile);
+    std::vector<int> features;
+    state.localFeature.assign(featureDimension, -1);
+    for (int f = shard; f < featureDimension; f += shardCount)
+    {
+        state.localFeature[f] = static_cast<int>(features.size());
+        features.push_back(f);
+    }
+    if (verboseMode)
+    {
+        std::cout << "Loading " << features.size() << " of " << featureDimension << " features of " << trainingSetFile << std::endl;
+    }
+    state.trainingSet = TrainingSet::Factory::createFromFile(trainingSetFile, false, features);
+    stream << "READY " << featureDimension << ' ' << state.trainingSet->size() << '\n' << std::flush;
+
+    int dagCount = 0;
+    while (std::getline(stream, line))
+    {
+        std::istringstream message(line);
+        message >> keyword;
+
+        if (keyword == "DONE")
+        {
+            return dagCount;
+        }
+        else if (keyword == "DAG")
+        {
+            // Set up the example index in the same way as DAGTrainer::train()
+            int criterion;
+            Count totalWeight;
+            message >> state.classCount >> criterion >> totalWeight;
+            std::getline(stream, line);
+            std::istringstream weights(line);
+            if (!message || !stream || state.classCount < 1)
+            {
+                throw RuntimeException("Unexpected message from the coordinator.");
+            }
+            state.criterion = static_cast<SplitCriterion>(criterion);
+            state.histogramBins = selectHistogramBins(state.classCount);
+            state.nlognTable = NLogNTable::Factory::create(totalWeight);
+
+            state.exampleIndex.clear();
+            for (size_t i = 0; i < state.trainingSet->size(); i++)
+            {
+                int weight = 0;
+                weights >> weight;
+                if (!weights)
+                {
+                    throw RuntimeException("Unexpected message from the coordinator.");
+                }
+                if (weight > 0)
+                {
+                    WeightedExample entry = {(*state.trainingSet)[i], weight, static_cast<RowIndex>(i)};
+                    state.exampleIndex.push_back(entry);
+                }
+            }
+            state.exampleIndexBuffer.resize(state.exampleIndex.size());
+
+            if (verboseMode)
+            {
+                std::cout << "DAG " << (dagCount + 1) << std::endl;
+            }
+        }
+        else if (keyword == "THRESHOLD")
+        {
+            stream << findThreshold(state, message) << std::flush;
+        }
+        else if (keyword == "PARTITION")
+        {
+            stream << partition(state, message) << std::flush;
+        }
+        else if (keyword == "SPLIT")
+        {
+            split(state, message, stream);
+        }
+        else if (keyword == "END")
+        {
+            std::vector<WeightedExample>().swap(state.exampleIndex);
+            std::vector<WeightedExample>().swap(state.exampleIndexBuffer);
+            std::vector<WeightedExample>().swap(state.sortBuffer);
+            state.nlognTable.reset();
+            dagCount++;
+        }
+        else
+        {
+            throw RuntimeException("Unexpected message from the coordinator.");
+        }
+    }
+
+    throw RuntimeException("Lost the connection to the coordinator.");
+}
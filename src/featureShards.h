@@ -0,0 +1,239 @@
+/**
+ * This file contains the coordinator and the workers for feature-sharded training. Every shard worker loads a subset
+ * of the feature columns of the training set: shard k of K holds the features f with f % K == k. The coordinator
+ * only holds the class labels. It grows the DAG as usual, but the threshold search and the partition of a node are
+ * carried out by the shards.
+ *
+ * Every shard mirrors the example index of the coordinator. A node is identified by the offset and the size of its
+ * range in this index. The coordinator sends the partition of every level to all shards, hence they keep the same
+ * order of examples.
+ *
+ * The protocol is line based. Floats are sent as their bit patterns in order to be exact:
+ *  coordinator -> shard: "CONFIG {shard} {shards} {size}\n" followed by {size} bytes holding the training set path
+ *  shard -> coordinator: "READY {featureDimension} {rows}\n"
+ *  coordinator -> shard: "DAG {classCount} {criterion} {totalWeight}\n" followed by a line of all example weights
+ *  coordinator -> shard: "THRESHOLD {offset} {size} {error} {n} {features...} {left base} {right base}\n"
+ *                        The bases are sparse histograms: "{bins} {class} {count} ..."
+ *  shard -> coordinator: "{position} {threshold} {error}\n" for the best sampled feature or "-1\n"
+ *  coordinator -> owner: "PARTITION {offset} {size} {feature} {threshold}\n"
+ *  owner -> coordinator: a line with one character per example: '1' if it goes to the left child, '0' otherwise
+ *  coordinator -> shard: "SPLIT {childCount} {parentCount}\n" followed by a line "{offset} {size} {left} {right}" per
+ *                        parent and a line with the partition of all parents
+ *  coordinator -> shard: "END\n" after every DAG and "DONE\n" after the last one
+ *
+ * @version 1.0
+ */
+#ifndef FEATURESHARDS_H
+#define FEATURESHARDS_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "jungleTrain.h"
+
+namespace LibJungle
+{
+    /**
+     * The coordinator side of feature-sharded training. It is used by a DAG trainer in order to find the thresholds
+     * and partitions of its nodes.
+     */
+    class FeatureShardCoordinator : public FeatureColumns {
+    public:
+        typedef FeatureShardCoordinator self;
+        typedef std::shared_ptr<self> ptr;
+
+    private:
+        /**
+         * The address to listen on
+         */
+        std::string address;
+
+        /**
+         * The number of shards
+         */
+        int shardCount;
+
+        /**
+         * The path of the training set that the shards load
+         */
+        std::string trainingSetFile;
+
+        /**
+         * The feature dimension of the training set as reported by the shards
+         */
+        int featureDimension;
+
+        /**
+         * Whether or not connected shards are reported
+         */
+        bool verboseMode;
+
+        /**
+         * The listener of the shards. The connections belong to it
+         */
+        Listener::ptr listener;
+
+        /**
+         * The connections to the shards. Shard k is stored at position k
+         */
+        std::vector< std::shared_ptr<std::iostream> > shards;
+
+        /**
+         * Reads a line from a shard
+         *
+         * @throws RuntimeException If the shard is lost
+         */
+        std::string receive(int _shard) throw(RuntimeException);
+
+        /**
+         * Sends a message to a shard
+         *
+         * @throws RuntimeException If the shard is lost
+         */
+        void send(int _shard, const std::string & _message) throw(RuntimeException);
+
+    public:
+        FeatureShardCoordinator() : shardCount(0), featureDimension(0), verboseMode(false) {}
+
+        /**
+         * Returns the number of shards
+         *
+         * @return number of shards
+         */
+        int getShardCount() const
+        {
+            return shardCount;
+        }
+
+        virtual int getFeatureDimension() const
+        {
+            return featureDimension;
+        }
+
+        /**
+         * Sets whether or not connected shards are reported
+         *
+         * @param _verboseMode The new verbose mode
+         */
+        void setVerboseMode(bool _verboseMode)
+        {
+            verboseMode = _verboseMode;
+        }
+
+        /**
+         * Waits until all shards are connected and have loaded their columns
+         *
+         * @param _rows The number of rows of the training set of the coordinator
+         * @throws RuntimeException If the address cannot be listened on or the shards don't match the training set
+         */
+        virtual void connect(size_t _rows) throw(RuntimeException);
+
+        virtual void beginDAG(const std::vector<int> & _weights, size_t _rows, int _classCount, SplitCriterion _criterion, Count _totalWeight) throw(RuntimeException);
+
+        /**
+         * All shards search their sampled features at the same time. 
+         */
+        virtual bool findThreshold(size_t _offset, size_t _size, const std::vector<int> & _features, const std::vector<Count> & _leftBase,
+                const std::vector<Count> & _rightBase, float & _bestError, int & _bestFeature, float & _bestThreshold) throw(RuntimeException);
+
+        /**
+         * Only the shard of the feature is asked. 
+         */
+        virtual void partition(size_t _offset, size_t _size, int _feature, float _threshold, char* _left) throw(RuntimeException);
+
+        virtual void split(int _childCount, const std::vector<Split> & _parents, const std::vector<char> & _left) throw(RuntimeException);
+
+        virtual void endDAG() throw(RuntimeException);
+
+        /**
+         * Releases the shards
+         */
+        virtual void close();
+
+        /**
+         * Factory class for the coordinator
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new coordinator
+             *
+             * @param _address The address to listen on
+             * @param _shardCount The number of shards
+             * @param _trainingSetFile The path of the training set that the shards load
+             * @return new coordinator
+             */
+            static FeatureShardCoordinator::ptr create(const std::string & _address, int _shardCount, const std::string & _trainingSetFile)
+            {
+                FeatureShardCoordinator::ptr coordinator(new FeatureShardCoordinator());
+                coordinator->address = _address;
+                coordinator->shardCount = _shardCount;
+                coordinator->trainingSetFile = _trainingSetFile;
+                return coordinator;
+            }
+        };
+    };
+
+    /**
+     * A shard worker holds some feature columns of the training set and answers the requests of the coordinator
+     */
+    class FeatureShardWorker {
+    public:
+        typedef FeatureShardWorker self;
+        typedef std::shared_ptr<self> ptr;
+
+    private:
+        /**
+         * The address of the coordinator
+         */
+        std::string address;
+
+        /**
+         * Whether or not the progress is reported
+         */
+        bool verboseMode;
+
+    public:
+        FeatureShardWorker() : verboseMode(false) {}
+
+        /**
+         * Sets whether or not the progress is reported
+         *
+         * @param _verboseMode The new verbose mode
+         */
+        void setVerboseMode(bool _verboseMode)
+        {
+            verboseMode = _verboseMode;
+        }
+
+        /**
+         * Connects to the coordinator and serves its requests until it is done
+         *
+         * @return The number of DAGs that were trained
+         * @throws RuntimeException If the connection fails or the training set cannot be loaded
+         */
+        int run() throw(RuntimeException);
+
+        /**
+         * Factory class for shard workers
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new shard worker
+             *
+             * @param _address The address of the coordinator
+             * @return new shard worker
+             */
+            static FeatureShardWorker::ptr create(const std::string & _address)
+            {
+                FeatureShardWorker::ptr worker(new FeatureShardWorker());
+                worker->address = _address;
+                return worker;
+            }
+        };
+    };
+}
+
+#endif
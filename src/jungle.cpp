@@ -1,5 +1,6 @@
 #include <map>
 #include <fstream>
+#include <sstream>
 #include <iterator>
 #include <boost/tokenizer.hpp>
 #include <boost/tokenizer.hpp>
@@ -18,7 +19,7 @@ PredictionResult::ptr DAGNode::predict(DataPoint::ptr featureVector) const
     // Compute the relative confidence
     if (leafNode->getClassHistogram()->getMass() > 0)
     {
-        return PredictionResult::Factory::create(leafNode->getClassLabel(), leafNode->getClassHistogram()->at(leafNode->getClassLabel())/leafNode->getClassHistogram()->getMass());
+        return PredictionResult::Factory::create(leafNode->getClassLabel(), static_cast<float>(leafNode->getClassHistogram()->at(leafNode->getClassLabel()))/leafNode->getClassHistogram()->getMass());
     }
     else
     {
@@ -109,6 +110,18 @@ DataPoint::ptr DataPoint::Factory::createFromFileRow(const std::vector<std::stri
     return dataPoint;
 }
 
+size_t ProgressBar::countLines(std::istream & in)
+{
+    std::vector<char> block(1 << 16);
+    size_t lineCount = 0;
+    while (in)
+    {
+        in.read(block.data(), block.size());
+        lineCount += static_cast<size_t>(std::count(block.data(), block.data() + in.gcount(), '\n'));
+    }
+    return lineCount;
+}
+
 DataSet::ptr DataSet::Factory::createFromFile(const std::string & _fileName, bool _verboseMode)
 {
     // Create a blank training set and load the file line by line
@@ -124,7 +137,7 @@ DataSet::ptr DataSet::Factory::createFromFile(const std::string & _fileName, boo
 
     // Count the number of lines in order to display the progress bar
     std::ifstream countFile(_fileName); 
-    int lineCount = std::count(std::istreambuf_iterator<char>(countFile), std::istreambuf_iterator<char>(), '\n');
+    size_t lineCount = ProgressBar::countLines(countFile);
     
     ProgressBar::ptr progressBar = ProgressBar::Factory::create(lineCount);
     
@@ -159,16 +172,83 @@ DataSet::ptr DataSet::Factory::createFromFile(const std::string & _fileName, boo
     return trainingSet;
 }
 
-void DAGNode::Factory::serialize(DAGNode::ptr node, bool isRoot, std::ofstream & outfile)
+DAGNode::ptr DAGNode::Factory::compact(DAGNode::ptr root, MemoryArena::ptr & arena)
+{
+    // Enumerate all nodes in breadth first order. Nodes can have several parents, hence we have to remember which 
+    // nodes we already visited
+    std::vector<DAGNode::ptr> nodes;
+    std::map<DAGNode::ptr, int> index;
+    
+    nodes.push_back(root);
+    index[root] = 0;
+    
+    // We also need the amount of memory for the leaf histograms
+    size_t histogramBytes = 0;
+    
+    for (std::vector<DAGNode::ptr>::size_type i = 0; i < nodes.size(); i++)
+    {
+        DAGNode::ptr current = nodes[i];
+        
+        if (current->getLeft() == 0)
+        {
+            histogramBytes += sizeof(ClassHistogram) + alignof(ClassHistogram) + current->getClassHistogram()->size() * sizeof(Count) + alignof(Count);
+            continue;
+        }
+        
+        if (index.find(current->getLeft()) == index.end())
+        {
+            index[current->getLeft()] = nodes.size();
+            nodes.push_back(current->getLeft());
+        }
+        if (index.find(current->getRight()) == index.end())
+        {
+            index[current->getRight()] = nodes.size();
+            nodes.push_back(current->getRight());
+        }
+    }
+    
+    // Create an arena that fits the compact DAG in one chunk
+    const size_t nodeBytes = nodes.size() * sizeof(DAGNode) + alignof(DAGNode);
+    arena = MemoryArena::Factory::create(nodeBytes + histogramBytes, false);
+    
+    DAGNode::ptr result = static_cast<DAGNode::ptr>(arena->allocate(nodes.size() * sizeof(DAGNode), alignof(DAGNode)));
+    
+    for (std::vector<DAGNode::ptr>::size_type i = 0; i < nodes.size(); i++)
+    {
+        DAGNode::ptr current = nodes[i];
+        DAGNode::ptr node = new (result + i) DAGNode();
+        
+        node->setFeatureID(current->getFeatureID());
+        node->setThreshold(current->getThreshold());
+        node->setClassLabel(current->getClassLabel());
+        
+        if (current->getLeft() == 0)
+        {
+            // Only leaf nodes keep their class histogram
+            const ClassHistogram* histogram = current->getClassHistogram();
+            node->setClassHistogram(DAGNode::Factory::createClassHistogram(histogram->size(), *arena));
+            node->getClassHistogram()->add(*histogram);
+        }
+        else
+        {
+            node->setLeft(result + index[current->getLeft()]);
+            node->setRight(result + index[current->getRight()]);
+        }
+    }
+    
+    return result;
+}
+
+void DAGNode::Factory::serialize(DAGNode::ptr node, DAGNode::ptr root, int firstID, std::ostream & outfile)
 {
     /**
      * The serialized model has the following structure
      * 
      * [nodeID], [isRoot], [featureID], [threshold], [left child ID], [right child ID], [class label], "[class histogram]"
      */
-    outfile << node->getID() << ',';
+    outfile << firstID + (node - root) << ',';
     
-    if (isRoot)
+    if (node == root)
     {
         outfile << "1,";
     }
@@ -183,7 +263,7 @@ void DAGNode::Factory::serialize(DAGNode::ptr node, bool isRoot, std::ofstream &
     if (node->getLeft() != 0)
     {
         // Don't store a class histogram or a class label
-        outfile << node->getLeft()->getID() << ',' << node->getRight()->getID() << ",,,\n";
+        outfile << firstID + (node->getLeft() - root) << ',' << firstID + (node->getRight() - root) << ",,,\n";
     }
     else
     {
@@ -212,26 +292,84 @@ Jungle::ptr Jungle::Factory::createFromFile(const std::string& _filename, bool _
     std::ifstream in(_filename);
     if (!in.is_open())
     {
-        throw RuntimeException("Could not open training set file.");
+        throw RuntimeException("Could not open model file.");
     }
 
     // Count the number of lines in order to display the progress bar
     std::ifstream countFile(_filename); 
-    int lineCount = std::count(std::istreambuf_iterator<char>(countFile), std::istreambuf_iterator<char>(), '\n');
+    size_t lineCount = ProgressBar::countLines(countFile);
     countFile.close();
     
-    ProgressBar::ptr progressBar = ProgressBar::Factory::create(lineCount);
+    return createFromStream(in, lineCount, _verboseMode);
+}
+
+Jungle::ptr Jungle::Factory::createFromStream(std::istream & in, size_t _lineCount, bool _verboseMode)
+{
+    ProgressBar::ptr progressBar = ProgressBar::Factory::create(_lineCount);
     
     typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
 
     std::vector< std::string > row;
     std::string line;
     
-    // We keep all created nodes under their ID in this map
+    // We keep all created nodes of the current block under their ID in this map
     std::map<int, DAGNode::ptr> nodes;
+    // The IDs of the child nodes
+    std::map<int, std::pair<int, int> > childIDs;
+    // The root nodes of the DAGs
+    std::vector<DAGNode::ptr> roots;
+    // The number of rows of the current block
+    int rowCount = 0;
+    // Whether or not the file is framed into blocks, see ModelWriter
+    bool framed = false;
     
     Jungle::ptr jungle = Jungle::Factory::create();
     
+    // The nodes of a block are first loaded into one arena. Afterwards every DAG is compacted into its own arena
+    MemoryArena::ptr arena = MemoryArena::Factory::create(false);
+    
+    // Links the nodes of the current block and adds its DAGs to the jungle
+    auto finishBlock = [&]() {
+        // Recover all child node assignments
+        for (std::map<int, DAGNode::ptr>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+        {
+            DAGNode::ptr node = it->second;
+            const std::pair<int, int> & children = childIDs[it->first];
+
+            // Is this a child node?
+            if (children.first == 0)
+            {
+                // Yep, nothing to do here
+                node->setLeft(0);
+                node->setRight(0);
+            }
+            else if (nodes.find(children.first) == nodes.end() || nodes.find(children.second) == nodes.end())
+            {
+                throw RuntimeException("Invalid child node ID in model file.");
+            }
+            else
+            {
+                // Nope, recover the pointers
+                node->setLeft(nodes[children.first]);
+                node->setRight(nodes[children.second]);
+            }
+        }
+
+        // Store every DAG in its compact representation
+        for (std::vector<DAGNode::ptr>::iterator it = roots.begin(); it != roots.end(); ++it)
+        {
+            MemoryArena::ptr dagArena;
+            DAGNode::ptr root = DAGNode::Factory::compact(*it, dagArena);
+            jungle->addDAG(root, dagArena);
+        }
+        
+        nodes.clear();
+        childIDs.clear();
+        roots.clear();
+        rowCount = 0;
+        arena = MemoryArena::Factory::create(false);
+    };
+    
     while (std::getline(in,line))
     {
         if (_verboseMode)
@@ -239,6 +377,18 @@ Jungle::ptr Jungle::Factory::createFromFile(const std::string& _filename, bool _
             progressBar->update();
         }
         
+        // A trailer row ends a block. It holds the number of rows in the block
+        if (line.size() > 0 && line[0] == '#')
+        {
+            if (atoi(line.c_str() + 1) != rowCount)
+            {
+                throw RuntimeException("Invalid block in model file.");
+            }
+            framed = true;
+            finishBlock();
+            continue;
+        }
+        
         Tokenizer tok(line);
         row.assign(tok.begin(),tok.end());
 
@@ -252,50 +402,210 @@ Jungle::ptr Jungle::Factory::createFromFile(const std::string& _filename, bool _
         bool isRootNode = atoi(row[1].c_str()) == 1;
         
         // Unserialize the node
-        DAGNode::ptr node = DAGNode::Factory::unserialize(row);
+        DAGNode::ptr node = DAGNode::Factory::unserialize(row, *arena);
         nodes[nodeID] = node;
+        childIDs[nodeID] = std::make_pair(atoi(row[4].c_str()), atoi(row[5].c_str()));
+        rowCount++;
         
         if (isRootNode)
         {
-            jungle->getDAGs().insert(node);
+            roots.push_back(node);
         }
     }
     
-    // Recover all child node assignments
-    for (std::map<int, DAGNode::ptr>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+    // Files without blocks consist of one large block. In framed files, rows after the last trailer belong to a 
+    // block that was not written completely
+    if (!framed)
     {
-        DAGNode::ptr node = it->second;
+        finishBlock();
+    }
+    
+    return jungle;
+}
+
+void Jungle::Factory::serialize(Jungle::ptr jungle, const std::string & filename, bool framed)
+{
+    if (framed)
+    {
+        ModelWriter::ptr writer = ModelWriter::Factory::create(filename, false);
+
+        for (std::set<DAGNode::ptr>::iterator it = jungle->dags.begin(); it != jungle->dags.end(); ++it)
+        {
+            writer->write(*it);
+        }
+        return;
+    }
+    
+    std::ofstream outfile(filename);
+    if (!outfile.is_open())
+    {
+        throw RuntimeException("Could not open model file.");
+    }
+    
+    // The node IDs of every DAG continue after the IDs of the previous DAG
+    int firstID = 1;
+    for (std::set<DAGNode::ptr>::iterator it = jungle->dags.begin(); it != jungle->dags.end(); ++it)
+    {
+        const int nodeCount = DAGNode::Factory::compactSize(*it);
+        for (int i = 0; i < nodeCount; i++)
+        {
+            DAGNode::Factory::serialize(*it + i, *it, firstID, outfile);
+        }
+        firstID += nodeCount;
+    }
+    
+    if (!outfile)
+    {
+        throw RuntimeException("Could not write model file.");
+    }
+}
+
+Jungle::ptr Jungle::Factory::merge(const std::vector<std::string> & filenames, int maxParallel) throw(RuntimeException)
+{
+    std::vector<Jungle::ptr> jungles(filenames.size());
+    std::vector<RuntimeException> errors(filenames.size());
+    std::vector<char> failed(filenames.size(), 0);
+    
+    // Exceptions must not leave the parallel region
+    #pragma omp parallel for schedule(dynamic) num_threads(maxParallel)
+    for (int i = 0; i < static_cast<int>(filenames.size()); i++)
+    {
+        try {
+            jungles[i] = createFromFile(filenames[i], false);
+        }
+        catch (RuntimeException & e) {
+            errors[i] = e;
+            failed[i] = 1;
+        }
+        catch (std::exception &) {
+            errors[i] = RuntimeException("Could not load model file.");
+            failed[i] = 1;
+        }
+    }
+    
+    Jungle::ptr result = create();
+    int classCount = 0;
+    for (size_t i = 0; i < jungles.size(); i++)
+    {
+        if (failed[i])
+        {
+            throw errors[i];
+        }
         
-        // Is this a child node?
-        if (node->getTempLeft() == 0)
+        const int currentClassCount = jungles[i]->getClassCount();
+        if (currentClassCount == 0)
         {
-            // Yep, nothing to do here
-            node->setLeft(0);
-            node->setRight(0);
+            continue;
         }
-        else
+        if (classCount != 0 && currentClassCount != classCount)
         {
-            // Nope, recover the pointers
-            node->setLeft(nodes[node->getTempLeft()]);
-            node->setRight(nodes[node->getTempRight()]);
+            throw RuntimeException("The models have different numbers of classes.");
         }
+        classCount = currentClassCount;
+        
+        result->dags.insert(jungles[i]->dags.begin(), jungles[i]->dags.end());
+        result->arenas.insert(result->arenas.end(), jungles[i]->arenas.begin(), jungles[i]->arenas.end());
     }
     
-    return jungle;
+    return result;
+}
+
+int Jungle::getClassCount() const throw(RuntimeException)
+{
+    int classCount = 0;
+    for (std::set<DAGNode::ptr>::const_iterator it = dags.begin(); it != dags.end(); ++it)
+    {
+        const int nodeCount = DAGNode::Factory::compactSize(*it);
+        for (int i = 0; i < nodeCount; i++)
+        {
+            DAGNode::ptr node = *it + i;
+            if (node->getLeft() != 0)
+            {
+                continue;
+            }
+            
+            if (classCount != 0 && node->getClassHistogram()->size() != classCount)
+            {
+                throw RuntimeException("The leaves have different numbers of classes.");
+            }
+            classCount = node->getClassHistogram()->size();
+        }
+    }
+    return classCount;
+}
+
+void ModelWriter::write(DAGNode::ptr root, int index)
+{
+    // Write the whole block at once
+    std::ostringstream block;
+    DAGNode::Factory::serializeDAG(root, block, index);
+    
+    const std::string data = block.str();
+    outfile.write(data.data(), data.size());
+    outfile.flush();
+    
+    if (!outfile)
+    {
+        throw RuntimeException("Could not write model file.");
+    }
+}
+
+ModelWriter::ptr ModelWriter::Factory::create(const std::string & filename, bool append)
+{
+    ModelWriter::ptr writer(new ModelWriter());
+    writer->outfile.open(filename, append ? std::ios::app : std::ios::trunc);
+    
+    // Did we open the file successfully?
+    if (!writer->outfile.is_open())
+    {
+        throw RuntimeException("Could not open model file.");
+    }
+    
+    return writer;
+}
+
+void DAGNode::Factory::serializeDAG(DAGNode::ptr root, std::ostream & outfile, int index)
+{
+    // The compact DAG is stored in breadth first order, hence the node IDs follow from the positions in the array
+    const int nodeCount = DAGNode::Factory::compactSize(root);
+    for (int i = 0; i < nodeCount; i++)
+    {
+        DAGNode::Factory::serialize(root + i, root, 1, outfile);
+    }
+    outfile << '#' << nodeCount;
+    if (index >= 0)
+    {
+        outfile << ' ' << index;
+    }
+    outfile << '\n';
+}
+
+int DAGNode::Factory::compactSize(DAGNode::ptr root)
+{
+    // Every node is discovered by a node before it, thus the array ends at the largest child position + 1
+    int nodeCount = 1;
+    for (int i = 0; i < nodeCount; i++)
+    {
+        DAGNode::ptr node = root + i;
+        if (node->getLeft() != 0)
+        {
+            nodeCount = std::max(nodeCount, static_cast<int>(std::max(node->getLeft() - root, node->getRight() - root)) + 1);
+        }
+    }
+    return nodeCount;
 }
 
-DAGNode::ptr DAGNode::Factory::unserialize(const std::vector<std::string> & row)
+DAGNode::ptr DAGNode::Factory::unserialize(const std::vector<std::string> & row, MemoryArena & arena)
 {
     // Row structure
     // 0         1         2            3            4                5                 6              7 
     // [nodeID], [isRoot], [featureID], [threshold], [left child ID], [right child ID], [class label], "[class histogram]"
     // The first two entries don't matter here
-    DAGNode::ptr node = DAGNode::Factory::create(0);
+    // The child nodes are recovered by the caller
+    DAGNode::ptr node = DAGNode::Factory::create(arena);
     
     node->setFeatureID(atoi(row[2].c_str()));
     node->setThreshold(atof(row[3].c_str()));
-    node->setTempLeft(atoi(row[4].c_str()));
-    node->setTempRight(atoi(row[5].c_str()));
     
     // Is this a child node?
     if (row[4] == "0")
@@ -304,7 +614,7 @@ DAGNode::ptr DAGNode::Factory::unserialize(const std::vector<std::string> & row)
         node->setClassLabel(atoi(row[6].c_str()));
         
         // Parse the histogram list (Only comma separated)
-        std::vector<int> histogram;
+        std::vector<Count> histogram;
         std::string h = row[7];
         int last = 0;
         for (std::vector<int>::size_type i = 0; i < h.size(); i++)
@@ -312,17 +622,17 @@ DAGNode::ptr DAGNode::Factory::unserialize(const std::vector<std::string> & row)
             if (h[i] == ',')
             {
                 // Add the last bin to the histogram
-                histogram.push_back(atoi(h.substr(last, i - last).c_str()));
+                histogram.push_back(static_cast<Count>(atoll(h.substr(last, i - last).c_str())));
                 last = i+1;
             }
         }
         // Add the last entry
-        histogram.push_back(atoi(h.substr(last, h.size() - last).c_str()));
+        histogram.push_back(static_cast<Count>(atoll(h.substr(last, h.size() - last).c_str())));
         
         // Add the values to the node histogram
-        node->getClassHistogram()->resize(histogram.size());
+        node->setClassHistogram(DAGNode::Factory::createClassHistogram(histogram.size(), arena));
         
-        for (std::vector<int>::size_type i = 0; i < histogram.size(); i++)
+        for (std::vector<Count>::size_type i = 0; i < histogram.size(); i++)
         {
             node->getClassHistogram()->set(i, histogram[i]);
         }
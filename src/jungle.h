@@ -8,6 +8,7 @@
 #ifndef JUNGLE_H
 #define JUNGLE_H
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <map>
@@ -16,6 +17,9 @@
 #include <memory>
 #include "misc.h"
 #include "fastlog.h"
+#include "memoryArena.h"
+#include "entropyKernels.h"
+#include "splitCriterion.h"
 #include <cmath>
 #define ENTROPY(p) -(p) * fastlog2(p)
 
@@ -127,7 +131,11 @@ namespace LibJungle
     };
     
     /**
-     * A histogram over the class labels
+     * A histogram over the class labels. 
+     * 
+     * An adaptive histogram (see resizeAdaptive()) starts as a sorted list of (class, count) pairs and only switches to
+     * a dense array of bins once too many classes are occupied. This way, nodes that only see a handful of classes out 
+     * of thousands don't need a full array and all operations only touch the occupied bins. 
      */
     class ClassHistogram {
     private:
@@ -137,33 +145,209 @@ namespace LibJungle
         int bins;
         
         /**
-         * The actual histogram
+         * The actual histogram if it is dense, 0 otherwise
+         */
+        Count* histogram;
+        
+        /**
+         * The occupied classes in ascending order and their counts if the histogram is sparse
+         */
+        int* sparseClasses;
+        Count* sparseCounts;
+        
+        /**
+         * The number of entries in the sparse lists and their capacity
          */
-        int* histogram;
+        int sparseSize;
+        int sparseCapacity;
         
         /**
          * The integral over the entire histogram
          */
-        int mass;
+        Count mass;
         
-    public:
         /**
-         * Default constructor
+         * The arena that holds the bins, 0 if they are allocated on the heap
          */
-        ClassHistogram() : bins(0), histogram(0), mass(0) { }
-        ClassHistogram(int _classCount) : bins(_classCount), histogram(0), mass(0){ resize(_classCount); }
+        MemoryArena* arena;
         
         /**
-         * Copy constructor
+         * Allocates a zero initialized array
          */
-        ClassHistogram(const ClassHistogram & other) 
+        template <class T>
+        T* allocateBins(int _count)
         {
-            resize (other.bins);
-            for (int i = 0; i < bins; i++)
+            if (arena != 0) return arena->allocateArray<T>(_count);
+            
+            T* result = new T[_count];
+            for (int i = 0; i < _count; i++)
             {
-                set(i, other.at(i));
+                result[i] = 0;
             }
+            return result;
+        }
+        
+        /**
+         * Releases an array that was allocated by allocateBins()
+         */
+        template <class T>
+        void releaseBins(T* _bins)
+        {
+            if (_bins != 0 && arena == 0)
+            {
+                delete[] _bins;
+            }
+        }
+        
+        /**
+         * Releases all bins
+         */
+        void releaseHistogram()
+        {
+            releaseBins(histogram);
+            releaseBins(sparseClasses);
+            releaseBins(sparseCounts);
+            histogram = 0;
+            sparseClasses = 0;
+            sparseCounts = 0;
+            sparseSize = 0;
+            sparseCapacity = 0;
+        }
+        
+        /**
+         * Returns the position of a class in the sparse lists or the position where it would have to be inserted
+         */
+        int sparseFind(int i) const
+        {
+            return static_cast<int>(std::lower_bound(sparseClasses, sparseClasses + sparseSize, i) - sparseClasses);
+        }
+        
+        /**
+         * Converts a sparse histogram into a dense one
+         */
+        void densify()
+        {
+            histogram = allocateBins<Count>(bins);
+            for (int k = 0; k < sparseSize; k++)
+            {
+                histogram[sparseClasses[k]] = sparseCounts[k];
+            }
+            releaseBins(sparseClasses);
+            releaseBins(sparseCounts);
+            sparseClasses = 0;
+            sparseCounts = 0;
+            sparseSize = 0;
+            sparseCapacity = 0;
+        }
+        
+        /**
+         * Adds v to the bin of class i in a sparse histogram. Inserts the class if necessary. 
+         */
+        void sparseAdd(int i, Count v)
+        {
+            const int k = sparseFind(i);
+            if (k < sparseSize && sparseClasses[k] == i)
+            {
+                sparseCounts[k] += v;
+                return;
+            }
+            
+            // The class is not occupied yet. If too many classes are occupied, a dense array is cheaper
+            if (sparseSize + 1 > bins / sparseDensity)
+            {
+                densify();
+                histogram[i] += v;
+                return;
+            }
+            
+            if (sparseSize == sparseCapacity)
+            {
+                const int capacity = std::max(2 * sparseCapacity, 4);
+                int* classes = allocateBins<int>(capacity);
+                Count* counts = allocateBins<Count>(capacity);
+                std::copy(sparseClasses, sparseClasses + sparseSize, classes);
+                std::copy(sparseCounts, sparseCounts + sparseSize, counts);
+                releaseBins(sparseClasses);
+                releaseBins(sparseCounts);
+                sparseClasses = classes;
+                sparseCounts = counts;
+                sparseCapacity = capacity;
+            }
+            
+            std::copy_backward(sparseClasses + k, sparseClasses + sparseSize, sparseClasses + sparseSize + 1);
+            std::copy_backward(sparseCounts + k, sparseCounts + sparseSize, sparseCounts + sparseSize + 1);
+            sparseClasses[k] = i;
+            sparseCounts[k] = v;
+            sparseSize++;
+        }
+        
+        /**
+         * Returns the sum of the criterion terms over all bins
+         */
+        template <class Criterion>
+        float sumTerms() const
+        {
+            if (isSparse()) return Criterion::sumTerms(sparseCounts, sparseSize);
+            return Criterion::sumTerms(histogram, bins);
+        }
+        
+        /**
+         * Returns an upper bound for the number of occupied bins
+         */
+        int occupiedBound() const
+        {
+            return isSparse() ? sparseSize : bins;
+        }
+        
+        /**
+         * Copies the bins of another histogram into this one. The bins are allocated on the heap. 
+         */
+        void copyFrom(const ClassHistogram & other)
+        {
+            releaseHistogram();
+            arena = 0;
+            bins = other.bins;
             mass = other.mass;
+            
+            if (other.isSparse())
+            {
+                sparseCapacity = std::max(other.sparseSize, 4);
+                sparseSize = other.sparseSize;
+                sparseClasses = allocateBins<int>(sparseCapacity);
+                sparseCounts = allocateBins<Count>(sparseCapacity);
+                std::copy(other.sparseClasses, other.sparseClasses + sparseSize, sparseClasses);
+                std::copy(other.sparseCounts, other.sparseCounts + sparseSize, sparseCounts);
+            }
+            else if (bins > 0)
+            {
+                histogram = allocateBins<Count>(bins);
+                std::copy(other.histogram, other.histogram + bins, histogram);
+            }
+        }
+        
+    public:
+        /**
+         * Adaptive histograms are only used for at least this many classes
+         */
+        static const int minSparseBins = 64;
+        
+        /**
+         * A sparse histogram becomes dense as soon as more than bins/sparseDensity classes are occupied
+         */
+        static const int sparseDensity = 8;
+        
+        /**
+         * Default constructor
+         */
+        ClassHistogram() : bins(0), histogram(0), sparseClasses(0), sparseCounts(0), sparseSize(0), sparseCapacity(0), mass(0), arena(0) { }
+        ClassHistogram(int _classCount) : bins(0), histogram(0), sparseClasses(0), sparseCounts(0), sparseSize(0), sparseCapacity(0), mass(0), arena(0) { resize(_classCount); }
+        
+        /**
+         * Copy constructor
+         */
+        ClassHistogram(const ClassHistogram & other) : bins(0), histogram(0), sparseClasses(0), sparseCounts(0), sparseSize(0), sparseCapacity(0), mass(0), arena(0)
+        {
+            copyFrom(other);
         }
         
         /**
@@ -174,12 +358,7 @@ namespace LibJungle
             // Prevent self assignment
             if (this != &other)
             {
-                resize (other.bins);
-                for (int i = 0; i < bins; i++)
-                {
-                    set(i, other.at(i));
-                }
-                mass = other.mass;
+                copyFrom(other);
             }
             return *this;
         }
@@ -189,10 +368,7 @@ namespace LibJungle
          */
         ~ClassHistogram()
         {
-            if (histogram != 0)
-            {
-                delete[] histogram;
-            }
+            releaseHistogram();
         }
         
         /**
@@ -201,27 +377,80 @@ namespace LibJungle
         void resize(int _classCount)
         {
             // Release the current histogram
-            if (histogram != 0)
+            releaseHistogram();
+            
+            bins = _classCount;
+            mass = 0;
+            arena = 0;
+            
+            // Only allocate a new histogram, if there is more than one class
+            if (_classCount > 0)
             {
-                delete[] histogram;
-                histogram = 0;
+                histogram = allocateBins<Count>(_classCount);
             }
+        }
+        
+        /**
+         * Resizes the histogram to a certain size. The bins are allocated in the given arena and are released
+         * together with it. If _capacity exceeds the class count, the additional bins are zero padding. This allows
+         * fixed size histograms to read _capacity bins without checking the class count. 
+         */
+        void resize(int _classCount, MemoryArena & _arena, int _capacity = 0)
+        {
+            // Release the current histogram
+            releaseHistogram();
             
             bins = _classCount;
+            mass = 0;
+            arena = &_arena;
             
-            // Only allocate a new histogram, if there is more than one class
             if (_classCount > 0)
             {
-                histogram = new int[_classCount];
-                
-                // Initialize the histogram
-                for (int i = 0; i < bins; i++)
-                {
-                    histogram[i] = 0;
-                }
+                histogram = allocateBins<Count>(std::max(_classCount, _capacity));
+            }
+        }
+        
+        /**
+         * Resizes the histogram to an adaptive histogram that starts sparse. Histograms with less than minSparseBins
+         * classes are always dense. 
+         */
+        void resizeAdaptive(int _classCount)
+        {
+            if (_classCount < minSparseBins)
+            {
+                resize(_classCount);
+                return;
+            }
+            
+            releaseHistogram();
+            bins = _classCount;
+            mass = 0;
+            arena = 0;
+        }
+        
+        /**
+         * Resizes the histogram to an adaptive histogram that starts sparse. The bins are allocated in the given 
+         * arena. 
+         */
+        void resizeAdaptive(int _classCount, MemoryArena & _arena)
+        {
+            if (_classCount < minSparseBins)
+            {
+                resize(_classCount, _arena);
+                return;
             }
+            
+            releaseHistogram();
+            bins = _classCount;
+            mass = 0;
+            arena = &_arena;
         }
         
+        /**
+         * Returns true if the histogram is currently stored as sparse list
+         */
+        bool isSparse() const { return histogram == 0 && bins > 0; }
+        
         /**
          * Returns the size of the histogram (= class count)
          */
@@ -231,28 +460,74 @@ namespace LibJungle
          * Returns the value of the histogram at a certain position. Caution: For performance reasons, we don't
          * perform any parameter check!
          */
-        int at(int i) const { return histogram[i]; }
-        int get(int i) const { return histogram[i]; }
-        void set(int i, int v) { mass -= histogram[i]; mass += v; histogram[i] = v; }
-        void add(int i, int v) { mass += v; histogram[i] += v; }
-        void sub(int i, int v) { mass -= v; histogram[i] -= v; }
-        void addOne(int i) { mass++; histogram[i]++; }
-        void subOne(int i) { mass--; histogram[i]--; }
+        Count at(int i) const
+        {
+            if (histogram != 0) return histogram[i];
+            
+            const int k = sparseFind(i);
+            return (k < sparseSize && sparseClasses[k] == i) ? sparseCounts[k] : 0;
+        }
+        Count get(int i) const { return at(i); }
+        void set(int i, Count v) { add(i, v - at(i)); }
+        void add(int i, Count v)
+        {
+            mass += v;
+            if (histogram != 0)
+            {
+                histogram[i] += v;
+            }
+            else
+            {
+                sparseAdd(i, v);
+            }
+        }
+        void sub(int i, Count v) { add(i, -v); }
+        void addOne(int i) { add(i, 1); }
+        void subOne(int i) { add(i, -1); }
+        
+        /**
+         * Returns the dense bins. This must only be called for dense histograms. 
+         */
+        const Count* data() const { return histogram; }
+        
+        /**
+         * Calls _f(i, c) for every bin i with count c != 0 in ascending order
+         * 
+         * @param _f The function to call
+         */
+        template <class F>
+        void forEach(F _f) const
+        {
+            if (histogram != 0)
+            {
+                for (int i = 0; i < bins; i++)
+                {
+                    if (histogram[i] != 0) _f(i, histogram[i]);
+                }
+            }
+            else
+            {
+                for (int k = 0; k < sparseSize; k++)
+                {
+                    if (sparseCounts[k] != 0) _f(sparseClasses[k], sparseCounts[k]);
+                }
+            }
+        }
         
         /**
          * Returns the mass
          */
-        float getMass() const { return mass; }
+        Count getMass() const { return mass; }
         
         /**
          * Returns the mass of the combined histogram (this + _hist)
          */
-        float getMass(const ClassHistogram & _hist) const { return getMass() + _hist.getMass(); }
+        Count getMass(const ClassHistogram & _hist) const { return getMass() + _hist.getMass(); }
         
         /**
          * Returns the mass of the combined histogram (this + _hist1 + _hist2)
          */
-        float getMass(const ClassHistogram & _hist1, const ClassHistogram & _hist2) const { return getMass() + _hist1.getMass() + _hist2.getMass(); }
+        Count getMass(const ClassHistogram & _hist1, const ClassHistogram & _hist2) const { return getMass() + _hist1.getMass() + _hist2.getMass(); }
         
         /**
          * Iterator interface from STL
@@ -261,54 +536,103 @@ namespace LibJungle
         int end() const { return bins; }
         
         /**
-         * Calculates the entropy of a histogram
+         * Adds all bins of another histogram to this one
          * 
-         * @return The calculated entropy
+         * @param _hist The histogram to add
          */
-        float entropy() const
+        void add(const ClassHistogram & _hist)
         {
-            float sum = getMass();
-            if (sum < 1) return 0;
-            
-            float entropy = 0;
-            
-            for (int i = 0; i < bins; i++)
+            if (histogram != 0 && _hist.histogram != 0)
             {
-                // Empty bins do not contribute anything
-                if (at(i) > 0)
+                const Count* other = _hist.histogram;
+                for (int i = 0; i < bins; i++)
                 {
-                    entropy += ENTROPY(at(i)/sum);
+                    histogram[i] += other[i];
                 }
+                mass += _hist.mass;
+                return;
             }
-
-            return entropy;
+            
+            _hist.forEach([this](int i, Count c) { add(i, c); });
         }
         
         /**
-         * Calculates the entropy of the histogram (this + _hist)
+         * Calculates the impurity of a histogram according to a split criterion
          * 
-         * @return The calculated entropy
+         * @return The calculated impurity
          */
-        float entropy(const ClassHistogram & _hist) const
+        template <class Criterion>
+        float impurity() const
+        {
+            return Criterion::impurity(getMass(), sumTerms<Criterion>());
+        }
+        
+        /**
+         * Calculates the impurity of the histogram (this + _hist)
+         * 
+         * @return The calculated impurity
+         */
+        template <class Criterion>
+        float impurity(const ClassHistogram & _hist) const
         {
-            float sum = getMass(_hist);
+            if (histogram != 0 && _hist.histogram != 0)
+            {
+                return Criterion::impurity(getMass(_hist), Criterion::sumTerms(histogram, _hist.histogram, bins));
+            }
             
-            if (sum < 1) return 0;
+            // Start with the terms of the histogram that has more occupied bins and correct the terms of the bins 
+            // that are occupied in the other one
+            const ClassHistogram & large = occupiedBound() >= _hist.occupiedBound() ? *this : _hist;
+            const ClassHistogram & small = occupiedBound() >= _hist.occupiedBound() ? _hist : *this;
             
-            float entropy = 0;
-            float numerator = 0;
+            float sum = large.sumTerms<Criterion>();
+            small.forEach([&sum, &large](int i, Count c) {
+                const float base = static_cast<float>(large.at(i));
+                sum += Criterion::term(base + c) - Criterion::term(base);
+            });
             
-            for (int i = 0; i < bins; i++)
+            return Criterion::impurity(getMass(_hist), sum);
+        }
+        
+        /**
+         * Calculates the impurity of the histogram (this + _hist1 + _hist2)
+         * 
+         * @return The calculated impurity
+         */
+        template <class Criterion>
+        float impurity(const ClassHistogram & _hist1, const ClassHistogram & _hist2) const
+        {
+            if (histogram != 0 && _hist1.histogram != 0 && _hist2.histogram != 0)
             {
-                // Empty bins do not contribute anything
-                numerator = at(i) + _hist.at(i);
-                if (numerator > 0)
-                {
-                    entropy += ENTROPY(numerator/sum);
-                }
+                return Criterion::impurity(getMass(_hist1, _hist2), 
+                        Criterion::sumTerms(histogram, _hist1.histogram, _hist2.histogram, bins));
             }
             
-            return entropy;
+            // Start with the terms of this histogram and correct the terms of the bins that are occupied in one of
+            // the others
+            float sum = sumTerms<Criterion>();
+            _hist1.forEach([&sum, this, &_hist2](int i, Count c) {
+                const float base = static_cast<float>(at(i));
+                sum += Criterion::term(base + c + _hist2.at(i)) - Criterion::term(base);
+            });
+            _hist2.forEach([&sum, this, &_hist1](int i, Count c) {
+                if (_hist1.at(i) != 0) return;
+                
+                const float base = static_cast<float>(at(i));
+                sum += Criterion::term(base + c) - Criterion::term(base);
+            });
+            
+            return Criterion::impurity(getMass(_hist1, _hist2), sum);
+        }
+        
+        /**
+         * Calculates the entropy of a histogram
+         * 
+         * @return The calculated entropy
+         */
+        float entropy() const
+        {
+            return impurity<EntropyCriterion>();
         }
         
         /**
@@ -316,26 +640,19 @@ namespace LibJungle
          * 
          * @return The calculated entropy
          */
+        float entropy(const ClassHistogram & _hist) const
+        {
+            return impurity<EntropyCriterion>(_hist);
+        }
+        
+        /**
+         * Calculates the entropy of the histogram (this + _hist1 + _hist2)
+         * 
+         * @return The calculated entropy
+         */
         float entropy(const ClassHistogram & _hist1, const ClassHistogram & _hist2) const
         {
-            float sum = getMass(_hist1, _hist2);
-            
-            if (sum < 1) return 0;
-            
-            float entropy = 0;
-            float numerator = 0;
-            
-            for (int i = 0; i < bins; i++)
-            {
-                // Empty bins do not contribute anything
-                numerator = at(i) + _hist2.at(i) + _hist1.at(i);
-                if (numerator > 0)
-                {
-                    entropy += ENTROPY(numerator/sum);
-                }
-            }
-            
-            return entropy;
+            return impurity<EntropyCriterion>(_hist1, _hist2);
         }
         
         /**
@@ -343,6 +660,9 @@ namespace LibJungle
          */
         void reset()
         {
+            mass = 0;
+            sparseSize = 0;
+            
             // Only reset the histogram if there are more than 0 bins
             if (histogram == 0) return;
             
@@ -350,13 +670,15 @@ namespace LibJungle
             {
                 histogram[i] = 0;
             }
-            mass = 0;
         }
     };
     
     /**
-     * A histogram over the class labels
+     * A histogram over the class labels that keeps track of its impurity weighted by its mass according to a split 
+     * criterion, e.g. S log2(S) - sum_i c_i log2(c_i) for the entropy. Every update only requires a few lookups in a 
+     * n log2(n) table or a few integer operations.
      */
+    template <class Criterion>
     class EfficientEntropyHistogram {
     private:
         /**
@@ -367,41 +689,43 @@ namespace LibJungle
         /**
          * The actual histogram
          */
-        int* histogram;
+        Count* histogram;
         
         /**
          * The integral over the entire histogram
          */
-        int mass;
+        Count mass;
         
         /**
-         * The entropies for the single bins
+         * The sum of the criterion terms over all bins
          */
-        float* entropies;
+        double sumTerms;
         
         /**
-         * The total entropy
+         * The n log2(n) table
          */
-        float totalEntropy;
+        const NLogNTable* table;
         
     public:
         /**
          * Default constructor
          */
-        EfficientEntropyHistogram() : bins(0), histogram(0), mass(0), entropies(0), totalEntropy(0) { }
-        EfficientEntropyHistogram(int _classCount) : bins(_classCount), histogram(0), mass(0), entropies(0), totalEntropy(0) { resize(_classCount); }
+        EfficientEntropyHistogram() : bins(0), histogram(0), mass(0), sumTerms(0), table(&NLogNTable::getDefault()) { }
+        EfficientEntropyHistogram(int _classCount) : bins(0), histogram(0), mass(0), sumTerms(0), table(&NLogNTable::getDefault()) { resize(_classCount); }
         
         /**
          * Copy constructor
          */
-        EfficientEntropyHistogram(const EfficientEntropyHistogram & other) 
+        EfficientEntropyHistogram(const EfficientEntropyHistogram & other) : 
+                bins(0), histogram(0), mass(0), sumTerms(0), table(other.table)
         {
             resize (other.bins);
             for (int i = 0; i < bins; i++)
             {
-                set(i, other.at(i));
+                histogram[i] = other.at(i);
             }
             mass = other.mass;
+            sumTerms = other.sumTerms;
         }
         
         /**
@@ -415,143 +739,429 @@ namespace LibJungle
                 resize (other.bins);
                 for (int i = 0; i < bins; i++)
                 {
-                    set(i, other.at(i));
+                    histogram[i] = other.at(i);
                 }
                 mass = other.mass;
+                sumTerms = other.sumTerms;
+                table = other.table;
             }
             return *this;
         }
         
         /**
-         * Destructor
+         * Destructor
+         */
+        ~EfficientEntropyHistogram()
+        {
+            if (histogram != 0)
+            {
+                delete[] histogram;
+            }
+        }
+        
+        /**
+         * Resizes the histogram to a certain size
+         */
+        void resize(int _classCount)
+        {
+            // Release the current histogram
+            if (histogram != 0)
+            {
+                delete[] histogram;
+                histogram = 0;
+            }
+            bins = 0;
+            mass = 0;
+            sumTerms = 0;
+            
+            // Only allocate a new histogram, if there is more than one class
+            if (_classCount > 0)
+            {
+                histogram = new Count[_classCount];
+                bins = _classCount;
+                
+                // Initialize the histogram
+                for (int i = 0; i < bins; i++)
+                {
+                    histogram[i] = 0;
+                }
+            }
+        }
+        
+        /**
+         * Sets the n log2(n) table that is used for the entropy updates. The table must outlive the histogram. 
+         * 
+         * @param _table The table
+         */
+        void setTable(const NLogNTable & _table) { table = &_table; }
+        
+        /**
+         * Returns the size of the histogram (= class count)
+         */
+        int size() const { return bins; }
+        
+        /**
+         * Returns the value of the histogram at a certain position. Caution: For performance reasons, we don't
+         * perform any parameter check! set() and add() don't update the entropy, call initEntropies() afterwards. 
+         */
+        Count at(int i) const { return histogram[i]; }
+        Count get(int i) const { return histogram[i]; }
+        void set(int i, Count v) { mass -= histogram[i]; mass += v; histogram[i] = v; }
+        void add(int i, Count v) { mass += v; histogram[i] += v; }
+        void sub(int i, Count v) { mass -= v; histogram[i] -= v; }
+        void addOne(int i)
+        {
+            sumTerms += Criterion::exactTerm(histogram[i] + 1, *table) - Criterion::exactTerm(histogram[i], *table);
+            mass++;
+            histogram[i]++;
+        }
+        
+        /**
+         * Adds all occupied bins of another histogram and updates the impurity accordingly
+         * 
+         * @param _hist The histogram to add
+         */
+        template <class Histogram>
+        void add(const Histogram & _hist)
+        {
+            _hist.forEach([this](int i, Count c) {
+                sumTerms += Criterion::exactTerm(histogram[i] + c, *table) - Criterion::exactTerm(histogram[i], *table);
+                mass += c;
+                histogram[i] += c;
+            });
+        }
+        void subOne(int i)
+        { 
+            sumTerms += Criterion::exactTerm(histogram[i] - 1, *table) - Criterion::exactTerm(histogram[i], *table);
+            mass--;
+            histogram[i]--;
+        }
+        
+        /**
+         * Adds/subtracts w examples of class i and updates the impurity accordingly
+         */
+        void addWeighted(int i, Count w)
+        {
+            sumTerms += Criterion::exactTerm(histogram[i] + w, *table) - Criterion::exactTerm(histogram[i], *table);
+            mass += w;
+            histogram[i] += w;
+        }
+        void subWeighted(int i, Count w) { addWeighted(i, -w); }
+        
+        /**
+         * Returns the mass
+         */
+        Count getMass() const { return mass; }
+        
+        /**
+         * Returns the impurity of the histogram weighted by its mass
+         * 
+         * @return The weighted impurity
+         */
+        float entropy() const
+        {
+            return Criterion::weightedImpurity(mass, sumTerms, *table);
+        }
+        
+        /**
+         * Initializes the impurity from the current bins
+         */
+        void initEntropies()
+        {
+            sumTerms = 0;
+            for (int i = 0; i < bins; i++)
+            {
+                sumTerms += Criterion::exactTerm(histogram[i], *table);
+            }
+        }
+        
+        /**
+         * Sets all entries in the histogram to 0
+         */
+        void reset()
+        {
+            // Only reset the histogram if there are more than 0 bins
+            if (histogram == 0) return;
+            
+            for (int i = 0; i < bins; i++)
+            {
+                histogram[i] = 0;
+            }
+            sumTerms = 0;
+            mass = 0;
+        }
+    };
+    
+    /**
+     * A histogram over the class labels with a compile-time number of bins. The bins are held inline, so these
+     * histograms don't need any heap memory and all loops over the bins can be unrolled. Histograms with fewer classes
+     * than Bins leave the remaining bins at 0. 
+     * 
+     * Caution: Whenever a ClassHistogram is passed to one of these histograms, it must provide Bins readable bins 
+     * (see ClassHistogram::resize()). 
+     */
+    template <int Bins>
+    class FixedClassHistogram {
+    private:
+        /**
+         * The actual histogram
+         */
+        Count histogram[Bins];
+        
+        /**
+         * The integral over the entire histogram
+         */
+        Count mass;
+        
+    public:
+        /**
+         * Default constructor
+         */
+        FixedClassHistogram() { reset(); }
+        
+        /**
+         * Resets the histogram. The class count must not exceed Bins. Fixed size histograms are always dense. 
+         */
+        void resize(int) { reset(); }
+        void resizeAdaptive(int) { reset(); }
+        
+        /**
+         * Sets all entries in the histogram to 0
+         */
+        void reset()
+        {
+            for (int i = 0; i < Bins; i++)
+            {
+                histogram[i] = 0;
+            }
+            mass = 0;
+        }
+        
+        /**
+         * Calls _f(i, c) for every bin i with count c != 0 in ascending order
+         * 
+         * @param _f The function to call
+         */
+        template <class F>
+        void forEach(F _f) const
+        {
+            for (int i = 0; i < Bins; i++)
+            {
+                if (histogram[i] != 0) _f(i, histogram[i]);
+            }
+        }
+        
+        /**
+         * Returns the size of the histogram
+         */
+        int size() const { return Bins; }
+        
+        /**
+         * Returns the value of the histogram at a certain position
+         */
+        Count at(int i) const { return histogram[i]; }
+        void add(int i, Count v) { mass += v; histogram[i] += v; }
+        
+        /**
+         * Adds all bins of another histogram to this one
+         * 
+         * @param _hist The histogram to add
+         */
+        void add(const ClassHistogram & _hist)
+        {
+            const Count* other = _hist.data();
+            for (int i = 0; i < Bins; i++)
+            {
+                histogram[i] += other[i];
+            }
+            mass += _hist.getMass();
+        }
+        
+        /**
+         * Returns the mass
+         */
+        Count getMass() const { return mass; }
+        
+        /**
+         * Returns the mass of the combined histogram (this + _hist)
+         */
+        Count getMass(const ClassHistogram & _hist) const { return getMass() + _hist.getMass(); }
+        
+        /**
+         * Returns the mass of the combined histogram (this + _hist1 + _hist2)
+         */
+        Count getMass(const ClassHistogram & _hist1, const ClassHistogram & _hist2) const { return getMass() + _hist1.getMass() + _hist2.getMass(); }
+        
+        /**
+         * Calculates the impurity of a histogram according to a split criterion
+         * 
+         * @return The calculated impurity
+         */
+        template <class Criterion>
+        float impurity() const
+        {
+            float sum = 0;
+            for (int i = 0; i < Bins; i++)
+            {
+                sum += Criterion::term(static_cast<float>(histogram[i]));
+            }
+            return Criterion::impurity(getMass(), sum);
+        }
+        
+        /**
+         * Calculates the impurity of the histogram (this + _hist)
+         * 
+         * @return The calculated impurity
          */
-        ~EfficientEntropyHistogram()
+        template <class Criterion>
+        float impurity(const ClassHistogram & _hist) const
         {
-            if (histogram != 0)
+            const Count* other = _hist.data();
+            float sum = 0;
+            for (int i = 0; i < Bins; i++)
             {
-                delete[] histogram;
-            }
-            if (entropies != 0)
-            {
-                delete[] entropies;
+                sum += Criterion::term(static_cast<float>(histogram[i] + other[i]));
             }
+            return Criterion::impurity(getMass(_hist), sum);
         }
         
         /**
-         * Resizes the histogram to a certain size
+         * Calculates the impurity of the histogram (this + _hist1 + _hist2)
+         * 
+         * @return The calculated impurity
          */
-        void resize(int _classCount)
+        template <class Criterion>
+        float impurity(const ClassHistogram & _hist1, const ClassHistogram & _hist2) const
         {
-            // Release the current histogram
-            if (histogram != 0)
-            {
-                delete[] histogram;
-                histogram = 0;
-            }
-            if (entropies != 0)
+            const Count* other1 = _hist1.data();
+            const Count* other2 = _hist2.data();
+            float sum = 0;
+            for (int i = 0; i < Bins; i++)
             {
-                delete[] entropies;
-                entropies = 0;
-            }
-            
-            // Only allocate a new histogram, if there is more than one class
-            if (_classCount > 0)
-            {
-                histogram = new int[_classCount];
-                entropies = new float[_classCount];
-                bins = _classCount;
-                
-                // Initialize the histogram
-                for (int i = 0; i < bins; i++)
-                {
-                    histogram[i] = 0;
-                    entropies[i] = 0;
-                }
+                sum += Criterion::term(static_cast<float>(histogram[i] + other1[i] + other2[i]));
             }
+            return Criterion::impurity(getMass(_hist1, _hist2), sum);
         }
+    };
+    
+    /**
+     * The counterpart of EfficientEntropyHistogram with a compile-time number of bins
+     */
+    template <int Bins, class Criterion>
+    class FixedEntropyHistogram {
+    private:
+        /**
+         * The actual histogram
+         */
+        Count histogram[Bins];
         
         /**
-         * Returns the size of the histogram (= class count)
+         * The integral over the entire histogram
          */
-        int size() const { return bins; }
+        Count mass;
         
         /**
-         * Returns the value of the histogram at a certain position. Caution: For performance reasons, we don't
-         * perform any parameter check!
+         * The sum of the criterion terms over all bins
+         */
+        double sumTerms;
+        
+        /**
+         * The n log2(n) table
+         */
+        const NLogNTable* table;
+        
+    public:
+        /**
+         * Default constructor
+         */
+        FixedEntropyHistogram() : table(&NLogNTable::getDefault()) { reset(); }
+        
+        /**
+         * Resets the histogram. The class count must not exceed Bins. 
+         */
+        void resize(int) { reset(); }
+        
+        /**
+         * Sets the n log2(n) table that is used for the entropy updates. The table must outlive the histogram. 
+         * 
+         * @param _table The table
          */
-        int at(int i) const { return histogram[i]; }
-        int get(int i) const { return histogram[i]; }
-        void set(int i, int v) { mass -= histogram[i]; mass += v; histogram[i] = v; }
-        void add(int i, int v) { mass += v; histogram[i] += v; }
-        void sub(int i, int v) { mass -= v; histogram[i] -= v; }
+        void setTable(const NLogNTable & _table) { table = &_table; }
+        
+        /**
+         * Returns the size of the histogram
+         */
+        int size() const { return Bins; }
+        
+        /**
+         * Returns the value of the histogram at a certain position. set() doesn't update the entropy, call 
+         * initEntropies() afterwards. 
+         */
+        Count at(int i) const { return histogram[i]; }
+        void set(int i, Count v) { mass -= histogram[i]; mass += v; histogram[i] = v; }
         void addOne(int i)
         {
-            totalEntropy += ENTROPY(getMass());
+            sumTerms += Criterion::exactTerm(histogram[i] + 1, *table) - Criterion::exactTerm(histogram[i], *table);
             mass++;
-            totalEntropy += -ENTROPY(getMass());
             histogram[i]++;
-            totalEntropy -= entropies[i];
-            entropies[i] = ENTROPY(histogram[i]); 
-            totalEntropy += entropies[i];
+        }
+        
+        /**
+         * Adds all occupied bins of another histogram and updates the impurity accordingly
+         * 
+         * @param _hist The histogram to add
+         */
+        template <class Histogram>
+        void add(const Histogram & _hist)
+        {
+            _hist.forEach([this](int i, Count c) {
+                sumTerms += Criterion::exactTerm(histogram[i] + c, *table) - Criterion::exactTerm(histogram[i], *table);
+                mass += c;
+                histogram[i] += c;
+            });
         }
         void subOne(int i)
         { 
-            totalEntropy += ENTROPY(getMass());
-            mass--; 
-            totalEntropy += -ENTROPY(getMass());
-            
+            sumTerms += Criterion::exactTerm(histogram[i] - 1, *table) - Criterion::exactTerm(histogram[i], *table);
+            mass--;
             histogram[i]--;
-            totalEntropy -= entropies[i];
-            if (histogram[i] < 1)
-            {
-                entropies[i] = 0;
-            }
-            else
-            {
-                entropies[i] = ENTROPY(histogram[i]); 
-            }
-            totalEntropy += entropies[i];
         }
         
+        /**
+         * Adds/subtracts w examples of class i and updates the impurity accordingly
+         */
+        void addWeighted(int i, Count w)
+        {
+            sumTerms += Criterion::exactTerm(histogram[i] + w, *table) - Criterion::exactTerm(histogram[i], *table);
+            mass += w;
+            histogram[i] += w;
+        }
+        void subWeighted(int i, Count w) { addWeighted(i, -w); }
+        
         /**
          * Returns the mass
          */
-        float getMass() const { return mass; }
+        Count getMass() const { return mass; }
         
         /**
-         * Calculates the entropy of a histogram
+         * Returns the impurity of the histogram weighted by its mass
          * 
-         * @return The calculated entropy
+         * @return The weighted impurity
          */
         float entropy() const
         {
-            return totalEntropy;
+            return Criterion::weightedImpurity(mass, sumTerms, *table);
         }
         
         /**
-         * Initializes all entropies
+         * Initializes the impurity from the current bins
          */
         void initEntropies()
         {
-            if (getMass() < 1)
-            {
-                totalEntropy = 0;
-                for (int i = 0; i < bins; i++)
-                {
-                    entropies[i] = 0;
-                }
-            }
-            else
+            sumTerms = 0;
+            for (int i = 0; i < Bins; i++)
             {
-                totalEntropy = -ENTROPY(getMass());
-                for (int i = 0; i < bins; i++)
-                {
-                    if (at(i) == 0) continue;
-
-                    entropies[i] = ENTROPY(at(i));
-                    
-                    totalEntropy += entropies[i];
-                }
+                sumTerms += Criterion::exactTerm(histogram[i], *table);
             }
         }
         
@@ -560,15 +1170,11 @@ namespace LibJungle
          */
         void reset()
         {
-            // Only reset the histogram if there are more than 0 bins
-            if (histogram == 0) return;
-            
-            for (int i = 0; i < bins; i++)
+            for (int i = 0; i < Bins; i++)
             {
                 histogram[i] = 0;
-                entropies[i] = 0;
             }
-            totalEntropy = 0;
+            sumTerms = 0;
             mass = 0;
         }
     };
@@ -674,7 +1280,8 @@ namespace LibJungle
     };
 
     /**
-     * This class represents a single node in a decision DAG
+     * This class represents a single node in a decision DAG. It only holds what is needed for prediction. Nodes are
+     * always allocated in a memory arena and are released together with it. 
      */
     class DAGNode {
     public:
@@ -682,16 +1289,6 @@ namespace LibJungle
         typedef self* ptr;
         
     private:
-        /**
-         * The feature ID (feature vector index to test) that is tested at this node
-         */
-        int featureID;
-        
-        /**
-         * The applied threshold
-         */
-        float threshold;
-        
         /**
          * The left child node
          */
@@ -703,74 +1300,27 @@ namespace LibJungle
         ptr right;
         
         /**
-         * Temporary left node assignment. Used during training and model loading
-         */
-        int tempLeft;
-        
-        /**
-         * Temporary right node assignment. Used during training and model loading
-         */
-        int tempRight;
-        
-        /**
-         * Assigned class label for this node
+         * Class histogram for this node. Trained DAGs only keep the histograms at the leaf nodes. 
          */
-        ClassLabel classLabel;
+        ClassHistogram* classHistogram;
         
         /**
-         * Class histogram for this node
+         * The feature ID (feature vector index to test) that is tested at this node
          */
-        ClassHistogram classHistogram;
+        int featureID;
         
         /**
-         * The ID of this node. This is used in order to serialize nodes
+         * The applied threshold
          */
-        int ID;
+        float threshold;
         
         /**
-         * Initializes all parameters
+         * Assigned class label for this node
          */
-        void initParameters();
+        ClassLabel classLabel;
         
     public:
-        DAGNode() : classHistogram() {}
-        virtual ~DAGNode() {}
-        
-        /**
-         * Deletes a DAG given by its root node
-         */
-        static void deleteDAG(DAGNode::ptr root)
-        {
-            // Put all nodes into a set and then iterate over the set to delete all nodes
-            std::vector<DAGNode::ptr> queue;
-            std::set<DAGNode::ptr> deletionSet;
-            
-            // Start with the root node
-            queue.push_back(root);
-            DAGNode::ptr current = 0;
-            
-            while (queue.size() > 0)
-            {
-                current = queue.back();
-                queue.pop_back();
-                
-                if (deletionSet.find(current) != deletionSet.end()) continue;
-                
-                deletionSet.insert(current);
-                
-                if (current->getLeft() != 0)
-                {
-                    queue.push_back(current->getLeft());
-                    queue.push_back(current->getRight());
-                }
-            }
-            
-            for (std::set<DAGNode::ptr>::iterator it = deletionSet.begin(); it != deletionSet.end(); ++it)
-            {
-                DAGNode::ptr node = *it;
-                delete node;
-            }
-        }
+        DAGNode() : left(0), right(0), classHistogram(0), featureID(0), threshold(0), classLabel(0) {}
         
         /**
          * Returns the feature ID
@@ -887,77 +1437,31 @@ namespace LibJungle
         /**
          * Returns the class histogram
          * 
-         * @return Class histogram
+         * @return Class histogram or null if the node has no histogram
          */
         ClassHistogram* getClassHistogram()
         {
-            return &classHistogram;
+            return classHistogram;
         }
         
         /**
          * Returns the class histogram
          * 
-         * @return Class histogram
+         * @return Class histogram or null if the node has no histogram
          */
         const ClassHistogram* getClassHistogram() const
         {
-            return &classHistogram;
-        }
-    
-        /**
-         * Returns the node ID
-         */
-        int getID() const
-        {
-            return ID;
-        }
-        
-        /**
-         * Sets the node ID
-         */
-        void setID(int _ID)
-        {
-            ID = _ID;
-        }
-                
-        /**
-         * Sets the temporary left assignment
-         * 
-         * @param _tempLeft New assignment
-         */
-        void setTempLeft(int _tempLeft)
-        {
-            tempLeft = _tempLeft;
-        }
-        
-        /**
-         * Returns the temporary left assignment
-         * 
-         * @return temporary left assignment
-         */
-        int getTempLeft()
-        {
-            return tempLeft;
-        }
-        
-        /**
-         * Sets the temporary right assignment
-         * 
-         * @param _tempRight New assignment
-         */
-        void setTempRight(int _tempRight)
-        {
-            tempRight = _tempRight;
+            return classHistogram;
         }
         
         /**
-         * Returns the temporary right assignment
+         * Sets the class histogram
          * 
-         * @return temporary right assignment
+         * @param _classHistogram The new class histogram
          */
-        int getTempRight()
+        void setClassHistogram(ClassHistogram* _classHistogram)
         {
-            return tempRight;
+            classHistogram = _classHistogram;
         }
         
         /**
@@ -984,41 +1488,91 @@ namespace LibJungle
             /**
              * Initializes a note
              */
-            static void init(DAGNode::ptr node, int classCount)
+            static void init(DAGNode::ptr node)
             {
                 node->setFeatureID(0);
                 node->setThreshold(0);
                 node->setClassLabel(0);
                 node->setLeft(0);
                 node->setRight(0);
-                node->getClassHistogram()->resize(classCount);
+                node->setClassHistogram(0);
             }
             
         public:
             /**
-             * Creates a new initialized DAG node (class label = 0, feature dimension = 0)
+             * Creates a new initialized DAG node (class label = 0, feature dimension = 0) inside a memory arena. The
+             * node is released together with the arena. 
              * 
              * @return initialized DAG node
              */
-            static DAGNode::ptr create(int classCount)
+            static DAGNode::ptr create(MemoryArena & arena)
             {
-                DAGNode::ptr node = new DAGNode();
+                DAGNode::ptr node = arena.create<DAGNode>();
 
                 // Initialize the node
-                Factory::init(node, classCount);
+                Factory::init(node);
                 
                 return node;
             }
             
             /**
-             * Serializes a node in order to save it to a file
+             * Creates a new blank class histogram inside a memory arena
+             * 
+             * @param classCount The number of bins
+             * @param arena The arena
+             * @return new class histogram
+             */
+            static ClassHistogram* createClassHistogram(int classCount, MemoryArena & arena)
+            {
+                ClassHistogram* histogram = arena.create<ClassHistogram>();
+                histogram->resize(classCount, arena);
+                return histogram;
+            }
+            
+            /**
+             * Copies a DAG into a compact representation. All nodes are stored in one array in breadth first order
+             * and only the leaf nodes keep their class histograms. The compact DAG is allocated in a new arena that
+             * is sized to fit exactly. 
+             * 
+             * @param root The root node of the DAG to copy
+             * @param arena Output: The arena that holds the compact DAG
+             * @return The root node of the compact DAG
+             */
+            static DAGNode::ptr compact(DAGNode::ptr root, MemoryArena::ptr & arena);
+            
+            /**
+             * Returns the number of nodes in a compact DAG, see compact()
+             * 
+             * @param root The root node of the compact DAG
+             * @return number of nodes
+             */
+            static int compactSize(DAGNode::ptr root);
+            
+            /**
+             * Serializes a node of a compact DAG in order to save it to a file. The node IDs are given by the positions
+             * in the compact DAG. 
+             * 
+             * @param node The node to serialize
+             * @param root The root node of the compact DAG
+             * @param firstID The ID of the root node
+             * @param outfile The model file
+             */
+            static void serialize(DAGNode::ptr node, DAGNode::ptr root, int firstID, std::ostream & outfile);
+            
+            /**
+             * Serializes a whole compact DAG as one block of the model file, i.e. its nodes followed by the 
+             * "#{rows}" trailer. The trailer of a checkpoint file also holds the index of the DAG, "#{rows} {index}". 
+             * 
+             * @param root The root node of the compact DAG
+             * @param outfile The output stream
+             * @param index The index of the DAG in the jungle or -1 if it is not recorded
              */
-            static void serialize(DAGNode::ptr node, bool isRoot, std::ofstream & outfile);
+            static void serializeDAG(DAGNode::ptr root, std::ostream & outfile, int index = -1);
             
             /**
-             * Unserializes a node from a model file
+             * Unserializes a node from a model file. The node is allocated in the given arena. 
              */
-            static DAGNode::ptr unserialize(const std::vector<std::string> & row);
+            static DAGNode::ptr unserialize(const std::vector<std::string> & row, MemoryArena & arena);
         };
         friend class DAGNode::Factory;
     };
@@ -1033,18 +1587,16 @@ namespace LibJungle
          */
         std::set<DAGNode::ptr> dags;
         
+        /**
+         * The memory arenas that hold the nodes of the DAGs. The DAGs are released together with the arenas. 
+         */
+        std::vector<MemoryArena::ptr> arenas;
+        
     public:
         typedef Jungle self;
         typedef std::shared_ptr<self> ptr;
         
-        virtual ~Jungle()
-        {
-            // Delete all DAGs
-            for (std::set<DAGNode::ptr>::iterator it = dags.begin(); it != dags.end(); ++it)
-            {
-                DAGNode::deleteDAG(*it);
-            }
-        }
+        virtual ~Jungle() {}
 
         /**
          * Returns the trained DAGs
@@ -1056,6 +1608,28 @@ namespace LibJungle
             return dags;
         }
         
+        /**
+         * Returns the memory arenas that are owned by this jungle
+         * 
+         * @return List of arenas
+         */
+        std::vector<MemoryArena::ptr> & getArenas()
+        {
+            return arenas;
+        }
+        
+        /**
+         * Adds a DAG to the jungle. The jungle takes ownership of the arena the DAG was allocated in.
+         * 
+         * @param root The root node of the DAG
+         * @param arena The arena that holds the nodes of the DAG
+         */
+        void addDAG(DAGNode::ptr root, MemoryArena::ptr arena)
+        {
+            dags.insert(root);
+            arenas.push_back(arena);
+        }
+        
         /**
          * Classifies a new data point given by a feature vector
          * 
@@ -1063,6 +1637,14 @@ namespace LibJungle
          */
         PredictionResult::ptr predict(DataPoint::ptr featureVector) const;
         
+        /**
+         * Returns the number of classes of the jungle, i.e. the size of the class histograms at its leaves
+         * 
+         * @return number of classes or 0 if the jungle has no DAGs
+         * @throws RuntimeException If the leaves have different numbers of classes
+         */
+        int getClassCount() const throw(RuntimeException);
+        
         /**
          * Factory for decision jungles
          */
@@ -1080,66 +1662,86 @@ namespace LibJungle
             
             /**
              * Serializes the complete jungle in order to save it to a file
+             * 
+             * @param jungle The jungle to save
+             * @param filename The model file
+             * @param framed If true, every DAG is written as a block of its own, see ModelWriter. Otherwise all DAGs 
+             *               form a single block and the node IDs are numbered consecutively across the DAGs. Only 
+             *               the unframed format can be read by versions without ModelWriter
              */
-            static void serialize(Jungle::ptr jungle, const std::string & filename)
-            {
-                // Open the file
-                std::ofstream outfile(filename);
-                
-                // Did we open the file successfully?
-                if (!outfile.is_open())
-                {
-                    throw RuntimeException("Could not open model file.");
-                    return;
-                }
-                
-                // Give all nodes an ID
-                int ID = 1;
-                for (std::set<DAGNode::ptr>::iterator it = jungle->dags.begin(); it != jungle->dags.end(); ++it)
-                {
-                    // Put all nodes into a set and then iterate over the set to delete all nodes
-                    std::vector<DAGNode::ptr> queue;
-                    std::set<DAGNode::ptr> nodeSet;
-
-                    // Start with the root node
-                    queue.push_back(*it);
-                    DAGNode::ptr current = 0;
-
-                    while (queue.size() > 0)
-                    {
-                        current = queue.back();
-                        queue.pop_back();
-
-                        if (nodeSet.find(current) != nodeSet.end()) continue;
-
-                        nodeSet.insert(current);
-                        current->setID(ID++);
-
-                        if (current->getLeft() != 0)
-                        {
-                            queue.push_back(current->getLeft());
-                            queue.push_back(current->getRight());
-                        }
-                    }
-                    
-                    // Save all the nodes
-                    for (std::set<DAGNode::ptr>::iterator nodeIt = nodeSet.begin(); nodeIt != nodeSet.end(); ++nodeIt)
-                    {
-                        DAGNode::Factory::serialize(*nodeIt, *nodeIt == *it, outfile);
-                    }
-                }
-                
-                outfile.close();
-            }
+            static void serialize(Jungle::ptr jungle, const std::string & filename, bool framed = false);
+            
+            /**
+             * Loads several model files in parallel and combines their DAGs into one jungle
+             * 
+             * @param filenames The model files
+             * @param maxParallel The maximum number of files that are loaded in parallel
+             * @return The combined jungle
+             * @throws RuntimeException If a file cannot be loaded or the models have different numbers of classes
+             */
+            static Jungle::ptr merge(const std::vector<std::string> & filenames, int maxParallel) throw(RuntimeException);
             
             /**
              * Loads a jungle from a model file
              */
             static Jungle::ptr createFromFile(const std::string & filename, bool);
+            
+            /**
+             * Loads a jungle from a stream in the model file format
+             * 
+             * @param in The stream to read from
+             * @param lineCount The number of lines for the progress bar
+             * @param verboseMode Whether or not the progress bar is displayed
+             * @return The loaded jungle
+             */
+            static Jungle::ptr createFromStream(std::istream & in, size_t lineCount, bool verboseMode);
         };
         friend class Jungle::Factory;
     };
     
+    /**
+     * Writes DAGs to a model file as soon as they are trained. Every DAG is written as one block of rows followed by 
+     * a trailer row "#[number of rows]". The node IDs of every block start at 1. The loader only accepts complete 
+     * blocks, hence a model file that was cut short by a crash still contains all DAGs before the last trailer. 
+     */
+    class ModelWriter {
+    private:
+        /**
+         * The model file
+         */
+        std::ofstream outfile;
+        
+    public:
+        typedef ModelWriter self;
+        typedef std::shared_ptr<self> ptr;
+        
+        /**
+         * Appends a DAG to the model file and flushes it. The DAG must be in its compact representation, see 
+         * DAGNode::Factory::compact()
+         * 
+         * @param root The root node of the DAG
+         * @param index The index of the DAG in the jungle or -1 if it is not recorded
+         * @throws RuntimeException If the file cannot be written
+         */
+        void write(DAGNode::ptr root, int index = -1);
+        
+        /**
+         * Factory for model writers
+         */
+        class Factory {
+        public:
+            /**
+             * Opens a model file for writing
+             * 
+             * @param filename The model file
+             * @param append Whether or not the DAGs are appended to an existing file
+             * @return new writer
+             * @throws RuntimeException If the file cannot be opened
+             */
+            static ModelWriter::ptr create(const std::string & filename, bool append);
+        };
+    };
+    
     /**
      * This class calculates some statistics. 
      */
@@ -1177,11 +1779,11 @@ namespace LibJungle
         /**
          * The current status of the bar
          */
-        int state;
+        size_t state;
         /**
          * The total number of elements
          */
-        int total;
+        size_t total;
         /**
          * Last upper bound. Don't repaint, if the bar didn't change
          */
@@ -1194,7 +1796,7 @@ namespace LibJungle
         /**
          * Default constructor
          */
-        ProgressBar(int _width, int _total) : width(_width), state(0), total(_total), _lastUpperBound(0) {}
+        ProgressBar(int _width, size_t _total) : width(_width), state(0), total(_total), _lastUpperBound(0) {}
         /**
          * Copy constructor
          */
@@ -1224,12 +1826,12 @@ namespace LibJungle
          * 
          * @param _state The new state
          */
-        void update(int _state)
+        void update(size_t _state)
         {
             state = _state;
             float progress = 0;
             // Relative progress
-            if (total <= 0)
+            if (total == 0)
             {
                 progress = 1.;
             }
@@ -1257,7 +1859,7 @@ namespace LibJungle
                     printf(" ");
                 }
             }
-            printf("] %4d/%4d (%2.1f%%)", _state, total, progress*100);
+            printf("] %4zu/%4zu (%2.1f%%)", _state, total, progress*100);
             
             // Stop when we reached the end
             if (state >= total)
@@ -1276,6 +1878,14 @@ namespace LibJungle
         {
             update(state + 1);
         }
+        
+        /**
+         * Counts the lines of a stream in order to display the progress of loading it. The stream is read in blocks. 
+         * 
+         * @param in The stream
+         * @return number of lines
+         */
+        static size_t countLines(std::istream & in);
 
         /**
          * A factory method for the progress bar
@@ -1289,7 +1899,7 @@ namespace LibJungle
              * @param _total
              * @return new progress bar
              */
-            static ProgressBar::ptr create(int _width, int _total)
+            static ProgressBar::ptr create(int _width, size_t _total)
             {
                 return ptr(new self(_width, _total));
             }
@@ -1300,7 +1910,7 @@ namespace LibJungle
              * @param _total
              * @return new progress bar
              */
-            static ProgressBar::ptr create(int _total)
+            static ProgressBar::ptr create(size_t _total)
             {
                 return ProgressBar::Factory::create(50, _total);
             }
@@ -1,12 +1,15 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstdio>
 #include <iterator>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <random>
 #include <set>
+#include <map>
 #include <cstdlib>
 #include <boost/tokenizer.hpp>
 #include "jungleTrain.h"
@@ -38,8 +41,10 @@ void DAGTrainer::validateParameters() throw(ConfigurationException)
         throw ConfigurationException("There must be at least one training example.");
     }
     
-    // Check if all training examples have the same feature dimension
-    featureDimension = (*trainingSet->begin())->getDataPoint()->size();
+    // Check if all training examples have the same feature dimension. With feature columns, the training set only
+    // holds the class labels
+    const int dataPointDimension = (*trainingSet->begin())->getDataPoint()->size();
+    featureDimension = featureColumns ? featureColumns->getFeatureDimension() : dataPointDimension;
     classCount = 0;
     
     const size_t trainingSetSize = trainingSet->size();
@@ -47,7 +52,7 @@ void DAGTrainer::validateParameters() throw(ConfigurationException)
     {
         TrainingExample* current = (*trainingSet)[i];
         
-        if (static_cast<int>(current->getDataPoint()->size()) != featureDimension)
+        if (static_cast<int>(current->getDataPoint()->size()) != dataPointDimension)
         {
             throw ConfigurationException("All data points must have the same feature dimension.");
         }
@@ -81,30 +86,406 @@ void DAGTrainer::validateParameters() throw(ConfigurationException)
     
 // Sample the features
 void DAGTrainer::getSampledFeatures(std::vector<int> & sampledFeature)
+{
+    if (getFeatureSampling() != FeatureSamplingNode)
+    {
+        sampledFeature.insert(sampledFeature.end(), sharedFeatures.begin(), sharedFeatures.end());
+        return;
+    }
+    
+    drawFeatures(sampledFeature);
+}
+
+void DAGTrainer::drawFeatures(std::vector<int> & _features)
 {
     std::uniform_int_distribution<int> dist(0, featureDimension - 1);
-    std::random_device rd;
-    std::default_random_engine gen(rd());
     
     for (int i = 0; i < getNumFeatureSamples(); i++)
     {
-        sampledFeature.push_back(dist(gen));
+        _features.push_back(dist(generator));
+    }
+}
+
+void DAGTrainer::sampleSharedFeatures(NodeRow & parentNodes)
+{
+    sharedFeatures.clear();
+    drawFeatures(sharedFeatures);
+    
+    // The feature columns search the features themselves
+    if (featureColumns) return;
+    
+    // Only nodes that search a threshold need the columns
+    const size_t rows = exampleIndex.size();
+    positionNode.assign(rows, -1);
+    for (size_t i = 0; i < parentNodes.size(); i++)
+    {
+        if (parentNodes[i]->isPure()) continue;
+        
+        const size_t offset = getExampleOffset(parentNodes[i]->getTrainingSetBegin());
+        std::fill(positionNode.begin() + offset, positionNode.begin() + offset + parentNodes[i]->getTrainingSetSize(), static_cast<int>(i));
+    }
+    
+    // Binned features don't have to be sorted
+    if (featureBins)
+    {
+        countLevelBins(parentNodes);
+        return;
+    }
+    
+    std::vector<size_t> cursor(parentNodes.size());
+    sharedColumns.resize(sharedFeatures.size());
+    for (size_t k = 0; k < sharedFeatures.size(); k++)
+    {
+        const int feature = sharedFeatures[k];
+        
+        // Sort the examples of all nodes at once
+        columnOrder.clear();
+        for (size_t j = 0; j < rows; j++)
+        {
+            if (positionNode[j] < 0) continue;
+            columnOrder.push_back(std::make_pair(exampleIndex[j].example->getDataPoint()->at(feature), j));
+        }
+        std::sort(columnOrder.begin(), columnOrder.end());
+        
+        // Distribute the sorted examples to their nodes. Every node receives its examples in ascending order
+        for (size_t i = 0; i < parentNodes.size(); i++)
+        {
+            if (parentNodes[i]->isPure()) continue;
+            cursor[i] = getExampleOffset(parentNodes[i]->getTrainingSetBegin());
+        }
+        std::vector<SortedExample> & column = sharedColumns[k];
+        column.resize(rows);
+        for (size_t j = 0; j < columnOrder.size(); j++)
+        {
+            const WeightedExample & example = exampleIndex[columnOrder[j].second];
+            SortedExample & entry = column[cursor[positionNode[columnOrder[j].second]]++];
+            entry.value = columnOrder[j].first;
+            entry.classLabel = example.example->getClassLabel();
+            entry.weight = example.weight;
+        }
+    }
+}
+
+void DAGTrainer::setBinOffsets(const std::vector<int> & _features)
+{
+    binOffsets.resize(_features.size() + 1);
+    binOffsets[0] = 0;
+    for (size_t k = 0; k < _features.size(); k++)
+    {
+        binOffsets[k + 1] = binOffsets[k] + static_cast<size_t>(featureBins->getBinCount(_features[k])) * classCount;
+    }
+}
+
+void DAGTrainer::countBins(const std::vector<int> & _features, const std::vector<size_t> & _offsets, size_t _slotSize, Count* _histograms)
+{
+    // The histograms of a block of features should fit into the L2 cache
+    const size_t blockBytes = 1 << 16;
+    
+    std::vector<const FeatureBins::Bin*> columns(_features.size());
+    for (size_t k = 0; k < _features.size(); k++)
+    {
+        columns[k] = featureBins->getColumn(_features[k]);
+    }
+    
+    for (size_t first = 0, last; first < _features.size(); first = last)
+    {
+        size_t blockSize = static_cast<size_t>(featureBins->getBinCount(_features[first])) * classCount;
+        for (last = first + 1; last < _features.size(); last++)
+        {
+            blockSize += static_cast<size_t>(featureBins->getBinCount(_features[last])) * classCount;
+            if (blockSize * sizeof(Count) > blockBytes) break;
+        }
+        
+        // The examples of a node are adjacent, hence only the histograms of one slot are in use at a time
+        for (std::vector<BinnedExample>::const_iterator it = binnedExamples.begin(); it != binnedExamples.end(); ++it)
+        {
+            Count* histograms = _histograms + static_cast<size_t>(it->slot) * _slotSize + it->classLabel;
+            for (size_t k = first; k < last; k++)
+            {
+                histograms[_offsets[k] + static_cast<size_t>(columns[k][it->row]) * classCount] += it->weight;
+            }
+        }
+    }
+}
+
+void DAGTrainer::countLevelBins(NodeRow & parentNodes)
+{
+    // Every node that searches a threshold gets a slot
+    binSlots.assign(parentNodes.size(), -1);
+    int slots = 0;
+    for (size_t i = 0; i < parentNodes.size(); i++)
+    {
+        if (!parentNodes[i]->isPure())
+        {
+            binSlots[i] = slots++;
+        }
+    }
+    
+    setBinOffsets(sharedFeatures);
+    binHistograms.assign(static_cast<size_t>(slots) * binOffsets.back(), 0);
+    
+    // The features that the last level shared as well are derived from its histograms, all others are counted
+    std::vector<size_t> derived, derivedFrom;
+    std::vector<int> counted;
+    std::vector<size_t> countedOffsets;
+    for (size_t k = 0; k < sharedFeatures.size(); k++)
+    {
+        std::vector<int>::const_iterator it = std::find(splitFeatures.begin(), splitFeatures.end(), sharedFeatures[k]);
+        if (!binSplits.empty() && it != splitFeatures.end())
+        {
+            derived.push_back(k);
+            derivedFrom.push_back(static_cast<size_t>(it - splitFeatures.begin()));
+        }
+        else
+        {
+            counted.push_back(sharedFeatures[k]);
+            countedOffsets.push_back(binOffsets[k]);
+        }
+    }
+    
+    if (!counted.empty())
+    {
+        // The class labels are gathered once, such that the blocks of features only read the compact list
+        binnedExamples.clear();
+        const int* labels = featureBins->getClassLabels();
+        for (size_t j = 0; j < positionNode.size(); j++)
+        {
+            if (positionNode[j] < 0) continue;
+            BinnedExample entry = {exampleIndex[j].row, labels[exampleIndex[j].row], exampleIndex[j].weight, binSlots[positionNode[j]]};
+            binnedExamples.push_back(entry);
+        }
+        countBins(counted, countedOffsets, binOffsets.back(), binHistograms.data());
+    }
+    
+    if (!derived.empty())
+    {
+        deriveLevelBins(parentNodes, derived, derivedFrom);
+    }
+    
+    // Later iterations of this level don't know the histograms of their parents
+    binSplits.clear();
+}
+
+void DAGTrainer::deriveLevelBins(NodeRow & parentNodes, const std::vector<size_t> & _features, const std::vector<size_t> & _splitFeatures)
+{
+    const size_t slotSize = binOffsets.back();
+    const size_t splitSlotSize = splitBinOffsets.back();
+    
+    std::vector<int> features(_features.size());
+    std::vector<size_t> offsets(_features.size());
+    for (size_t j = 0; j < _features.size(); j++)
+    {
+        features[j] = sharedFeatures[_features[j]];
+        offsets[j] = binOffsets[_features[j]];
+    }
+    
+    // The slot of every child node. Pure child nodes don't have a slot
+    std::map<TrainingDAGNode*, int> childSlots;
+    for (size_t i = 0; i < parentNodes.size(); i++)
+    {
+        childSlots[parentNodes[i]] = binSlots[i];
+    }
+    auto slotOf = [&childSlots](TrainingDAGNode* _node) {
+        std::map<TrainingDAGNode*, int>::const_iterator it = childSlots.find(_node);
+        return it == childSlots.end() ? -1 : it->second;
+    };
+    const int* labels = featureBins->getClassLabels();
+    auto addExamples = [this, labels](size_t _offset, size_t _size, int _slot) {
+        for (size_t j = _offset; j < _offset + _size; j++)
+        {
+            BinnedExample entry = {exampleIndex[j].row, labels[exampleIndex[j].row], exampleIndex[j].weight, _slot};
+            binnedExamples.push_back(entry);
+        }
+    };
+    
+    // The histograms of a parent are only used if counting the examples of its larger child would touch more bins
+    size_t derivedSize = 0;
+    for (size_t j = 0; j < features.size(); j++)
+    {
+        derivedSize += static_cast<size_t>(featureBins->getBinCount(features[j])) * classCount;
+    }
+    std::vector<bool> subtract(binSplits.size());
+    for (size_t r = 0; r < binSplits.size(); r++)
+    {
+        const BinSplit & split = binSplits[r];
+        subtract[r] = split.slot >= 0 && std::max(split.leftSize, split.rightSize) * features.size() > derivedSize;
+    }
+    
+    // The smaller child of every parent that was split into two non-empty children is counted into a slot of its own
+    std::vector<int> smallerSlots(binSplits.size(), -1);
+    int smallerSlotCount = 0;
+    binnedExamples.clear();
+    for (size_t r = 0; r < binSplits.size(); r++)
+    {
+        const BinSplit & split = binSplits[r];
+        if (!subtract[r] || split.leftSize == 0 || split.rightSize == 0) continue;
+        
+        smallerSlots[r] = smallerSlotCount++;
+        if (split.leftSize <= split.rightSize)
+        {
+            addExamples(split.leftOffset, split.leftSize, smallerSlots[r]);
+        }
+        else
+        {
+            addExamples(split.rightOffset, split.rightSize, smallerSlots[r]);
+        }
+    }
+    smallerBinHistograms.assign(static_cast<size_t>(smallerSlotCount) * slotSize, 0);
+    countBins(features, offsets, slotSize, smallerBinHistograms.data());
+    
+    // The examples of all other parents, e.g. pure parents without histograms, are counted into their child nodes
+    binnedExamples.clear();
+    for (size_t r = 0; r < binSplits.size(); r++)
+    {
+        const BinSplit & split = binSplits[r];
+        if (subtract[r]) continue;
+        
+        if (slotOf(split.left) >= 0) addExamples(split.leftOffset, split.leftSize, slotOf(split.left));
+        if (slotOf(split.right) >= 0) addExamples(split.rightOffset, split.rightSize, slotOf(split.right));
+    }
+    countBins(features, offsets, slotSize, binHistograms.data());
+    
+    // Distribute the histograms of the parents to their child nodes
+    for (size_t r = 0; r < binSplits.size(); r++)
+    {
+        const BinSplit & split = binSplits[r];
+        if (!subtract[r]) continue;
+        
+        const bool leftSmaller = split.leftSize <= split.rightSize;
+        const int smallSlot = slotOf(leftSmaller ? split.left : split.right);
+        const int largeSlot = slotOf(leftSmaller ? split.right : split.left);
+        for (size_t j = 0; j < features.size(); j++)
+        {
+            const size_t size = static_cast<size_t>(featureBins->getBinCount(features[j])) * classCount;
+            const Count* parent = splitBinHistograms.data() + static_cast<size_t>(split.slot) * splitSlotSize + splitBinOffsets[_splitFeatures[j]];
+            
+            if (smallerSlots[r] < 0)
+            {
+                // All examples went to a single child node
+                const int slot = split.leftSize > 0 ? slotOf(split.left) : slotOf(split.right);
+                if (slot < 0) continue;
+                Count* child = binHistograms.data() + static_cast<size_t>(slot) * slotSize + offsets[j];
+                for (size_t c = 0; c < size; c++)
+                {
+                    child[c] += parent[c];
+                }
+                continue;
+            }
+            
+            const Count* counted = smallerBinHistograms.data() + static_cast<size_t>(smallerSlots[r]) * slotSize + offsets[j];
+            if (smallSlot >= 0)
+            {
+                Count* child = binHistograms.data() + static_cast<size_t>(smallSlot) * slotSize + offsets[j];
+                for (size_t c = 0; c < size; c++)
+                {
+                    child[c] += counted[c];
+                }
+            }
+            if (largeSlot >= 0)
+            {
+                Count* child = binHistograms.data() + static_cast<size_t>(largeSlot) * slotSize + offsets[j];
+                for (size_t c = 0; c < size; c++)
+                {
+                    child[c] += parent[c] - counted[c];
+                }
+            }
+        }
+    }
+}
+
+const Count* DAGTrainer::getBinHistograms(const WeightedExample* _examples, size_t _size, const std::vector<int> & _features)
+{
+    if (getFeatureSampling() != FeatureSamplingNode)
+    {
+        // The bins of the level are already counted
+        return binHistograms.data() + static_cast<size_t>(binSlots[positionNode[getExampleOffset(_examples)]]) * binOffsets.back();
     }
+    
+    // Every node samples its own features, hence its bins are counted on demand
+    binnedExamples.clear();
+    const int* labels = featureBins->getClassLabels();
+    for (size_t j = 0; j < _size; j++)
+    {
+        BinnedExample entry = {_examples[j].row, labels[_examples[j].row], _examples[j].weight, 0};
+        binnedExamples.push_back(entry);
+    }
+    
+    setBinOffsets(_features);
+    binHistograms.assign(binOffsets.back(), 0);
+    countBins(_features, binOffsets, binOffsets.back(), binHistograms.data());
+    return binHistograms.data();
 }
 
-TrainingDAGNode::ptr DAGTrainer::train() throw(ConfigurationException, RuntimeException)
+DAGNode::ptr DAGTrainer::train() throw(ConfigurationException, RuntimeException)
 {
     // Only train the DAG if all parameters are valid
     validateParameters();
     
+    // Select the histogram implementation for the class count
+    histogramBins = selectHistogramBins(classCount);
+    
+    // Seed the feature sampling
+    if (getSeed() >= 0)
+    {
+        generator.seed(getSeed());
+    }
+    else
+    {
+        std::random_device rd;
+        generator.seed(rd());
+    }
+    
     // Start growing the DAG
     NodeRow parentNodes;
     
+    // All nodes of this DAG are allocated in a single arena
+    arena = MemoryArena::Factory::create(getUseHugePages());
+    
+    // Set up the example index. All levels share this index and its partition buffer. Examples that were not drawn 
+    // by bagging are left out, all others appear once with their weight
+    const bool weighted = !exampleWeights.empty();
+    if (weighted && exampleWeights.size() != trainingSet->size())
+    {
+        throw RuntimeException("The number of example weights does not match the training set size.");
+    }
+    
+    Count totalWeight = 0;
+    exampleIndex.clear();
+    exampleIndex.reserve(trainingSet->size());
+    for (size_t i = 0; i < trainingSet->size(); i++)
+    {
+        const int weight = weighted ? exampleWeights[i] : 1;
+        if (weight > 0)
+        {
+            WeightedExample entry = {(*trainingSet)[i], weight, static_cast<RowIndex>(i)};
+            exampleIndex.push_back(entry);
+            totalWeight += weight;
+        }
+    }
+    exampleIndexBuffer.resize(exampleIndex.size());
+    childExampleCounts.reserve(getMaxWidth());
+    
+    if (featureBins && featureBins->getRows() != trainingSet->size())
+    {
+        throw RuntimeException("The feature bins don't match the training set.");
+    }
+    binSplits.clear();
+    
+    // No histogram during training holds more mass than the total weight
+    nlognTable = NLogNTable::Factory::create(totalWeight);
+    
+    // The feature columns mirror the example index
+    if (featureColumns)
+    {
+        featureColumns->beginDAG(exampleWeights, trainingSet->size(), classCount, getSplitCriterion(), totalWeight);
+        partitionLeft.assign(exampleIndex.size(), 0);
+    }
+    
     // Create the root node
     // FIXME
     TrainingDAGNode::ptr root = TrainingDAGNode::Factory::create(this);
     // The root node gets all the training data
-    root->getTrainingSet()->insert(root->getTrainingSet()->end(), trainingSet->begin(), trainingSet->end());
+    root->setTrainingSet(exampleIndex.data(), exampleIndex.size());
     // Set the class histogram and class label for the node
     root->updateHistogramAndLabel();
     // Add the root node to the initial parent level of training
@@ -117,8 +498,16 @@ TrainingDAGNode::ptr DAGTrainer::train() throw(ConfigurationException, RuntimeEx
     Jungle::ptr jungle = Jungle::Factory::create();
     jungle->getDAGs().insert(root);
     
+    interrupted = false;
     for (int level = 1; level <= getMaxDepth(); level++)
     {
+        // Don't start a new level if there is no time left. The DAG ends at the last finished level
+        if (deadlineReached())
+        {
+            interrupted = true;
+            break;
+        }
+        
         // Determine the number of child nodes
         childNodeCount = std::min(static_cast<int>(parentNodes.size()) * 2, getMaxWidth());
         
@@ -127,7 +516,8 @@ TrainingDAGNode::ptr DAGTrainer::train() throw(ConfigurationException, RuntimeEx
         
         if (getVerboseMode())
         {
-            if (getValidationLevel() >= 3)
+            // The training error requires the feature columns
+            if (getValidationLevel() >= 3 && !featureColumns)
             {
                 if (getValidationSet())
                 {
@@ -151,9 +541,143 @@ TrainingDAGNode::ptr DAGTrainer::train() throw(ConfigurationException, RuntimeEx
     }
     jungle->getDAGs().erase(jungle->getDAGs().begin());
     
-    return root;
+    // Convert the DAG into its compact representation. This releases the training arena and with it all training
+    // nodes and their histograms
+    MemoryArena::ptr trainingArena = arena;
+    DAGNode::ptr result = DAGNode::Factory::compact(root, arena);
+    trainingArena.reset();
+    
+    // Release the example index and the n log2(n) table
+    std::vector<WeightedExample>().swap(exampleIndex);
+    std::vector<WeightedExample>().swap(exampleIndexBuffer);
+    std::vector<PartitionBlock>().swap(partitionBlocks);
+    std::vector<int>().swap(exampleWeights);
+    std::vector< std::vector<SortedExample> >().swap(sharedColumns);
+    std::vector<int>().swap(positionNode);
+    std::vector< std::pair<float, size_t> >().swap(columnOrder);
+    std::vector<BinnedExample>().swap(binnedExamples);
+    std::vector<Count>().swap(binHistograms);
+    std::vector<size_t>().swap(binOffsets);
+    std::vector<int>().swap(binSlots);
+    std::vector<BinSplit>().swap(binSplits);
+    std::vector<int>().swap(splitFeatures);
+    std::vector<size_t>().swap(splitBinOffsets);
+    std::vector<Count>().swap(splitBinHistograms);
+    std::vector<Count>().swap(smallerBinHistograms);
+    nlognTable.reset();
+    
+    if (featureColumns)
+    {
+        featureColumns->endDAG();
+        std::vector<char>().swap(partitionLeft);
+    }
+    
+    return result;
+}
+
+NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
+{
+    switch (getSplitCriterion())
+    {
+        case SplitCriterionGini:
+            return trainLevel<GiniCriterion>(parentNodes, childNodeCount);
+        default:
+            return trainLevel<EntropyCriterion>(parentNodes, childNodeCount);
+    }
+}
+
+template <class Criterion>
+NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
+{
+    // Use histograms with compile-time bins whenever the class count permits it
+    switch (histogramBins)
+    {
+        case 2:
+            return trainLevel<2, Criterion>(parentNodes, childNodeCount);
+        case 4:
+            return trainLevel<4, Criterion>(parentNodes, childNodeCount);
+        case 8:
+            return trainLevel<8, Criterion>(parentNodes, childNodeCount);
+        case 16:
+            return trainLevel<16, Criterion>(parentNodes, childNodeCount);
+        case 32:
+            return trainLevel<32, Criterion>(parentNodes, childNodeCount);
+        default:
+            return trainLevel<0, Criterion>(parentNodes, childNodeCount);
+    }
+}
+
+void DAGTrainer::updateLeftRightHistograms(NodeRow & _nodes)
+{
+    if (!featureColumns)
+    {
+        for (size_t i = 0; i < _nodes.size(); i++)
+        {
+            _nodes[i]->updateLeftRightHistogram();
+        }
+        return;
+    }
+    
+    // The partitions are kept for the split of the level
+    std::vector<FeatureColumns::NodePartition> partitions(_nodes.size());
+    for (size_t i = 0; i < _nodes.size(); i++)
+    {
+        TrainingDAGNode* current = _nodes[i];
+        FeatureColumns::NodePartition partition = {getExampleOffset(current->getTrainingSetBegin()), current->getTrainingSetSize(), 
+                current->getFeatureID(), current->getThreshold(), getPartition(current->getTrainingSetBegin())};
+        partitions[i] = partition;
+    }
+    featureColumns->partition(partitions);
+    
+    for (size_t i = 0; i < _nodes.size(); i++)
+    {
+        _nodes[i]->updateLeftRightHistogram(partitions[i].left);
+    }
+}
+
+template <int Bins, class Criterion>
+bool DAGTrainer::findThresholds(NodeRow & parentNodes)
+{
+    NodeRow searchedNodes;
+    std::vector<FeatureColumns::NodeSearch> searches;
+    for (size_t i = 0; i < parentNodes.size(); i++)
+    {
+        TrainingDAGNode* current = parentNodes[i];
+        // Pure nodes don't need a threshold
+        if (current->isPure() || current->getTrainingSetSize() == 0) continue;
+        
+        ThresholdEntropyErrorFunction<Bins, Criterion> error(parentNodes, current);
+        error.initHistograms();
+        
+        FeatureColumns::NodeSearch search;
+        search.offset = getExampleOffset(current->getTrainingSetBegin());
+        search.size = current->getTrainingSetSize();
+        error.getBaseHistograms(search.leftBase, search.rightBase);
+        search.bestError = error.error();
+        search.bestFeature = current->getFeatureID();
+        search.bestThreshold = current->getThreshold();
+        search.found = false;
+        searches.push_back(search);
+        searchedNodes.push_back(current);
+    }
+    featureColumns->findThresholds(sharedFeatures, searches);
+    
+    // Only the nodes with a new threshold need a new partition
+    NodeRow changedNodes;
+    for (size_t i = 0; i < searches.size(); i++)
+    {
+        if (!searches[i].found) continue;
+        
+        searchedNodes[i]->setFeatureID(searches[i].bestFeature);
+        searchedNodes[i]->setThreshold(searches[i].bestThreshold);
+        changedNodes.push_back(searchedNodes[i]);
+    }
+    updateLeftRightHistograms(changedNodes);
+    
+    return !changedNodes.empty();
 }
 
+template <int Bins, class Criterion>
 NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
 {
     // Sort the parent nodes decreasing by their entropy
@@ -172,7 +696,6 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
         TrainingDAGNode* current = parentNodes[parentNodeSize - i - 1];
         current->setThreshold(0);
         current->setFeatureID(0);
-        current->updateLeftRightHistogram();
         
         // Assign the child nodes
         if (current->isPure())
@@ -187,23 +710,43 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
         }
     }
     
+    // The left and right histograms of the initial thresholds
+    updateLeftRightHistograms(parentNodes);
+    
     // Adjust the thresholds and child assignments until nothing changes anymore
     bool change = false;
     int iterationCounter = 0;
     bool isTreeLevel = (static_cast<int>(parentNodes.size()) * 2 == childNodeCount);
+    // Feature columns that search all nodes at once read every shared column once per iteration
+    const bool searchLevel = featureColumns && getFeatureSampling() != FeatureSamplingNode && featureColumns->searchesNodes();
+    if (getFeatureSampling() == FeatureSamplingLevel)
+    {
+        sampleSharedFeatures(parentNodes);
+    }
     do
     {
         change = false;
-        for (size_t i = 0; i < parentNodeSize; i++)
+        if (getFeatureSampling() == FeatureSamplingIteration)
         {
-            TrainingDAGNode* current = parentNodes[i];
-            // Pure nodes don't need a threshold
-            if (current->isPure()) continue;
-            
-            // Find the new optimal threshold
-            if (current->findThreshold(parentNodes))
+            sampleSharedFeatures(parentNodes);
+        }
+        if (searchLevel)
+        {
+            change = findThresholds<Bins, Criterion>(parentNodes);
+        }
+        else
+        {
+            for (size_t i = 0; i < parentNodeSize; i++)
             {
-                change = true;
+                TrainingDAGNode* current = parentNodes[i];
+                // Pure nodes don't need a threshold
+                if (current->isPure()) continue;
+                
+                // Find the new optimal threshold
+                if (current->findThreshold<Bins, Criterion>(parentNodes))
+                {
+                    change = true;
+                }
             }
         }
         
@@ -218,7 +761,7 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
             if (current->isPure())
             {
                 // Find the new optimal child assignment for both pointers
-                if (current->findCoherentChildNodeAssignment(parentNodes, childNodeCount))
+                if (current->findCoherentChildNodeAssignment<Bins, Criterion>(parentNodes, childNodeCount))
                 {
                     change = true;
                 }
@@ -226,24 +769,24 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
             else
             {
                 // Find the new optimal child assignment for the left pointer
-                if (current->findRightChildNodeAssignment(parentNodes, childNodeCount))
+                if (current->findRightChildNodeAssignment<Bins, Criterion>(parentNodes, childNodeCount))
                 {
                     change = true;
                 }
                 // Find the new optimal child assignment for the right pointer
-                if (current->findLeftChildNodeAssignment(parentNodes, childNodeCount))
+                if (current->findLeftChildNodeAssignment<Bins, Criterion>(parentNodes, childNodeCount))
                 {
                     change = true;
                 }
             }
         }
     }
-    while (change && ++iterationCounter < getMaxLevelIterations());
+    while (change && ++iterationCounter < getMaxLevelIterations() && !deadlineReached());
 
     // Determine whether or not the row training shall be performed
     // Get the entropy of the parent row in order to determine whether or not the split shall be performed
-    RowEntropyErrorFunction parentErrorFunction(parentNodes);
-    ChildRowEntropyErrorFunction childErrorFunction(parentNodes, childNodeCount);
+    RowEntropyErrorFunction<Criterion> parentErrorFunction(parentNodes);
+    ChildRowEntropyErrorFunction<Bins, Criterion> childErrorFunction(parentNodes, childNodeCount);
     float parentEntropy = parentErrorFunction.error();
     float childEntroy = childErrorFunction.error();
     // Do not perform the split if it increases the energy
@@ -263,61 +806,183 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
         noParentNode[i] = true;
     }
 
-    // Assign the parent to their child nodes and set the training sets
+    // Split the parents into blocks of examples, such that the examples of large parents are partitioned in parallel 
+    // as well. The blocks keep the order of the example index
+    const size_t blockSize = 1 << 14;
+    partitionBlocks.clear();
     for (size_t i = 0; i < parentNodeSize; i++)
     {
         TrainingDAGNode* current = parentNodes[i];
-        int leftNode = current->getTempLeft();
-        int rightNode = current->getTempRight();
         
         // Assign the parent to the children
-        current->setLeft(childNodes[leftNode]);
-        current->setRight(childNodes[rightNode]);
-
-        // Propagate the training set
-        TrainingSet::ptr parentTrainingSet = current->getTrainingSet();
-        const size_t parentTrainingSetSize = parentTrainingSet->size();
+        current->setLeft(childNodes[current->getTempLeft()]);
+        current->setRight(childNodes[current->getTempRight()]);
+        
+        if (current->getTrainingSetSize() > 0)
+        {
+            noParentNode[current->getTempLeft()] = false;
+            noParentNode[current->getTempRight()] = false;
+        }
         
-        for (size_t j = 0; j < parentTrainingSetSize; j++)
+        for (size_t offset = 0; offset < current->getTrainingSetSize(); offset += blockSize)
+        {
+            PartitionBlock block = {i, current->getTrainingSetBegin() + offset, 
+                    std::min(blockSize, current->getTrainingSetSize() - offset), 0, 0, 0};
+            partitionBlocks.push_back(block);
+        }
+    }
+    
+    // Determine whether or not an example belongs to the left child node. With feature columns, the partition was 
+    // already determined by updateLeftRightHistogram()
+    auto goesLeft = [this, &parentNodes](const PartitionBlock & _block, const WeightedExample* _example) {
+        TrainingDAGNode* current = parentNodes[_block.parent];
+        if (featureColumns)
         {
-            TrainingExample* currentTrainingExample = parentTrainingSet->at(j);
-            // Determine whether or not this example belongs to the left or right child node
-            const float featureValue = currentTrainingExample->getDataPoint()->at(current->getFeatureID());
-            if (featureValue <= current->getThreshold())
+            return getPartition(current->getTrainingSetBegin())[_example - current->getTrainingSetBegin()] != 0;
+        }
+        return _example->example->getDataPoint()->at(current->getFeatureID()) <= current->getThreshold();
+    };
+    const int blockCount = static_cast<int>(partitionBlocks.size());
+    
+    // Count the examples that go to the left child node. Inside the parallel DAG loop, the threads are only started 
+    // if nested parallelism is enabled, see setThreads()
+    #pragma omp parallel for schedule(dynamic) num_threads(getThreads())
+    for (int b = 0; b < blockCount; b++)
+    {
+        PartitionBlock & block = partitionBlocks[b];
+        for (const WeightedExample* it = block.begin; it != block.begin + block.size; ++it)
+        {
+            if (goesLeft(block, it))
+            {
+                block.leftCount++;
+            }
+        }
+    }
+    
+    // Count the number of examples that every child node receives. This way, every child gets a contiguous range
+    // of the example index without growing its training set example by example
+    childExampleCounts.assign(childNodeCount, 0);
+    for (std::vector<PartitionBlock>::const_iterator it = partitionBlocks.begin(); it != partitionBlocks.end(); ++it)
+    {
+        childExampleCounts[parentNodes[it->parent]->getTempLeft()] += it->leftCount;
+        childExampleCounts[parentNodes[it->parent]->getTempRight()] += it->size - it->leftCount;
+    }
+    
+    // Assign the ranges of the partition buffer to the child nodes. From now on, the counts are used as write 
+    // positions
+    size_t offset = 0;
+    for (int i = 0; i < childNodeCount; i++)
+    {
+        const size_t childSize = childExampleCounts[i];
+        childNodes[i]->setTrainingSet(exampleIndexBuffer.data() + offset, childSize);
+        childExampleCounts[i] = offset;
+        offset += childSize;
+    }
+    
+    // Every block writes to the positions after the ones of the blocks before it. If both children are the same 
+    // node, the examples of the block keep their order in the left range
+    for (std::vector<PartitionBlock>::iterator it = partitionBlocks.begin(); it != partitionBlocks.end(); ++it)
+    {
+        const int leftNode = parentNodes[it->parent]->getTempLeft();
+        const int rightNode = parentNodes[it->parent]->getTempRight();
+        if (leftNode == rightNode)
+        {
+            it->leftCount = it->size;
+        }
+        it->leftOffset = childExampleCounts[leftNode];
+        childExampleCounts[leftNode] += it->leftCount;
+        it->rightOffset = childExampleCounts[rightNode];
+        childExampleCounts[rightNode] += it->size - it->leftCount;
+    }
+    
+    // Propagate the training sets. The partition is stable, i.e. the examples keep their relative order
+    #pragma omp parallel for schedule(dynamic) num_threads(getThreads())
+    for (int b = 0; b < blockCount; b++)
+    {
+        const PartitionBlock & block = partitionBlocks[b];
+        const bool split = parentNodes[block.parent]->getTempLeft() != parentNodes[block.parent]->getTempRight();
+        WeightedExample* left = exampleIndexBuffer.data() + block.leftOffset;
+        WeightedExample* right = exampleIndexBuffer.data() + block.rightOffset;
+        for (const WeightedExample* it = block.begin; it != block.begin + block.size; ++it)
+        {
+            if (!split || goesLeft(block, it))
             {
                 // Left child node
-                childNodes[leftNode]->getTrainingSet()->push_back(currentTrainingExample);
+                *left++ = *it;
             }
             else
             {
                 // Right child node
-                childNodes[rightNode]->getTrainingSet()->push_back(currentTrainingExample);
+                *right++ = *it;
             }
-            noParentNode[leftNode] = false;
-            noParentNode[rightNode] = false;
         }
     }
     
-    for (size_t j = 0; j < parentNodeSize; j++)
-    {
-        parentNodes[j]->getTrainingSet()->clear();
-    }
-
-    // It might happen, that a threshold was selected such that a child node
-    // did not receive any training examples. In this case, unify the child nodes
-    for (size_t i = 0; i < parentNodeSize; i++)
+    std::vector<FeatureColumns::Split> splits;
+    const bool keepBins = featureBins && getFeatureSampling() != FeatureSamplingNode;
+    binSplits.clear();
+    for (size_t i = 0, b = 0; i < parentNodeSize; i++)
     {
         TrainingDAGNode* current = parentNodes[i];
         int leftNode = current->getTempLeft();
         int rightNode = current->getTempRight();
         
-        if (childNodes[leftNode]->getTrainingSet()->size() == 0)
+        if (featureColumns)
         {
-            current->setLeft(childNodes[rightNode]);
-            current->setTempLeft(rightNode);
-            noParentNode[leftNode] = true;
+            FeatureColumns::Split split = {getExampleOffset(current->getTrainingSetBegin()), current->getTrainingSetSize(), leftNode, rightNode};
+            splits.push_back(split);
         }
-        else if (childNodes[rightNode]->getTrainingSet()->size() == 0)
+        
+        // Remember where the examples went, such that the next level can derive its bin histograms
+        if (keepBins)
+        {
+            // The blocks of a parent write adjacent ranges, hence the ranges of the parent start with its first block
+            BinSplit split = {binSlots[i], childNodes[leftNode], childNodes[rightNode], 0, 0, 0, 0};
+            for (const size_t first = b; b < partitionBlocks.size() && partitionBlocks[b].parent == i; b++)
+            {
+                if (b == first)
+                {
+                    split.leftOffset = partitionBlocks[b].leftOffset;
+                    split.rightOffset = partitionBlocks[b].rightOffset;
+                }
+                split.leftSize += partitionBlocks[b].leftCount;
+                split.rightSize += partitionBlocks[b].size - partitionBlocks[b].leftCount;
+            }
+            binSplits.push_back(split);
+        }
+        
+        // The parent node does not hold any training examples anymore
+        current->setTrainingSet(0, 0);
+    }
+    
+    // The child nodes now live in the example index. Swapping the vectors does not move their data. 
+    exampleIndex.swap(exampleIndexBuffer);
+    if (keepBins)
+    {
+        splitFeatures = sharedFeatures;
+        splitBinOffsets.swap(binOffsets);
+        splitBinHistograms.swap(binHistograms);
+    }
+    if (featureColumns)
+    {
+        featureColumns->split(childNodeCount, splits, partitionLeft);
+    }
+
+    // It might happen, that a threshold was selected such that a child node
+    // did not receive any training examples. In this case, unify the child nodes
+    for (size_t i = 0; i < parentNodeSize; i++)
+    {
+        TrainingDAGNode* current = parentNodes[i];
+        int leftNode = current->getTempLeft();
+        int rightNode = current->getTempRight();
+        
+        if (childNodes[leftNode]->getTrainingSetSize() == 0)
+        {
+            current->setLeft(childNodes[rightNode]);
+            current->setTempLeft(rightNode);
+            noParentNode[leftNode] = true;
+        }
+        else if (childNodes[rightNode]->getTrainingSetSize() == 0)
         {
             current->setRight(childNodes[leftNode]);
             current->setTempRight(leftNode);
@@ -326,9 +991,11 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
     }
     
     
+    // Select the class label and compute the class histogram for every child node. Adaptive histograms grow in the 
+    // arena of the trainer, which is not thread-safe, hence they are computed by one thread
+    #pragma omp parallel for schedule(dynamic) num_threads(getThreads()) if(getHistogramBins() > 0)
     for (int i = 0; i < childNodeCount; i++)
     {
-        // Select the class label and compute the class histogram for this child node
         childNodes[i]->updateHistogramAndLabel();
     }
     
@@ -338,14 +1005,9 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
     // Decide which nodes to split further
     for (int i = 0; i < childNodeCount; i++)
     {
-        // Delete the nodes without parents and split the other ones
-        if (noParentNode[i])
-        {
-            delete childNodes[i];
-        }
-        else
+        // Drop the nodes without parents and split the other ones. Their memory is released together with the arena
+        if (!noParentNode[i])
         {
-            // This is a pure node, don't split it
             returnChildNodes.push_back(childNodes[i]);
         }
     }
@@ -355,12 +1017,14 @@ NodeRow DAGTrainer::trainLevel(NodeRow &parentNodes, int childNodeCount)
 
 TrainingDAGNode::ptr TrainingDAGNode::Factory::create(DAGTrainerPtr trainer)
 {
-    TrainingDAGNode::ptr node = new TrainingDAGNode(trainer);
+    MemoryArena & arena = *trainer->getArena();
+    TrainingDAGNode::ptr node = new (arena.allocate(sizeof(TrainingDAGNode), alignof(TrainingDAGNode))) TrainingDAGNode(trainer);
 
     // Initialize the parent parameters
-    DAGNode::Factory::init(node, trainer->getClassCount());
+    DAGNode::Factory::init(node);
+    node->setClassHistogram(&node->nodeHistogram);
 
-    node->trainingSet = TrainingSet::Factory::create();
+    node->setTrainingSet(0, 0);
     
     // Initialize the training parameters
     node->setTempLeft(0);
@@ -368,9 +1032,20 @@ TrainingDAGNode::ptr TrainingDAGNode::Factory::create(DAGTrainerPtr trainer)
     node->pure = false;
 
     // Initialize the histograms
-    node->getLeftHistogram()->resize(trainer->getClassCount());
-    node->getRightHistogram()->resize(trainer->getClassCount());
-    node->getClassHistogram()->resize(trainer->getClassCount());
+    if (trainer->getHistogramBins() > 0)
+    {
+        // The bins are padded to the compile-time bin count, see FixedClassHistogram
+        node->getLeftHistogram()->resize(trainer->getClassCount(), arena, trainer->getHistogramBins());
+        node->getRightHistogram()->resize(trainer->getClassCount(), arena, trainer->getHistogramBins());
+        node->nodeHistogram.resize(trainer->getClassCount(), arena, trainer->getHistogramBins());
+    }
+    else
+    {
+        // For many classes, most nodes only see a few of them
+        node->getLeftHistogram()->resizeAdaptive(trainer->getClassCount(), arena);
+        node->getRightHistogram()->resizeAdaptive(trainer->getClassCount(), arena);
+        node->nodeHistogram.resizeAdaptive(trainer->getClassCount(), arena);
+    }
     
     return node;
 }
@@ -378,20 +1053,16 @@ TrainingDAGNode::ptr TrainingDAGNode::Factory::create(DAGTrainerPtr trainer)
 void TrainingDAGNode::resetLeftRightHistogram()
 {
     // The left one becomes zero, the right one becomes the node histogram
-    ClassHistogram* nodeHistogram = getClassHistogram();
-
-    for (int i = 0; i < trainer->getClassCount(); i++)
-    {
-        leftHistogram.set(i, 0);
-        rightHistogram.set(i, nodeHistogram->at(i));
-    }
+    leftHistogram.reset();
+    rightHistogram.reset();
+    rightHistogram.add(*getClassHistogram());
 }
 
 
 void TrainingDAGNode::updateHistogramAndLabel()
 {
     // Compute the histogram
-    TrainingUtil::computHistogram(*getClassHistogram(), getTrainingSet());
+    TrainingUtil::computHistogram(*getClassHistogram(), getTrainingSetBegin(), getTrainingSetEnd());
     // Get the best class label
     setClassLabel(TrainingUtil::histogramArgMax(*getClassHistogram()));
     
@@ -400,12 +1071,13 @@ void TrainingDAGNode::updateHistogramAndLabel()
     entropy = getClassHistogram()->entropy();
 }
 
+template <int Bins, class Criterion>
 bool TrainingDAGNode::findThreshold(NodeRow & parentNodes)
 {
     // If there are no training examples, there is nothing to train
-    if (trainingSet->size() == 0) return false;
+    if (trainingSetSize == 0) return false;
     
-    ThresholdEntropyErrorFunction error(parentNodes, this); 
+    ThresholdEntropyErrorFunction<Bins, Criterion> error(parentNodes, this);
     
     error.initHistograms();
     // Compute the current error in order to find a better threshold
@@ -418,51 +1090,91 @@ bool TrainingDAGNode::findThreshold(NodeRow & parentNodes)
     int bestFeatureID = getFeatureID();
     float bestThreshold = getThreshold();
     
-    float currentEntropy = 0;
-    
     // Return flag to notify the calling optimizer whether or not we changed the threshold
     bool changed = false;
     
-    this->resetLeftRightHistogram();
+    // The binned search keeps the left and right histograms if the threshold doesn't change
+    if (!trainer->getFeatureBins())
+    {
+        this->resetLeftRightHistogram();
+    }
     
     // Iterate over all sampled features
     std::vector<int> sampledFeatures;
     trainer->getSampledFeatures(sampledFeatures);
-    const size_t sampledFeaturesSize = sampledFeatures.size();
-    const size_t trainingSetSize = trainingSet->size();
-    for (size_t i = 0; i < sampledFeaturesSize; i++)
+    
+    if (trainer->getFeatureColumns())
     {
-        const int feature = sampledFeatures[i];
-        setFeatureID(feature);
-        
-        // Sort the training set according to the current feature dimension
-        TrainingExampleComparator compare(getFeatureID());
-        std::sort(trainingSet->begin(), trainingSet->end(), compare);
-        
-        // Initialize the virtual left/right histograms
-        error.resetHistograms();
+        // The feature columns search the features. The training examples are not sorted because the columns mirror their order
+        std::vector<Count> leftBase, rightBase;
+        error.getBaseHistograms(leftBase, rightBase);
+        changed = trainer->getFeatureColumns()->findThreshold(trainer->getExampleOffset(trainingExamples), trainingSetSize, 
+                sampledFeatures, leftBase, rightBase, bestEntropy, bestFeatureID, bestThreshold);
+    }
+    else if (trainer->getFeatureBins())
+    {
+        // Only the class histograms of the bins are visited
+        const FeatureBins & bins = *trainer->getFeatureBins();
+        const Count* histograms = trainer->getBinHistograms(trainingExamples, trainingSetSize, sampledFeatures);
+        const Count* bestBins = 0;
+        int bestLastBin = 0;
+        for (size_t i = 0; i < sampledFeatures.size(); i++)
+        {
+            const int feature = sampledFeatures[i];
+            const float* thresholds = bins.getThresholds(feature);
+            float threshold = 0;
+            if (error.sweep(histograms + trainer->getBinOffset(i), bins.getBinCount(feature), thresholds, bestEntropy, threshold))
+            {
+                bestFeatureID = feature;
+                bestThreshold = threshold;
+                bestBins = histograms + trainer->getBinOffset(i);
+                bestLastBin = static_cast<int>(std::lower_bound(thresholds, thresholds + bins.getBinCount(feature) - 1, threshold) - thresholds);
+                changed = true;
+            }
+        }
         
-        // Test all possible splits
-        for (size_t j = 0; j < trainingSetSize - 1; j++)
+        // The left and right histograms only change with the threshold. Then, they follow from the bins
+        setFeatureID(bestFeatureID);
+        setThreshold(bestThreshold);
+        if (changed)
         {
-            TrainingExample* it = trainingSet->at(j);
-            TrainingExample* itp1 = trainingSet->at(j+1);
-            // Choose the threshold as value between the two adjacent elements
-            setThreshold( (it->getDataPoint()->at(feature) + itp1->getDataPoint()->at(feature) ) / 2 );
-            
-            // Update the histograms
-            error.move(it->getClassLabel());
+            updateLeftRightHistogram(bestBins, bestLastBin);
+        }
+        return changed;
+    }
+    else if (trainer->getFeatureSampling() != FeatureSamplingNode)
+    {
+        // The shared features are already sorted. The examples of this node occupy the same range in every column
+        const size_t offset = trainer->getExampleOffset(trainingExamples);
+        for (size_t i = 0; i < sampledFeatures.size(); i++)
+        {
+            float threshold;
+            if (error.sweep(trainer->getSharedColumn(i) + offset, trainingSetSize, bestEntropy, threshold))
+            {
+                bestFeatureID = sampledFeatures[i];
+                bestThreshold = threshold;
+                changed = true;
+            }
+        }
+    }
+    else
+    {
+        const size_t sampledFeaturesSize = sampledFeatures.size();
+        for (size_t i = 0; i < sampledFeaturesSize; i++)
+        {
+            const int feature = sampledFeatures[i];
             
-            // Get the current entropy
-            currentEntropy = error.error();
+            // Sort the training set according to the current feature dimension
+            TrainingExampleComparator compare(feature);
+            std::sort(getTrainingSetBegin(), getTrainingSetEnd(), compare);
             
-            // Only accept the split if the entropy decreases and the threshold is not insignificant
-            if (currentEntropy < bestEntropy && ( itp1->getDataPoint()->at(feature) - it->getDataPoint()->at(feature)) >= 1e-6)
+            // Test all possible splits
+            float threshold;
+            if (error.sweep(trainingExamples, trainingSetSize, feature, bestEntropy, threshold))
             {
                 // Select this feature and this threshold
                 bestFeatureID = feature;
-                bestThreshold = getThreshold();
-                bestEntropy = currentEntropy;
+                bestThreshold = threshold;
                 changed = true;
             }
         }
@@ -475,13 +1187,14 @@ bool TrainingDAGNode::findThreshold(NodeRow & parentNodes)
     return changed;
 }
 
+template <int Bins, class Criterion>
 bool TrainingDAGNode::findLeftChildNodeAssignment(NodeRow & parentNodes, int childNodeCount)
 {
     // If there are no training examples, there is nothing to train
-    if (trainingSet->size() == 0) return false;
+    if (trainingSetSize == 0) return false;
     
     // Create the error function
-    AssignmentEntropyErrorFunction error(parentNodes, this, childNodeCount);
+    AssignmentEntropyErrorFunction<Bins, Criterion> error(parentNodes, this, childNodeCount);
     error.initHistograms();
     
     // Save the currently best settings
@@ -516,13 +1229,14 @@ bool TrainingDAGNode::findLeftChildNodeAssignment(NodeRow & parentNodes, int chi
     return changed;
 }
 
+template <int Bins, class Criterion>
 bool TrainingDAGNode::findRightChildNodeAssignment(NodeRow & parentNodes, int childNodeCount)
 {
     // If there are no training examples, there is nothing to train
-    if (trainingSet->size() == 0) return false;
+    if (trainingSetSize == 0) return false;
     
     // Create the error function
-    AssignmentEntropyErrorFunction error(parentNodes, this, childNodeCount);
+    AssignmentEntropyErrorFunction<Bins, Criterion> error(parentNodes, this, childNodeCount);
     error.initHistograms();
 
     // Save the currently best settings
@@ -557,13 +1271,14 @@ bool TrainingDAGNode::findRightChildNodeAssignment(NodeRow & parentNodes, int ch
     return changed;
 }
 
+template <int Bins, class Criterion>
 bool TrainingDAGNode::findCoherentChildNodeAssignment(NodeRow & parentNodes, int childNodeCount)
 {
     // If there are no training examples, there is nothing to train
-    if (trainingSet->size() == 0) return false;
+    if (trainingSetSize == 0) return false;
     
     // Create the error function
-    AssignmentEntropyErrorFunction error(parentNodes, this, childNodeCount);
+    AssignmentEntropyErrorFunction<Bins, Criterion> error(parentNodes, this, childNodeCount);
     error.initHistograms();
     
     // Save the currently best settings
@@ -602,21 +1317,19 @@ bool TrainingDAGNode::findCoherentChildNodeAssignment(NodeRow & parentNodes, int
     return changed;
 }
 
-TrainingSet::ptr TrainingSet::Factory::createBySampling(TrainingSet::ptr _trainingSet, int n)
+void TrainingSet::Factory::sampleWeights(TrainingSet::ptr _trainingSet, Count n, std::vector<int> & _weights, 
+        std::default_random_engine & _generator)
 {
     // Create a distribution over the training set
-    std::uniform_int_distribution<int> dist(0,_trainingSet->size() - 1);
-    std::random_device rd;
-    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<Count> dist(0,_trainingSet->size() - 1);
     
-    TrainingSet::ptr result = TrainingSet::Factory::create();
+    // Draw with replacement. Instead of copying the drawn examples, only the duplicates are counted
+    _weights.assign(_trainingSet->size(), 0);
     
-    for (int i = 0; i < n; i++)
+    for (Count i = 0; i < n; i++)
     {
-        result->push_back((*_trainingSet)[dist(gen)]);
+        _weights[dist(_generator)]++;
     }
-    
-    return result;
 }
 
 TrainingExample::ptr TrainingExample::Factory::createFromFileRow(const std::vector<std::string> & _row)
@@ -635,52 +1348,152 @@ TrainingExample::ptr TrainingExample::Factory::createFromFileRow(const std::vect
     return TrainingExample::Factory::create(DataPoint::Factory::createFromFileRow(dataPointRow), atoi(_row[0].c_str()));
 }
 
-TrainingSet::ptr TrainingSet::Factory::createFromFile(const std::string & _fileName, bool _verboseMode)
+TrainingExample::ptr TrainingExample::Factory::createFromFileRow(const std::vector<std::string> & _row, const std::vector<int> & _features)
 {
-    // Create a blank training set and load the file line by line
-    TrainingSet::ptr trainingSet = TrainingSet::Factory::create();
+    if (_row.size() < 2)
+    {
+        throw RuntimeException("Illegal training set row.");
+    }
     
-    std::string data(_fileName);
-
-    std::ifstream in(data.c_str());
-    if (!in.is_open())
+    // The data point may be empty if only the class label is needed
+    DataPoint::ptr dataPoint = new DataPoint::self(_features.size());
+    for (size_t i = 0; i < _features.size(); i++)
     {
-        throw RuntimeException("Could not open training set file.");
+        const size_t column = static_cast<size_t>(_features[i]) + 1;
+        if (column >= _row.size())
+        {
+            delete dataPoint;
+            throw RuntimeException("Illegal training set row.");
+        }
+        (*dataPoint)[i] = atof(_row[column].c_str());
     }
+    
+    return TrainingExample::Factory::create(dataPoint, atoi(_row[0].c_str()));
+}
 
-    // Count the number of lines in order to display the progress bar
-    std::ifstream countFile(_fileName); 
-    int lineCount = std::count(std::istreambuf_iterator<char>(countFile), std::istreambuf_iterator<char>(), '\n');
-    countFile.close();
+namespace {
+    /**
+     * Loads a training set from a file. If _features is given, only these feature columns are loaded
+     */
+    TrainingSet::ptr loadTrainingSet(const std::string & _fileName, bool _verboseMode, const std::vector<int>* _features)
+    {
+        // Create a blank training set and load the file line by line
+        TrainingSet::ptr trainingSet = TrainingSet::Factory::create();
     
-    ProgressBar::ptr progressBar = ProgressBar::Factory::create(lineCount);
+        std::string data(_fileName);
+
+        std::ifstream in(data.c_str());
+        if (!in.is_open())
+        {
+            throw RuntimeException("Could not open training set file.");
+        }
+
+        // Count the number of lines in order to display the progress bar
+        std::ifstream countFile(_fileName); 
+        size_t lineCount = ProgressBar::countLines(countFile);
+        countFile.close();
+    
+        ProgressBar::ptr progressBar = ProgressBar::Factory::create(lineCount);
     
-    typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
+        typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
 
-    std::vector< std::string > row;
-    std::string line;
+        std::vector< std::string > row;
+        std::string line;
 
-    while (std::getline(in,line))
-    {
-        if (_verboseMode)
+        while (std::getline(in,line))
         {
-            progressBar->update();
-        }
+            if (_verboseMode)
+            {
+                progressBar->update();
+            }
         
-        Tokenizer tok(line);
-        row.assign(tok.begin(),tok.end());
+            Tokenizer tok(line);
+            row.assign(tok.begin(),tok.end());
 
-        // Do not consider blank line
-        if (row.size() == 0) continue;
+            // Do not consider blank line
+            if (row.size() == 0) continue;
         
-        // Load the training example to the training set
-        TrainingExample::ptr example = TrainingExample::Factory::createFromFileRow(row);
-        trainingSet->push_back(example);
+            // Load the training example to the training set
+            TrainingExample::ptr example = _features ? TrainingExample::Factory::createFromFileRow(row, *_features) : 
+                    TrainingExample::Factory::createFromFileRow(row);
+            trainingSet->push_back(example);
+        }
+    
+        in.close();
+    
+        return trainingSet;
+    }
+}
+
+TrainingSet::ptr TrainingSet::Factory::createFromFile(const std::string & _fileName, bool _verboseMode)
+{
+    return loadTrainingSet(_fileName, _verboseMode, 0);
+}
+
+TrainingSet::ptr TrainingSet::Factory::createFromFile(const std::string & _fileName, bool _verboseMode, const std::vector<int> & _features)
+{
+    return loadTrainingSet(_fileName, _verboseMode, &_features);
+}
+
+FeatureBins::ptr FeatureBins::Factory::create(TrainingSet::ptr _trainingSet, int _maxBins, int _threads)
+{
+    if (_maxBins < 2 || _maxBins > 256)
+    {
+        throw ConfigurationException("The number of feature bins must be in [2, 256].");
     }
     
-    in.close();
+    FeatureBins::ptr result(new FeatureBins());
+    const size_t rows = _trainingSet->size();
+    const int featureDimension = rows > 0 ? static_cast<int>((*_trainingSet)[0]->getDataPoint()->size()) : 0;
+    result->rows = rows;
+    result->thresholds.resize(featureDimension);
+    result->bins.resize(rows * featureDimension);
+    result->classLabels.resize(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        result->classLabels[i] = (*_trainingSet)[i]->getClassLabel();
+    }
     
-    return trainingSet;
+    #pragma omp parallel for schedule(dynamic) num_threads(_threads)
+    for (int f = 0; f < featureDimension; f++)
+    {
+        std::vector<float> values(rows);
+        for (size_t i = 0; i < rows; i++)
+        {
+            values[i] = (*_trainingSet)[i]->getDataPoint()->at(f);
+        }
+        std::sort(values.begin(), values.end());
+        
+        // Values that are closer than the minimal threshold distance of the sweep share a bin
+        size_t gaps = 0;
+        for (size_t i = 1; i < rows; i++)
+        {
+            if (values[i] - values[i - 1] >= 1e-6) gaps++;
+        }
+        
+        // If there are few distinct values, every value gets a bin of its own. Otherwise, a bin is closed at the 
+        // first gap after its quantile
+        std::vector<float> & thresholds = result->thresholds[f];
+        for (size_t i = 1; i < rows && thresholds.size() + 1 < static_cast<size_t>(_maxBins); i++)
+        {
+            if (values[i] - values[i - 1] < 1e-6) continue;
+            if (gaps < static_cast<size_t>(_maxBins) || i >= (thresholds.size() + 1) * rows / _maxBins)
+            {
+                thresholds.push_back((values[i - 1] + values[i]) / 2);
+            }
+        }
+        
+        // An example is in the first bin whose threshold is not smaller than its value. This is the same 
+        // comparison as the one that splits the examples of a node
+        Bin* column = result->bins.data() + static_cast<size_t>(f) * rows;
+        for (size_t i = 0; i < rows; i++)
+        {
+            const float value = (*_trainingSet)[i]->getDataPoint()->at(f);
+            column[i] = static_cast<Bin>(std::lower_bound(thresholds.begin(), thresholds.end(), value) - thresholds.begin());
+        }
+    }
+    
+    return result;
 }
 
 DAGTrainer::ptr DAGTrainer::Factory::createFromJungleTrainer(JungleTrainer::ptr _jungleTrainer, TrainingSet::ptr _trainingSet)
@@ -697,6 +1510,11 @@ DAGTrainer::ptr DAGTrainer::Factory::createFromJungleTrainer(JungleTrainer::ptr
     result->setValidationLevel(_jungleTrainer->getValidationLevel());
     result->setValidationSet(_jungleTrainer->getValidationSet());
     result->setSortParentNodes(_jungleTrainer->getSortParentNodes());
+    result->setUseHugePages(_jungleTrainer->getUseHugePages());
+    result->setSplitCriterion(_jungleTrainer->getSplitCriterion());
+    result->setFeatureSampling(_jungleTrainer->getFeatureSampling());
+    result->setDeadline(_jungleTrainer->getDeadline());
+    result->setSeed(_jungleTrainer->getSeed());
     
     return result;
 }
@@ -713,6 +1531,11 @@ void AbstractTrainer::Factory::init(AbstractTrainer::ptr _trainer)
     // -1 means that the number of features to sample will be determined automatically
     _trainer->numFeatureSamples = -1;
     _trainer->sortParentNodes = true;
+    _trainer->useHugePages = false;
+    _trainer->splitCriterion = SplitCriterionEntropy;
+    _trainer->featureSampling = FeatureSamplingNode;
+    _trainer->deadline = std::chrono::steady_clock::time_point::max();
+    _trainer->seed = -1;
 }
 
 void JungleTrainer::Factory::init(JungleTrainer::ptr _trainer)
@@ -723,6 +1546,16 @@ void JungleTrainer::Factory::init(JungleTrainer::ptr _trainer)
     _trainer->numTrainingSamples = -1;
     _trainer->numDAGs = 1;
     _trainer->maxParallel = 8;
+    _trainer->outOfBagLevel = 0;
+    _trainer->earlyStoppingWindow = 0;
+    _trainer->earlyStoppingTolerance = 1e-3f;
+    _trainer->timeBudget = 0;
+    _trainer->keepInterruptedDAGs = false;
+    _trainer->checkpointFileName = "";
+    _trainer->resume = false;
+    _trainer->keepDAGs = true;
+    _trainer->featureBinCount = 0;
+    _trainer->randomSeed = 0;
 }
 
 Jungle::ptr JungleTrainer::train(TrainingSet::ptr trainingSet) throw(ConfigurationException, RuntimeException)
@@ -730,108 +1563,776 @@ Jungle::ptr JungleTrainer::train(TrainingSet::ptr trainingSet) throw(Configurati
     // If the number of training examples is set to -1, we determine the number automatically
     if (numTrainingSamples == -1)
     {
-        numTrainingSamples = std::min(static_cast<int>(trainingSet->size()), static_cast<int>(std::floor(trainingSet->size() * 5 / static_cast<float>(numDAGs))));
+        numTrainingSamples = std::min(static_cast<Count>(trainingSet->size()), static_cast<Count>(std::floor(trainingSet->size() * 5 / static_cast<float>(numDAGs))));
     }
     
     Jungle::ptr jungle = Jungle::Factory::create();
     
+    // The deadline is passed on to the DAG trainers
+    if (getTimeBudget() > 0)
+    {
+        setDeadline(std::chrono::steady_clock::now() + 
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(getTimeBudget())));
+    }
+    else
+    {
+        setDeadline(std::chrono::steady_clock::time_point::max());
+    }
+    
+    // Every DAG keeps its seed during the run, also if it is handed out to a worker
+    if (getSeed() < 0)
+    {
+        std::random_device rd;
+        randomSeed = rd();
+    }
+    
     if (getVerboseMode())
     {
         printf("Start training\n");
-        printf("Number of training examples: %d\n", static_cast<int>(trainingSet->size()));
+        printf("Number of training examples: %zu\n", trainingSet->size());
         if (getUseBagging())
         {
-            printf("Number of examples per DAG: %d\n", getNumTrainingSamples());
+            printf("Number of examples per DAG: %lld\n", static_cast<long long>(getNumTrainingSamples()));
         }
         printf("Number of DAGs to train: %d\n", getNumDAGs());
     }
     
-    // Display some error statistics
-    TrainingStatistics::ptr statisticsTool = TrainingStatistics::Factory::create();
-
-    #pragma omp parallel for num_threads(getMaxParallel())
-    for (int i = 0; i < numDAGs; i++)
+    // Continue from the DAGs that were completed by a previous run and append all new DAGs to the checkpoint file.
+    // The existing DAGs are also needed in order to vote for the validation set if it decides about early stopping
+    const bool validationStopping = getEarlyStoppingWindow() > 0 && getValidationSet();
+    std::set<int> existingIndices;
+    Jungle::ptr existingJungle = getKeepDAGs() ? jungle : (validationStopping ? Jungle::Factory::create() : Jungle::ptr());
+    ModelWriter::ptr checkpoint;
+    if (!getKeepDAGs() && getCheckpointFileName().size() == 0)
     {
-        #pragma omp critical
+        throw ConfigurationException("DAGs that are not kept in memory must be written to a checkpoint file.");
+    }
+    if (getCheckpointFileName().size() > 0)
+    {
+        if (getResume())
         {
+            const int resumedDAGs = loadCheckpoint(existingJungle, existingIndices);
             if (getVerboseMode())
             {
-                std::cout << "Train DAG " << (i+1) << "/" << getNumDAGs() << std::endl;
+                std::cout << "Resumed " << resumedDAGs << " DAGs from checkpoint" << std::endl;
             }
         }
         
-        // Create a training set for each DAG by sampling from the given training set
-        TrainingSet::ptr sampledSet = trainingSet;
-        if (getUseBagging())
+        checkpoint = ModelWriter::Factory::create(getCheckpointFileName(), getResume());
+    }
+    
+    // Warm start from the initial jungle. A checkpoint already contains the initial DAGs. They take the first indices
+    if (initialJungle && existingIndices.empty())
+    {
+        int index = 0;
+        for (std::set<DAGNode::ptr>::iterator it = initialJungle->getDAGs().begin(); it != initialJungle->getDAGs().end(); ++it)
+        {
+            if (checkpoint)
+            {
+                checkpoint->write(*it, index);
+            }
+            existingIndices.insert(index++);
+        }
+        if (getKeepDAGs())
+        {
+            jungle->getDAGs().insert(initialJungle->getDAGs().begin(), initialJungle->getDAGs().end());
+            jungle->getArenas().insert(jungle->getArenas().end(), initialJungle->getArenas().begin(), initialJungle->getArenas().end());
+        }
+        existingJungle = initialJungle;
+        
+        if (getVerboseMode())
+        {
+            std::cout << "Initial jungle: " << index << " DAGs" << std::endl;
+        }
+    }
+    
+    // The DAGs of a previous run may have been completed out of order. Only the missing indices are trained
+    std::vector<int> missingDAGs;
+    for (int i = 0; i < numDAGs; i++)
+    {
+        if (existingIndices.count(i) == 0)
+        {
+            missingDAGs.push_back(i);
+        }
+    }
+    const int existingDAGs = numDAGs - static_cast<int>(missingDAGs.size());
+    
+    // With feature columns, the training set only holds the class labels. The DAGs can't classify the training set
+    if (featureColumns)
+    {
+        if (coordinator)
+        {
+            throw ConfigurationException("External feature columns cannot be combined with distributed DAGs.");
+        }
+        if (getUseBagging() && getOutOfBagLevel() > 0)
+        {
+            throw ConfigurationException("Out-of-bag estimates are not available with external feature columns.");
+        }
+        if (getEarlyStoppingWindow() > 0 && !getValidationSet())
+        {
+            throw ConfigurationException("Early stopping with external feature columns requires a validation set.");
+        }
+        
+        if (getFeatureBinCount() > 0)
+        {
+            throw ConfigurationException("Feature binning is not available with external feature columns.");
+        }
+        
+        featureColumns->connect(trainingSet->size());
+    }
+    
+    // The features are binned once for all DAGs. The workers of a coordinator bin their own training sets
+    featureBins.reset();
+    if (getFeatureBinCount() > 0 && !coordinator)
+    {
+        verboseMessage("Binning features");
+        featureBins = FeatureBins::Factory::create(trainingSet, getFeatureBinCount(), getMaxParallel());
+    }
+    
+    // The out-of-bag examples are only known if we use bagging
+    outOfBagEstimate.reset();
+    if (getUseBagging() && getOutOfBagLevel() > 0)
+    {
+        outOfBagEstimate = OutOfBagEstimate::Factory::create(trainingSet);
+    }
+    
+    // Early stopping watches the error on the validation set or the out-of-bag error as the DAGs are completed
+    TrainingProgress progress;
+    progress.jungle = jungle;
+    progress.trainingSet = trainingSet;
+    progress.checkpoint = checkpoint;
+    progress.stopped = false;
+    progress.keptDAGs = existingDAGs;
+    if (getEarlyStoppingWindow() > 0)
+    {
+        if (getValidationSet())
+        {
+            progress.stoppingEstimate = OutOfBagEstimate::Factory::create(getValidationSet());
+        }
+        else if (outOfBagEstimate)
+        {
+            progress.stoppingEstimate = outOfBagEstimate;
+        }
+        else if (getUseBagging())
         {
-            sampledSet = TrainingSet::Factory::createBySampling(trainingSet, numTrainingSamples);
+            progress.stoppingEstimate = OutOfBagEstimate::Factory::create(trainingSet);
         }
+        else
+        {
+            throw ConfigurationException("Early stopping requires bagging or a validation set.");
+        }
+    }
+    
+    // Early stopping judges the whole jungle, including the DAGs of a warm start or a previous run
+    if (validationStopping && existingJungle)
+    {
+        for (std::set<DAGNode::ptr>::iterator it = existingJungle->getDAGs().begin(); it != existingJungle->getDAGs().end(); ++it)
+        {
+            progress.stoppingEstimate->addDAG(*it);
+        }
+    }
+    existingJungle.reset();
+    
+    // Hand out the DAGs to the workers of the coordinator. They derive the same DAGs from the seeds and stop at the 
+    // deadline as well
+    if (coordinator)
+    {
+        coordinator->setDeadline(getDeadline());
+        coordinator->run(missingDAGs, 
+            [this](int i) {
+                if (getVerboseMode())
+                {
+                    std::cout << "Hand out DAG " << (i+1) << "/" << getNumDAGs() << std::endl;
+                }
+                return getDAGSeed(i);
+            },
+            [this, &progress](int i, unsigned int seed, DAGNode::ptr dag, MemoryArena::ptr arena, bool interrupted) {
+                // The bagging weights are only needed for the out-of-bag estimates. They follow from the seed of the DAG
+                std::vector<int> weights;
+                DAGTrainer::ptr trainer = createDAGTrainer(progress.trainingSet, seed, weights);
+                delete trainer;
+                addTrainedDAG(progress, i, dag, arena, interrupted, weights);
+            },
+            [this, &progress]() {
+                return progress.stopped || deadlineReached();
+            });
         
-        DAGTrainer::ptr trainer = DAGTrainer::Factory::createFromJungleTrainer(this, sampledSet);
-        TrainingDAGNode::ptr dag = trainer->train();
+        return jungle;
+    }
 
+    // The feature columns serve one DAG at a time. Threads without a DAG are left to the partitioning of the levels
+    const int parallelDAGs = featureColumns ? 1 : std::max(1, std::min(getMaxParallel(), static_cast<int>(missingDAGs.size())));
+    #pragma omp parallel for num_threads(parallelDAGs)
+    for (int k = 0; k < static_cast<int>(missingDAGs.size()); k++)
+    {
+        const int i = missingDAGs[k];
+        
+        // Don't start any new DAGs after the error has converged or the time is up
+        bool skip;
+        #pragma omp atomic read
+        skip = progress.stopped;
+        if (skip || deadlineReached()) continue;
+        
         #pragma omp critical
         {
-            jungle->getDAGs().insert(dag);
             if (getVerboseMode())
             {
-                std::cout << "DAG completed\n";
-                std::cout << "Training error: " << statisticsTool->trainingError(jungle, trainingSet) << std::endl;
-                if (getValidationLevel() >= 2 && getValidationSet())
-                {
-                    std::cout << "Test error: " << statisticsTool->trainingError(jungle, getValidationSet()) << std::endl;
-                }
-                std::cout << "----------------------------\n";
+                std::cout << "Train DAG " << (i+1) << "/" << getNumDAGs() << std::endl;
             }
         }
-
+        
+        std::vector<int> weights;
+        DAGTrainer::ptr trainer = createDAGTrainer(trainingSet, getDAGSeed(i), weights);
+        trainer->setThreads(std::max(1, getMaxParallel() / parallelDAGs));
+        DAGNode::ptr dag = trainer->train();
+        
+        // A DAG that is not added to the jungle is released together with its trainer
+        addTrainedDAG(progress, i, dag, trainer->getArena(), trainer->isInterrupted(), weights);
+        
         delete trainer;
     }
     
+    if (featureColumns)
+    {
+        featureColumns->close();
+    }
+    
     return jungle;
 }
 
+unsigned int JungleTrainer::getDAGSeed(int _index)
+{
+    // Every DAG gets its own seed. The seeds continue after the DAGs of a warm start
+    if (getSeed() >= 0)
+    {
+        return static_cast<unsigned int>(getSeed() + _index);
+    }
+    
+    return randomSeed + static_cast<unsigned int>(_index);
+}
+
+DAGTrainer::ptr JungleTrainer::createDAGTrainer(TrainingSet::ptr _trainingSet, unsigned int _dagSeed, std::vector<int> & _weights)
+{
+    // All DAGs share the training set. Bagging only draws the number of times each example is used
+    DAGTrainer::ptr trainer = DAGTrainer::Factory::createFromJungleTrainer(this, _trainingSet);
+    trainer->setFeatureColumns(featureColumns);
+    trainer->setThreads(getMaxParallel());
+    
+    // Workers don't run train(), hence the features may not be binned yet
+    if (getFeatureBinCount() > 0 && !coordinator)
+    {
+        if (!featureBins)
+        {
+            featureBins = FeatureBins::Factory::create(_trainingSet, getFeatureBinCount(), getMaxParallel());
+        }
+        trainer->setFeatureBins(featureBins);
+    }
+    std::default_random_engine generator(_dagSeed);
+    
+    _weights.clear();
+    if (getUseBagging())
+    {
+        // Workers don't run train(), hence the sample count may not be determined yet
+        Count sampleCount = numTrainingSamples;
+        if (sampleCount == -1)
+        {
+            sampleCount = std::min(static_cast<Count>(_trainingSet->size()), static_cast<Count>(std::floor(_trainingSet->size() * 5 / static_cast<float>(numDAGs))));
+        }
+        TrainingSet::Factory::sampleWeights(_trainingSet, sampleCount, _weights, generator);
+        trainer->getExampleWeights() = _weights;
+    }
+    trainer->setSeed(static_cast<int>(generator() & 0x7FFFFFFF));
+    
+    return trainer;
+}
+
+void JungleTrainer::addTrainedDAG(TrainingProgress & _progress, int _index, DAGNode::ptr _dag, MemoryArena::ptr _arena, 
+        bool _interrupted, const std::vector<int> & _weights) throw(RuntimeException)
+{
+    // A DAG that was interrupted by the time budget is only kept on request or if there is no other DAG
+    bool keep = !_interrupted || getKeepInterruptedDAGs();
+    #pragma omp critical
+    {
+        if (!keep && _progress.keptDAGs == 0)
+        {
+            keep = true;
+        }
+        if (keep)
+        {
+            _progress.keptDAGs++;
+        }
+        if (getVerboseMode() && _interrupted)
+        {
+            std::cout << "DAG " << (_index+1) << " interrupted by the time budget" << (keep ? "" : ", discarded") << std::endl;
+        }
+    }
+    if (!keep)
+    {
+        return;
+    }
+    
+    // Let the DAG vote for the examples it has not seen
+    if (outOfBagEstimate)
+    {
+        outOfBagEstimate->addDAG(_dag, _weights);
+    }
+    if (_progress.stoppingEstimate && _progress.stoppingEstimate != outOfBagEstimate)
+    {
+        if (getValidationSet())
+        {
+            _progress.stoppingEstimate->addDAG(_dag);
+        }
+        else
+        {
+            _progress.stoppingEstimate->addDAG(_dag, _weights);
+        }
+    }
+
+    // Write the DAG as soon as it is finished
+    if (_progress.checkpoint)
+    {
+        #pragma omp critical (modelWriter)
+        {
+            _progress.checkpoint->write(_dag, _index);
+        }
+    }
+
+    #pragma omp critical
+    {
+        if (getKeepDAGs())
+        {
+            _progress.jungle->addDAG(_dag, _arena);
+        }
+        if (getVerboseMode())
+        {
+            TrainingStatistics::ptr statisticsTool = TrainingStatistics::Factory::create();
+            
+            std::cout << "DAG completed\n";
+            if (getKeepDAGs() && !featureColumns)
+            {
+                std::cout << "Training error: " << statisticsTool->trainingError(_progress.jungle, _progress.trainingSet) << std::endl;
+            }
+            if (outOfBagEstimate)
+            {
+                std::cout << "OOB error: " << outOfBagEstimate->error() << std::endl;
+            }
+            if (getValidationLevel() >= 2 && getValidationSet() && getKeepDAGs())
+            {
+                std::cout << "Test error: " << statisticsTool->trainingError(_progress.jungle, getValidationSet()) << std::endl;
+            }
+            std::cout << "----------------------------\n";
+        }
+        
+        // Stop if the error did not improve enough over the last DAGs
+        if (_progress.stoppingEstimate)
+        {
+            _progress.errorHistory.push_back(_progress.stoppingEstimate->error());
+            
+            const size_t window = static_cast<size_t>(getEarlyStoppingWindow());
+            if (_progress.errorHistory.size() > window && 
+                    _progress.errorHistory[_progress.errorHistory.size() - 1 - window] - _progress.errorHistory.back() < getEarlyStoppingTolerance())
+            {
+                if (getVerboseMode() && !_progress.stopped)
+                {
+                    std::cout << "Early stopping after " << _progress.errorHistory.size() << " DAGs, error: " << _progress.errorHistory.back() << std::endl;
+                }
+                #pragma omp atomic write
+                _progress.stopped = true;
+            }
+        }
+    }
+}
+
 float TrainingStatistics::trainingError(Jungle::ptr _jungle, TrainingSet::ptr _trainingSet)
 {
-    // Calculate the training error
-    float error = 0;
+    // Count the misclassified examples
+    RowIndex errors = 0;
     for (TrainingSet::iterator iter = _trainingSet->begin(); iter != _trainingSet->end(); ++iter)
     {
         if ((*iter)->getClassLabel() != _jungle->predict((*iter)->getDataPoint())->getClassLabel())
         {
-            error++;
+            errors++;
         }
     }
     
     // Calculate the relative error
     if (_trainingSet->size()  > 0)
     {
-        error = error/static_cast<float>(_trainingSet->size());
+        return static_cast<float>(errors/static_cast<double>(_trainingSet->size()));
+    }
+    
+    return 0;
+}
+
+int JungleTrainer::loadCheckpoint(Jungle::ptr _jungle, std::set<int> & _indices) throw(RuntimeException)
+{
+    _indices.clear();
+    
+    std::ifstream in(getCheckpointFileName());
+    if (!in.is_open())
+    {
+        // There is nothing to resume from
+        return 0;
+    }
+    
+    // Collect the complete blocks. A block is only complete if its trailer matches the number of rows
+    std::string complete;
+    std::string block;
+    std::string line;
+    int rowCount = 0;
+    int dagCount = 0;
+    int unindexedCount = 0;
+    while (std::getline(in, line))
+    {
+        if (line.size() > 0 && line[0] == '#')
+        {
+            if (rowCount > 0 && atoi(line.c_str() + 1) == rowCount)
+            {
+                complete += block + line + "\n";
+                dagCount++;
+                
+                // The trailer "#{rows} {index}" records the index of the DAG
+                const size_t separator = line.find(' ');
+                if (separator != std::string::npos)
+                {
+                    _indices.insert(atoi(line.c_str() + separator + 1));
+                }
+                else
+                {
+                    unindexedCount++;
+                }
+            }
+            else
+            {
+                break;
+            }
+            block.clear();
+            rowCount = 0;
+        }
+        else
+        {
+            block += line + "\n";
+            rowCount++;
+        }
+    }
+    in.close();
+    
+    // Blocks of older checkpoint files were written in the order of the indices
+    for (int i = 0; unindexedCount > 0; i++)
+    {
+        if (_indices.insert(i).second)
+        {
+            unindexedCount--;
+        }
+    }
+    
+    // Load the complete DAGs
+    std::istringstream blocks(complete);
+    Jungle::ptr checkpointJungle = Jungle::Factory::createFromStream(blocks, 0, false);
+    if (static_cast<int>(checkpointJungle->getDAGs().size()) != dagCount)
+    {
+        throw RuntimeException("Invalid block in checkpoint file.");
+    }
+    if (_jungle)
+    {
+        // Take over the DAGs together with their arenas
+        _jungle->getDAGs().insert(checkpointJungle->getDAGs().begin(), checkpointJungle->getDAGs().end());
+        _jungle->getArenas().insert(_jungle->getArenas().end(), checkpointJungle->getArenas().begin(), checkpointJungle->getArenas().end());
+    }
+    
+    // Drop an incomplete block at the end such that new blocks can be appended. The file is replaced atomically
+    const std::string tempFileName = getCheckpointFileName() + ".tmp";
+    std::ofstream out(tempFileName, std::ios::trunc);
+    out << complete;
+    out.close();
+    if (!out || std::rename(tempFileName.c_str(), getCheckpointFileName().c_str()) != 0)
+    {
+        throw RuntimeException("Could not rewrite checkpoint file.");
+    }
+    
+    return dagCount;
+}
+
+OutOfBagEstimate::ptr OutOfBagEstimate::Factory::create(TrainingSet::ptr _trainingSet)
+{
+    OutOfBagEstimate::ptr result(new OutOfBagEstimate());
+    result->trainingSet = _trainingSet;
+    result->coverage = 0;
+    result->errors = 0;
+    
+    // Determine the class count
+    result->classCount = 0;
+    for (TrainingSet::iterator iter = _trainingSet->begin(); iter != _trainingSet->end(); ++iter)
+    {
+        result->classCount = std::max(result->classCount, (*iter)->getClassLabel() + 1);
+    }
+    
+    // For many classes, every example only collects the votes of a few of them
+    result->votes.resize(_trainingSet->size());
+    for (size_t i = 0; i < result->votes.size(); i++)
+    {
+        result->votes[i].resizeAdaptive(result->classCount);
+    }
+    
+    return result;
+}
+
+void OutOfBagEstimate::addDAG(const DAGNode* _dag, const std::vector<int> & _weights)
+{
+    if (_weights.size() != trainingSet->size())
+    {
+        throw RuntimeException("The number of example weights does not match the training set size.");
     }
     
-    return error;
+    addVotes(_dag, &_weights);
+}
+
+void OutOfBagEstimate::addDAG(const DAGNode* _dag)
+{
+    addVotes(_dag, 0);
+}
+
+void OutOfBagEstimate::addVotes(const DAGNode* _dag, const std::vector<int>* _weights)
+{
+    // Classify the out-of-bag examples before the votes are locked
+    std::vector< std::pair<size_t, ClassLabel> > dagVotes;
+    for (size_t i = 0; i < trainingSet->size(); i++)
+    {
+        if (_weights && (*_weights)[i] > 0) continue;
+        
+        const DAGNode* leafNode = _dag->getLeafNode((*trainingSet)[i]->getDataPoint());
+        
+        // Leaves without examples of their class don't vote, see Jungle::predict()
+        if (leafNode->getClassHistogram()->at(leafNode->getClassLabel()) <= 0) continue;
+        
+        dagVotes.push_back(std::make_pair(i, leafNode->getClassLabel()));
+    }
+    
+    #pragma omp critical (outOfBagVotes)
+    {
+        for (size_t k = 0; k < dagVotes.size(); k++)
+        {
+            const size_t i = dagVotes[k].first;
+            const ClassLabel label = (*trainingSet)[i]->getClassLabel();
+            
+            // Keep the error up to date by comparing the predictions before and after the vote
+            const ClassLabel before = predict(i);
+            votes[i].addOne(dagVotes[k].second);
+            const ClassLabel after = predict(i);
+            
+            if (before < 0)
+            {
+                coverage++;
+            }
+            else if (before != label)
+            {
+                errors--;
+            }
+            if (after != label)
+            {
+                errors++;
+            }
+        }
+    }
+}
+
+ClassLabel OutOfBagEstimate::predict(size_t i) const
+{
+    if (votes[i].getMass() <= 0) return -1;
+    
+    return TrainingUtil::histogramArgMax(votes[i]);
+}
+
+float OutOfBagEstimate::error() const
+{
+    // Calculate the relative error
+    if (coverage > 0)
+    {
+        return static_cast<float>(errors/static_cast<double>(coverage));
+    }
+    
+    return 0;
+}
+
+RowIndex OutOfBagEstimate::getCoverage() const
+{
+    return coverage;
+}
+
+Matrix OutOfBagEstimate::confusionMatrix() const
+{
+    Matrix result(classCount, std::vector<float>(classCount, 0));
+    
+    for (size_t i = 0; i < votes.size(); i++)
+    {
+        const ClassLabel prediction = predict(i);
+        if (prediction < 0) continue;
+        
+        result[(*trainingSet)[i]->getClassLabel()][prediction]++;
+    }
+    
+    return result;
 }
 
 void TrainingDAGNode::updateLeftRightHistogram()
 {
     leftHistogram.reset();
     rightHistogram.reset();
+    
+    if (trainer->getFeatureColumns())
+    {
+        // The feature columns decide for every example. The partition is kept for the split of the level
+        char* left = trainer->getPartition(trainingExamples);
+        trainer->getFeatureColumns()->partition(trainer->getExampleOffset(trainingExamples), trainingSetSize, getFeatureID(), getThreshold(), left);
+        updateLeftRightHistogram(left);
+        return;
+    }
 
-    const size_t trainingSetSize = trainingSet->size();
     for(size_t i = 0; i < trainingSetSize; i++)
     {
-        TrainingExample* current = trainingSet->at(i);
+        TrainingExample* current = trainingExamples[i].example;
         
         // Determine whether or not this example belongs to the left or right child node
         if (current->getDataPoint()->at(getFeatureID()) <= getThreshold())
         {
             // Left child node
-            leftHistogram.addOne(current->getClassLabel());
+            leftHistogram.add(current->getClassLabel(), trainingExamples[i].weight);
         }
         else
         {
             // Right child node
-            rightHistogram.addOne(current->getClassLabel());
+            rightHistogram.add(current->getClassLabel(), trainingExamples[i].weight);
+        }
+    }
+}
+
+void TrainingDAGNode::updateLeftRightHistogram(const char* _left)
+{
+    leftHistogram.reset();
+    rightHistogram.reset();
+    
+    for (size_t i = 0; i < trainingSetSize; i++)
+    {
+        if (_left[i])
+        {
+            leftHistogram.add(trainingExamples[i].example->getClassLabel(), trainingExamples[i].weight);
+        }
+        else
+        {
+            rightHistogram.add(trainingExamples[i].example->getClassLabel(), trainingExamples[i].weight);
         }
     }
 }
+
+void TrainingDAGNode::updateLeftRightHistogram(const Count* _binHistograms, int _lastBin)
+{
+    resetLeftRightHistogram();
+    
+    const int classCount = getClassHistogram()->size();
+    for (int b = 0; b <= _lastBin; b++)
+    {
+        const Count* bin = _binHistograms + b * classCount;
+        for (int c = 0; c < classCount; c++)
+        {
+            if (bin[c] != 0)
+            {
+                leftHistogram.add(c, bin[c]);
+                rightHistogram.sub(c, bin[c]);
+            }
+        }
+    }
+}
+
+int JungleRefitter::refit(Jungle::ptr _jungle, TrainingSet::ptr _trainingSet) throw(RuntimeException)
+{
+    // The new histograms need a bin for every class of the jungle and of the new data. All leaves get the same size, 
+    // otherwise the refitted jungle could neither be classified with nor merged
+    int classCount = _jungle->getClassCount();
+    for (TrainingSet::iterator iter = _trainingSet->begin(); iter != _trainingSet->end(); ++iter)
+    {
+        classCount = std::max(classCount, (*iter)->getClassLabel() + 1);
+    }
+    
+    // The DAGs are refitted independently of each other. The new histograms of every DAG are allocated in an arena 
+    // of its own. The old histograms stay in the arenas of the DAGs. 
+    std::vector<DAGNode::ptr> dags(_jungle->getDAGs().begin(), _jungle->getDAGs().end());
+    std::vector<MemoryArena::ptr> arenas(dags.size());
+    int leaves = 0;
+    int reachedLeafCount = 0;
+    
+    #pragma omp parallel for num_threads(getMaxParallel()) reduction(+:leaves, reachedLeafCount)
+    for (int d = 0; d < static_cast<int>(dags.size()); d++)
+    {
+        arenas[d] = MemoryArena::Factory::create(false);
+        reachedLeafCount += refitDAG(dags[d], _trainingSet, classCount, *arenas[d]);
+        
+        const int nodeCount = DAGNode::Factory::compactSize(dags[d]);
+        for (int i = 0; i < nodeCount; i++)
+        {
+            if (dags[d][i].getLeft() == 0) leaves++;
+        }
+    }
+    
+    _jungle->getArenas().insert(_jungle->getArenas().end(), arenas.begin(), arenas.end());
+    
+    leafCount = leaves;
+    return reachedLeafCount;
+}
+
+int JungleRefitter::refitDAG(DAGNode::ptr _root, TrainingSet::ptr _trainingSet, int _classCount, MemoryArena & _arena)
+{
+    // The nodes of a compact DAG are stored in one array, hence the leaves can be indexed by their positions
+    const int nodeCount = DAGNode::Factory::compactSize(_root);
+    std::vector<ClassHistogram*> oldHistograms(nodeCount, 0);
+    
+    // Swap in blank histograms. The routing only depends on the features and thresholds.
+    for (int i = 0; i < nodeCount; i++)
+    {
+        DAGNode::ptr node = _root + i;
+        if (node->getLeft() != 0) continue;
+        
+        oldHistograms[i] = node->getClassHistogram();
+        node->setClassHistogram(DAGNode::Factory::createClassHistogram(_classCount, _arena));
+    }
+    
+    // Count the new data at the leaves
+    for (TrainingSet::iterator iter = _trainingSet->begin(); iter != _trainingSet->end(); ++iter)
+    {
+        DAGNode::ptr leaf = _root + (_root->getLeafNode((*iter)->getDataPoint()) - _root);
+        leaf->getClassHistogram()->addOne((*iter)->getClassLabel());
+    }
+    
+    // Blend with the old counts and select the new class labels
+    int reachedLeafCount = 0;
+    for (int i = 0; i < nodeCount; i++)
+    {
+        DAGNode::ptr node = _root + i;
+        if (node->getLeft() != 0) continue;
+        
+        ClassHistogram* histogram = node->getClassHistogram();
+        if (histogram->getMass() == 0)
+        {
+            // The new data doesn't reach this leaf. It keeps its old counts in the resized histogram
+            if (oldHistograms[i] != 0)
+            {
+                oldHistograms[i]->forEach([histogram](int c, Count count) {
+                    histogram->add(c, count);
+                });
+            }
+            continue;
+        }
+        reachedLeafCount++;
+        
+        if (oldHistograms[i] != 0 && oldCountWeight > 0)
+        {
+            const float weight = oldCountWeight;
+            oldHistograms[i]->forEach([histogram, weight](int c, Count count) {
+                histogram->add(c, static_cast<Count>(count * weight + 0.5f));
+            });
+        }
+        
+        node->setClassLabel(TrainingUtil::histogramArgMax(*histogram));
+    }
+    
+    return reachedLeafCount;
+}
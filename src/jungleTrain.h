@@ -1,14 +1,17 @@
 #ifndef JUNGLE_TRAIN_H
 #define JUNGLE_TRAIN_H
 
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <random>
 #include <set>
 #include <string>
 #include <vector>
 #include <cmath>
 
 #include "jungle.h"
+#include "distributed.h"
 
 /**
  * This file contains everything that is important for training a jungle
@@ -137,9 +140,59 @@ namespace LibJungle {
              * @return The created training example
              */
             static TrainingExample::ptr createFromFileRow(const std::vector<std::string> & _row);
+            
+            /**
+             * Creates a new training example from a row from a data set that only keeps some feature columns
+             * 
+             * @param _row The vector of strings representing the training example
+             * @param _features The features to keep. The i-th feature of the example is the feature _features[i] of 
+             *                  the row
+             * @return The created training example
+             */
+            static TrainingExample::ptr createFromFileRow(const std::vector<std::string> & _row, const std::vector<int> & _features);
         };
     };
     
+    /**
+     * The type of row indices of the training set. Builds with wide counts use 64 bit indices.
+     */
+#if USE_WIDE_COUNTS
+    typedef unsigned long long RowIndex;
+#else
+    typedef unsigned int RowIndex;
+#endif
+    
+    /**
+     * An entry of the example index of a DAG. Bagging is expressed by the weights: a row that is drawn k times
+     * is stored once with weight k instead of being copied k times. 
+     */
+    struct WeightedExample {
+        /**
+         * The training example
+         */
+        TrainingExample::ptr example;
+        
+        /**
+         * The number of times the example was drawn
+         */
+        int weight;
+        
+        /**
+         * The row of the example in the training set
+         */
+        RowIndex row;
+    };
+    
+    /**
+     * An entry of a presorted feature column: the feature value of an example together with its class label and
+     * weight, so that a sweep over the column doesn't have to visit the examples
+     */
+    struct SortedExample {
+        float value;
+        int classLabel;
+        int weight;
+    };
+    
     /**
      * A training set consists of several training examples
      */
@@ -177,13 +230,16 @@ namespace LibJungle {
             }
             
             /**
-             * Creates a new training set by randomly samping n elements with replacement from the given set
+             * Draws n elements with replacement from the given set without copying them. Instead, the number of 
+             * times each element was drawn is stored in _weights. 
              * 
              * @param _trainingSet Given training set
              * @param n The number of samples to draw
-             * @return sampled set
+             * @param _weights The weight of every element of the training set
+             * @param _generator The random number generator
              */
-            static TrainingSet::ptr createBySampling(TrainingSet::ptr _trainingSet, int n);
+            static void sampleWeights(TrainingSet::ptr _trainingSet, Count n, std::vector<int> & _weights, 
+                    std::default_random_engine & _generator);
             
             /**
              * Loads a training set from a file
@@ -193,6 +249,293 @@ namespace LibJungle {
              * @return The loaded training set
              */
             static TrainingSet::ptr createFromFile(const std::string & _fileName, bool _verboseMode);
+            
+            /**
+             * Loads the class labels and some feature columns of a training set from a file
+             * 
+             * @param _fileName The filename
+             * @param _verboseMode
+             * @param _features The features to load. If empty, only the class labels are loaded
+             * @return The loaded training set
+             */
+            static TrainingSet::ptr createFromFile(const std::string & _fileName, bool _verboseMode, const std::vector<int> & _features);
+        };
+    };
+    
+    /**
+     * The feature columns of a training set that are not held by its training examples, e.g. because they are spread 
+     * over several processes or don't fit into memory. The training set then only holds the class labels. The 
+     * feature columns mirror the example index of the DAG trainer. A node is identified by the offset and the size of 
+     * its range in this index. 
+     */
+    class FeatureColumns {
+    public:
+        typedef FeatureColumns self;
+        typedef std::shared_ptr<self> ptr;
+        
+        /**
+         * The split of a parent node into its child nodes
+         */
+        struct Split {
+            size_t offset;
+            size_t size;
+            int left;
+            int right;
+        };
+        
+        /**
+         * The threshold search of a node, see findThresholds()
+         */
+        struct NodeSearch {
+            size_t offset;
+            size_t size;
+            std::vector<Count> leftBase;
+            std::vector<Count> rightBase;
+            float bestError;
+            int bestFeature;
+            float bestThreshold;
+            bool found;
+        };
+        
+        /**
+         * The partition of a node, see partition()
+         */
+        struct NodePartition {
+            size_t offset;
+            size_t size;
+            int feature;
+            float threshold;
+            char* left;
+        };
+        
+        virtual ~FeatureColumns() {}
+        
+        /**
+         * Returns the feature dimension of the training set. This is only valid after connect()
+         * 
+         * @return feature dimension
+         */
+        virtual int getFeatureDimension() const = 0;
+        
+        /**
+         * Prepares the feature columns for training
+         * 
+         * @param _rows The number of rows of the training set that holds the class labels
+         * @throws RuntimeException If the feature columns are not available or don't match the training set
+         */
+        virtual void connect(size_t _rows) throw(RuntimeException) = 0;
+        
+        /**
+         * Starts a new DAG
+         * 
+         * @param _weights The weight of every example of the training set. If empty, every example has weight 1
+         * @param _rows The number of examples of the training set
+         * @param _classCount The number of classes
+         * @param _criterion The split criterion
+         * @param _totalWeight The sum of all weights
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual void beginDAG(const std::vector<int> & _weights, size_t _rows, int _classCount, SplitCriterion _criterion, Count _totalWeight) throw(RuntimeException) = 0;
+        
+        /**
+         * Finds the best threshold of a node among the sampled features. Among equally good features, the one that
+         * was sampled first wins. 
+         * 
+         * @param _offset The offset of the node in the example index
+         * @param _size The number of examples of the node
+         * @param _features The sampled features
+         * @param _leftBase The left histogram base of the node
+         * @param _rightBase The right histogram base of the node
+         * @param _bestError The error to beat. It is updated if a better threshold is found
+         * @param _bestFeature The best feature is stored here
+         * @param _bestThreshold The best threshold is stored here
+         * @return true if a threshold with a smaller error was found
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual bool findThreshold(size_t _offset, size_t _size, const std::vector<int> & _features, const std::vector<Count> & _leftBase,
+                const std::vector<Count> & _rightBase, float & _bestError, int & _bestFeature, float & _bestThreshold) throw(RuntimeException) = 0;
+        
+        /**
+         * Determines which examples of a node go to the left child node
+         * 
+         * @param _offset The offset of the node in the example index
+         * @param _size The number of examples of the node
+         * @param _feature The feature of the node
+         * @param _threshold The threshold of the node
+         * @param _left Is set to 1 for every example that goes to the left child node and to 0 otherwise
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual void partition(size_t _offset, size_t _size, int _feature, float _threshold, char* _left) throw(RuntimeException) = 0;
+        
+        /**
+         * Returns whether or not findThresholds() searches all nodes at once. Only then, the DAG trainer searches the 
+         * nodes of an iteration against the same histograms instead of one after another. 
+         * 
+         * @return true if all nodes are searched at once
+         */
+        virtual bool searchesNodes() const
+        {
+            return false;
+        }
+        
+        /**
+         * Finds the best threshold of several nodes among the same sampled features. Every node is searched against 
+         * its own histogram bases. 
+         * 
+         * @param _features The sampled features
+         * @param _nodes The nodes. Their best error, feature and threshold are updated and found is set if a better 
+         * threshold was found
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual void findThresholds(const std::vector<int> & _features, std::vector<NodeSearch> & _nodes) throw(RuntimeException)
+        {
+            for (size_t i = 0; i < _nodes.size(); i++)
+            {
+                NodeSearch & node = _nodes[i];
+                node.found = findThreshold(node.offset, node.size, _features, node.leftBase, node.rightBase, 
+                        node.bestError, node.bestFeature, node.bestThreshold);
+            }
+        }
+        
+        /**
+         * Determines which examples of several nodes go to the left child nodes
+         * 
+         * @param _nodes The nodes
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual void partition(const std::vector<NodePartition> & _nodes) throw(RuntimeException)
+        {
+            for (size_t i = 0; i < _nodes.size(); i++)
+            {
+                partition(_nodes[i].offset, _nodes[i].size, _nodes[i].feature, _nodes[i].threshold, _nodes[i].left);
+            }
+        }
+        
+        /**
+         * Partitions the mirrored example index in the same way as the DAG trainer
+         * 
+         * @param _childCount The number of child nodes
+         * @param _parents The splits of the parent nodes in the order in which they are partitioned
+         * @param _left The partition of every example of the current example index
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual void split(int _childCount, const std::vector<Split> & _parents, const std::vector<char> & _left) throw(RuntimeException) = 0;
+        
+        /**
+         * Ends the current DAG
+         * 
+         * @throws RuntimeException If the feature columns are lost
+         */
+        virtual void endDAG() throw(RuntimeException) = 0;
+        
+        /**
+         * Releases the feature columns after training
+         */
+        virtual void close() = 0;
+    };
+    
+    /**
+     * The features of a training set quantized into a small number of bins. The bins of a feature are quantiles of 
+     * its values and never split equal values. The threshold between two bins lies in the middle of the adjacent 
+     * values, hence an example is in bin b if and only if its value is at most threshold b and greater than 
+     * threshold b-1. Every feature is stored as a column of bins, indexed by the row of the training set. 
+     */
+    class FeatureBins {
+    public:
+        typedef FeatureBins self;
+        typedef std::shared_ptr<self> ptr;
+        typedef unsigned char Bin;
+        
+    private:
+        /**
+         * The number of rows of the training set
+         */
+        size_t rows;
+        
+        /**
+         * The thresholds between the bins of every feature
+         */
+        std::vector< std::vector<float> > thresholds;
+        
+        /**
+         * The bin of every row, one column per feature
+         */
+        std::vector<Bin> bins;
+        
+        /**
+         * The class label of every row
+         */
+        std::vector<int> classLabels;
+        
+    public:
+        /**
+         * Returns the number of rows
+         * 
+         * @return number of rows
+         */
+        size_t getRows() const
+        {
+            return rows;
+        }
+        
+        /**
+         * Returns the number of bins of a feature
+         * 
+         * @param _feature The feature
+         * @return number of bins
+         */
+        int getBinCount(int _feature) const
+        {
+            return static_cast<int>(thresholds[_feature].size()) + 1;
+        }
+        
+        /**
+         * Returns the thresholds between the bins of a feature. There is one threshold less than bins
+         * 
+         * @param _feature The feature
+         * @return thresholds
+         */
+        const float* getThresholds(int _feature) const
+        {
+            return thresholds[_feature].data();
+        }
+        
+        /**
+         * Returns the bins of a feature
+         * 
+         * @param _feature The feature
+         * @return bin of every row
+         */
+        const Bin* getColumn(int _feature) const
+        {
+            return bins.data() + static_cast<size_t>(_feature) * rows;
+        }
+        
+        /**
+         * Returns the class labels. They are kept next to the bins, such that counting the bins doesn't have to 
+         * visit the training examples
+         * 
+         * @return class label of every row
+         */
+        const int* getClassLabels() const
+        {
+            return classLabels.data();
+        }
+        
+        /**
+         * Factory class for feature bins
+         */
+        class Factory {
+        public:
+            /**
+             * Quantizes all features of a training set
+             * 
+             * @param _trainingSet The training set
+             * @param _maxBins The maximum number of bins per feature. At most 256
+             * @param _threads The number of features that are quantized in parallel
+             * @return new feature bins
+             */
+            static FeatureBins::ptr create(TrainingSet::ptr _trainingSet, int _maxBins, int _threads);
         };
     };
     
@@ -203,9 +546,19 @@ namespace LibJungle {
     class TrainingDAGNode : public DAGNode {
     private:
         /**
-         * This is the list of training examples at this node
+         * The training examples at this node. This is a contiguous range of the example index of the trainer
          */
-        TrainingSet::ptr trainingSet;
+        WeightedExample* trainingExamples;
+        
+        /**
+         * The number of training examples at this node
+         */
+        size_t trainingSetSize;
+        
+        /**
+         * The class distribution at this node. During training, every node has a class histogram. 
+         */
+        ClassHistogram nodeHistogram;
         
         /**
          * This is the class distribution at the left child node if there were no other nodes linking to this
@@ -234,17 +587,42 @@ namespace LibJungle {
          */
         float entropy;
         
+        /**
+         * Temporary left node assignment. This is the index of the left child node in the next level
+         */
+        int tempLeft;
+        
+        /**
+         * Temporary right node assignment. This is the index of the right child node in the next level
+         */
+        int tempRight;
+        
     public:
         typedef TrainingDAGNode self;
         typedef self* ptr;
         
-        TrainingDAGNode() : DAGNode(), leftHistogram(), rightHistogram() {}
+        TrainingDAGNode() : DAGNode(), nodeHistogram(), leftHistogram(), rightHistogram() { setClassHistogram(&nodeHistogram); }
         
         /**
          * Computes the left and right histograms
          */
         void updateLeftRightHistogram();
         
+        /**
+         * Computes the left and right histograms from the bin histograms of the node's feature
+         * 
+         * @param _binHistograms The class histogram of every bin of the feature
+         * @param _lastBin The last bin that goes to the left child node
+         */
+        void updateLeftRightHistogram(const Count* _binHistograms, int _lastBin);
+        
+        /**
+         * Computes the left and right histograms from the partition of the node's training examples
+         * 
+         * @param _left The partition, see FeatureColumns::partition()
+         */
+        void updateLeftRightHistogram(const char* _left);
+        
         /**
          * Resets the left and right histograms
          */
@@ -254,16 +632,18 @@ namespace LibJungle {
          * Default constructor
          * @param _trainer The corresponding trainer instance
          */
-        TrainingDAGNode(DAGTrainerPtr _trainer) : trainer(_trainer) { }
+        TrainingDAGNode(DAGTrainerPtr _trainer) : trainer(_trainer) { setClassHistogram(&nodeHistogram); }
         
         /**
          * Copy constructor
          */
         TrainingDAGNode(const TrainingDAGNode& other) : 
-                trainingSet(other.trainingSet), 
+                trainingExamples(other.trainingExamples), 
+                trainingSetSize(other.trainingSetSize), 
+                nodeHistogram(other.nodeHistogram), 
                 leftHistogram(other.leftHistogram), 
                 rightHistogram(other.rightHistogram), 
-                pure(false) {}
+                pure(false) { setClassHistogram(&nodeHistogram); }
         
         /**
          * Assignment operator
@@ -273,7 +653,9 @@ namespace LibJungle {
             // Prevent self references
             if (this != &other)
             {
-                trainingSet = other.trainingSet;
+                trainingExamples = other.trainingExamples;
+                trainingSetSize = other.trainingSetSize;
+                nodeHistogram = other.nodeHistogram;
                 leftHistogram = other.leftHistogram;
                 rightHistogram = other.rightHistogram;
             }
@@ -282,9 +664,19 @@ namespace LibJungle {
         }
         
         /**
-         * Destructor
+         * Destructor. Training nodes live in the arena of their trainer and are never destroyed individually. 
+         */
+        ~TrainingDAGNode() {}
+        
+        /**
+         * Returns the trainer of this node
+         * 
+         * @return trainer
          */
-        virtual ~TrainingDAGNode() {}
+        DAGTrainerPtr getTrainer()
+        {
+            return trainer;
+        }
         
         /**
          * Selects the best class label and computes the class histogram based on the current training set
@@ -292,13 +684,45 @@ namespace LibJungle {
         void updateHistogramAndLabel();
         
         /**
-         * Returns the training set
+         * Returns the first training example at this node
+         * 
+         * @return pointer to the first training example
+         */
+        WeightedExample* getTrainingSetBegin()
+        {
+            return trainingExamples;
+        }
+        
+        /**
+         * Returns the end of the training examples at this node
+         * 
+         * @return pointer behind the last training example
+         */
+        WeightedExample* getTrainingSetEnd()
+        {
+            return trainingExamples + trainingSetSize;
+        }
+        
+        /**
+         * Returns the number of training examples at this node
+         * 
+         * @return training set size
+         */
+        size_t getTrainingSetSize() const
+        {
+            return trainingSetSize;
+        }
+        
+        /**
+         * Sets the training examples at this node
          * 
-         * @return the training set at this node
+         * @param _trainingExamples Pointer to the first example in the example index
+         * @param _trainingSetSize The number of examples
          */
-        TrainingSet::ptr getTrainingSet()
+        void setTrainingSet(WeightedExample* _trainingExamples, size_t _trainingSetSize)
         {
-            return trainingSet;
+            trainingExamples = _trainingExamples;
+            trainingSetSize = _trainingSetSize;
         }
         
         /**
@@ -339,12 +763,53 @@ namespace LibJungle {
             return entropy;
         }
         
+        /**
+         * Sets the temporary left assignment
+         * 
+         * @param _tempLeft New assignment
+         */
+        void setTempLeft(int _tempLeft)
+        {
+            tempLeft = _tempLeft;
+        }
+        
+        /**
+         * Returns the temporary left assignment
+         * 
+         * @return temporary left assignment
+         */
+        int getTempLeft()
+        {
+            return tempLeft;
+        }
+        
+        /**
+         * Sets the temporary right assignment
+         * 
+         * @param _tempRight New assignment
+         */
+        void setTempRight(int _tempRight)
+        {
+            tempRight = _tempRight;
+        }
+        
+        /**
+         * Returns the temporary right assignment
+         * 
+         * @return temporary right assignment
+         */
+        int getTempRight()
+        {
+            return tempRight;
+        }
+        
         /**
          * Finds an optimal threshold based on the provided error function
          * 
          * @param error An error function to measure the entropy of the current setting
          * @return true if the threshold was changed.
          */
+        template <int Bins, class Criterion>
         bool findThreshold(NodeRow & parentNodes);
         
         /**
@@ -353,8 +818,11 @@ namespace LibJungle {
          * @param error An error function to measure the entropy of the current setting
          * @return true if the assignment was changed.
          */
+        template <int Bins, class Criterion>
         bool findCoherentChildNodeAssignment(NodeRow & parentNodes, int childNodeCount);
+        template <int Bins, class Criterion>
         bool findLeftChildNodeAssignment(NodeRow & parentNodes, int childNodeCount);
+        template <int Bins, class Criterion>
         bool findRightChildNodeAssignment(NodeRow & parentNodes, int childNodeCount);
         
         /**
@@ -363,12 +831,30 @@ namespace LibJungle {
         class Factory : public DAGNode::Factory {
         public:
             /**
-             * Creates a new blank node for a trainer
+             * Creates a new blank node for a trainer. The node is allocated in the arena of the trainer. 
              */
             static TrainingDAGNode::ptr create(DAGTrainerPtr trainer);
         };
     };
     
+    /**
+     * Determines which nodes share a feature sample during threshold search
+     */
+    enum FeatureSampling {
+        /**
+         * Every node draws its own features whenever its threshold is searched
+         */
+        FeatureSamplingNode,
+        /**
+         * All nodes of a level share the features
+         */
+        FeatureSamplingLevel,
+        /**
+         * All nodes share the features within one LSearch iteration
+         */
+        FeatureSamplingIteration
+    };
+    
     /**
      * This class contains all the field a DAG and a jungle trainer have in common
      */
@@ -420,6 +906,31 @@ namespace LibJungle {
          */
         TrainingSet::ptr validationSet;
         
+        /**
+         * Whether or not the memory arenas of the DAGs shall be backed by huge pages
+         */
+        bool useHugePages;
+        
+        /**
+         * The criterion that is minimized when a level is trained
+         */
+        SplitCriterion splitCriterion;
+        
+        /**
+         * Which nodes share the sampled features
+         */
+        FeatureSampling featureSampling;
+        
+        /**
+         * Training is cut short when this point in time is reached
+         */
+        std::chrono::steady_clock::time_point deadline;
+        
+        /**
+         * The seed of the random number generators. -1 means that the seed is drawn from std::random_device
+         */
+        int seed;
+        
     protected:
         /**
          * Validates all parameters and throws an exception if some parameters are invalid
@@ -482,6 +993,117 @@ namespace LibJungle {
             return validationSet;
         }
         
+        /**
+         * Sets useHugePages
+         * 
+         * @param _useHugePages
+         */
+        void setUseHugePages(bool _useHugePages)
+        {
+            useHugePages = _useHugePages;
+        }
+        
+        /**
+         * Returns useHugePages
+         * 
+         * @return useHugePages
+         */
+        bool getUseHugePages()
+        {
+            return useHugePages;
+        }
+        
+        /**
+         * Sets splitCriterion
+         * 
+         * @param _splitCriterion
+         */
+        void setSplitCriterion(SplitCriterion _splitCriterion)
+        {
+            splitCriterion = _splitCriterion;
+        }
+        
+        /**
+         * Returns splitCriterion
+         * 
+         * @return splitCriterion
+         */
+        SplitCriterion getSplitCriterion()
+        {
+            return splitCriterion;
+        }
+        
+        /**
+         * Sets featureSampling. With shared features, the feature columns are sorted once for all nodes. 
+         * 
+         * @param _featureSampling
+         */
+        void setFeatureSampling(FeatureSampling _featureSampling)
+        {
+            featureSampling = _featureSampling;
+        }
+        
+        /**
+         * Returns featureSampling
+         * 
+         * @return featureSampling
+         */
+        FeatureSampling getFeatureSampling()
+        {
+            return featureSampling;
+        }
+        
+        /**
+         * Sets the deadline. No new DAGs and levels are started after the deadline
+         * 
+         * @param _deadline
+         */
+        void setDeadline(std::chrono::steady_clock::time_point _deadline)
+        {
+            deadline = _deadline;
+        }
+        
+        /**
+         * Returns the deadline
+         * 
+         * @return deadline
+         */
+        std::chrono::steady_clock::time_point getDeadline() const
+        {
+            return deadline;
+        }
+        
+        /**
+         * Sets the seed of the random number generators. -1 means that the seed is drawn from std::random_device.
+         * The DAGs of a jungle use the seeds seed, seed + 1, ...
+         * 
+         * @param _seed
+         */
+        void setSeed(int _seed)
+        {
+            seed = _seed;
+        }
+        
+        /**
+         * Returns the seed
+         * 
+         * @return seed
+         */
+        int getSeed() const
+        {
+            return seed;
+        }
+        
+        /**
+         * Returns true if the deadline has been reached
+         * 
+         * @return true if there is no time left
+         */
+        bool deadlineReached() const
+        {
+            return std::chrono::steady_clock::now() >= deadline;
+        }
+        
         /**
          * Sets useBagging
          * 
@@ -648,6 +1270,164 @@ namespace LibJungle {
          */
         int classCount;
         
+        /**
+         * The number of times every example of the training set is used. If empty, every example is used once. 
+         * Examples with weight 0 are not part of the example index. 
+         */
+        std::vector<int> exampleWeights;
+        
+        /**
+         * The training examples of all nodes of the current level. Every node holds a contiguous range of this index.
+         */
+        std::vector<WeightedExample> exampleIndex;
+        
+        /**
+         * The examples are partitioned from the example index into this buffer when a level is split. Both 
+         * buffers are swapped afterwards. 
+         */
+        std::vector<WeightedExample> exampleIndexBuffer;
+        
+        /**
+         * The number of examples per child node, used while partitioning a level
+         */
+        std::vector<size_t> childExampleCounts;
+        
+        /**
+         * A block of the examples of a parent node. The blocks are partitioned in parallel, every block writes its 
+         * examples to its own ranges of the child nodes. If both children are the same node, all examples are in 
+         * the left range
+         */
+        struct PartitionBlock {
+            size_t parent;
+            WeightedExample* begin;
+            size_t size;
+            size_t leftCount;
+            size_t leftOffset;
+            size_t rightOffset;
+        };
+        std::vector<PartitionBlock> partitionBlocks;
+        
+        /**
+         * The number of threads that partition a level and compute the histograms of the child nodes
+         */
+        int threads;
+        
+        /**
+         * If set, the feature columns are held here instead of by the training set
+         */
+        FeatureColumns::ptr featureColumns;
+        
+        /**
+         * The partition of every entry of the example index as reported by the feature columns. 1 means that the 
+         * example goes to the left child node
+         */
+        std::vector<char> partitionLeft;
+        
+        /**
+         * The features that are shared by all nodes of the current level or iteration
+         */
+        std::vector<int> sharedFeatures;
+        
+        /**
+         * The presorted column of every shared feature. The examples of a node occupy the same range as in the 
+         * example index and are sorted by the feature value
+         */
+        std::vector< std::vector<SortedExample> > sharedColumns;
+        
+        /**
+         * The node of every position of the example index and the (value, position) pairs of a column while the 
+         * shared columns are sorted
+         */
+        std::vector<int> positionNode;
+        std::vector< std::pair<float, size_t> > columnOrder;
+        
+        /**
+         * If set, the thresholds are searched on the class histograms of the binned features instead of on sorted 
+         * examples
+         */
+        FeatureBins::ptr featureBins;
+        
+        /**
+         * An example whose bins are counted: its row, class label and weight and the histogram slot of its node
+         */
+        struct BinnedExample {
+            RowIndex row;
+            int classLabel;
+            int weight;
+            int slot;
+        };
+        std::vector<BinnedExample> binnedExamples;
+        
+        /**
+         * The class histograms of the bins of the sampled features. Every node that searches a threshold has a slot 
+         * that holds the histograms of all sampled features, bin after bin
+         */
+        std::vector<Count> binHistograms;
+        
+        /**
+         * The offset of the histograms of every sampled feature within a slot. The last entry is the slot size
+         */
+        std::vector<size_t> binOffsets;
+        
+        /**
+         * The slot of every node of the level or -1 if the node does not search a threshold
+         */
+        std::vector<int> binSlots;
+        
+        /**
+         * The split of a parent node into the ranges of its examples in the child nodes. If both children are the 
+         * same node, all examples are in the left range
+         */
+        struct BinSplit {
+            int slot;
+            TrainingDAGNode* left;
+            TrainingDAGNode* right;
+            size_t leftOffset;
+            size_t leftSize;
+            size_t rightOffset;
+            size_t rightSize;
+        };
+        
+        /**
+         * The splits of the last level together with its shared features and their bin histograms. The histograms 
+         * of the features that are sampled again are derived from them
+         */
+        std::vector<BinSplit> binSplits;
+        std::vector<int> splitFeatures;
+        std::vector<size_t> splitBinOffsets;
+        std::vector<Count> splitBinHistograms;
+        
+        /**
+         * The bin histograms of the smaller child nodes while the histograms of a level are derived
+         */
+        std::vector<Count> smallerBinHistograms;
+        
+        /**
+         * All nodes and their histograms are allocated in this arena. After training, it holds the compact DAG
+         */
+        MemoryArena::ptr arena;
+        
+        /**
+         * The n log2(n) table for the entropy updates during threshold search
+         */
+        NLogNTable::ptr nlognTable;
+        
+        /**
+         * The number of compile-time histogram bins or 0 if the histograms are sized at run time. This value is set
+         * by train()
+         */
+        int histogramBins;
+        
+        /**
+         * True if the deadline was reached before the DAG was fully grown
+         */
+        bool interrupted;
+        
+        /**
+         * The random number generator for the feature sampling
+         */
+        std::default_random_engine generator;
+        
         /**
          * Validates all parameters and throws an exception is some parameters are invalid
          * 
@@ -655,6 +1435,76 @@ namespace LibJungle {
          */
         void validateParameters() throw(ConfigurationException);
         
+        /**
+         * Draws getNumFeatureSamples() features with replacement
+         * 
+         * @param _features The drawn features are appended to this list
+         */
+        void drawFeatures(std::vector<int> & _features);
+        
+        /**
+         * Draws the shared features and sorts their columns. Every column is sorted in one pass over all examples of 
+         * the level and distributed to the nodes afterwards. 
+         * 
+         * @param parentNodes The nodes of the level
+         */
+        void sampleSharedFeatures(NodeRow & parentNodes);
+        
+        /**
+         * Computes the offsets of the bin histograms of the given features within a slot
+         * 
+         * @param _features The sampled features
+         */
+        void setBinOffsets(const std::vector<int> & _features);
+        
+        /**
+         * Adds the binned examples to the bin histograms of their slots. The features are processed in blocks whose 
+         * histograms fit into the cache and every block is a single pass over the examples. 
+         * 
+         * @param _features The features to count
+         * @param _offsets The offset of the histograms of every feature within a slot
+         * @param _slotSize The size of a slot
+         * @param _histograms The slots
+         */
+        void countBins(const std::vector<int> & _features, const std::vector<size_t> & _offsets, size_t _slotSize, Count* _histograms);
+        
+        /**
+         * Counts the bins of the shared features for all nodes of a level at once
+         * 
+         * @param parentNodes The nodes of the level
+         */
+        void countLevelBins(NodeRow & parentNodes);
+        
+        /**
+         * Derives the bin histograms of the features that were already shared by the last level. Only the smaller 
+         * child of a split parent is counted, the larger one is the difference to the histogram of the parent. This 
+         * is skipped for parents whose examples are cheaper to count than their histograms. A child with several 
+         * parents receives the sum of their contributions. 
+         * 
+         * @param parentNodes The nodes of the level
+         * @param _features The positions of the features in the list of shared features
+         * @param _splitFeatures The positions of the features in the list of shared features of the last level
+         */
+        void deriveLevelBins(NodeRow & parentNodes, const std::vector<size_t> & _features, const std::vector<size_t> & _splitFeatures);
+        
+        /**
+         * Updates the left and right histograms of nodes. The feature columns partition all nodes at once. 
+         * 
+         * @param _nodes The nodes
+         */
+        void updateLeftRightHistograms(NodeRow & _nodes);
+        
+        /**
+         * Finds the thresholds of all nodes of a level at once among the shared features. This requires feature 
+         * columns that search all nodes at once. Every node is searched against the histograms of the other nodes 
+         * at the beginning of the call, hence every column is read once instead of once per node. 
+         * 
+         * @param parentNodes The nodes of the level
+         * @return true if a threshold changed
+         */
+        template <int Bins, class Criterion>
+        bool findThresholds(NodeRow & parentNodes);
+        
         /**
          * Trains a single level of the DAG
          * 
@@ -663,6 +1513,25 @@ namespace LibJungle {
          */
         NodeRow trainLevel(NodeRow &parentNodes, int childNodeCount);
         
+        /**
+         * Trains a single level of the DAG using a certain split criterion
+         * 
+         * @param parentNodes The set of parent nodes
+         * @param childNodeCount The number of child nodes
+         */
+        template <class Criterion>
+        NodeRow trainLevel(NodeRow &parentNodes, int childNodeCount);
+        
+        /**
+         * Trains a single level of the DAG using a certain split criterion and histograms with Bins compile-time 
+         * bins
+         * 
+         * @param parentNodes The set of parent nodes
+         * @param childNodeCount The number of child nodes
+         */
+        template <int Bins, class Criterion>
+        NodeRow trainLevel(NodeRow &parentNodes, int childNodeCount);
+        
     public:
         typedef DAGTrainer self;
         typedef self* ptr;
@@ -690,140 +1559,815 @@ namespace LibJungle {
         }
         
         /**
-         * Returns a list of sampled features
+         * Returns the memory arena that holds the nodes of the DAG
          * 
-         * @return List of sampled features
+         * @return memory arena
          */
-        void getSampledFeatures(std::vector<int> & sampledFeature);
+        MemoryArena::ptr getArena()
+        {
+            return arena;
+        }
         
         /**
-         * Trains the DAG
+         * Returns the number of compile-time histogram bins. 0 means that the histograms are sized at run time.
          * 
-         * @throws ConfigurationException If the configuration is invalid
-         * @throws RuntimeException If training fails unexpectedly
+         * @return number of histogram bins
          */
-        TrainingDAGNode::ptr train() throw(ConfigurationException, RuntimeException);
+        int getHistogramBins()
+        {
+            return histogramBins;
+        }
         
         /**
-         * Factory class for the trainer
+         * Returns true if the last call of train() was cut short by the deadline. The DAG then ends at the last
+         * finished level.
+         * 
+         * @return true if the DAG was interrupted
          */
-        class Factory : public AbstractTrainer::Factory {
-        private:
-            
-        public:
-            /**
-             * Creates a new DAG trainer for a specific training set
-             * 
-             * @param _trainingSet the set to train on
-             * @return new trainer instance
-             */
-            static DAGTrainer::ptr createForTraingSet(TrainingSet::ptr _trainingSet)
-            {
-                DAGTrainer::ptr trainer = new DAGTrainer();
-                trainer->trainingSet = _trainingSet;
-                
-                // Initialize the trainer with the default parameters
-                init(trainer);
-                
-                return trainer;
-            }
-            
-            /**
-             * Creates a new DAG trainer from the settings of a jungle trainer
-             * 
-             * @param _jungleTrainer The jungle trainer
-             * @param _trainingSet The set to train on
-             * @return new trainer instance
-             */
-            static DAGTrainer::ptr createFromJungleTrainer(JungleTrainerPtr _jungleTrainer, TrainingSet::ptr _trainingSet);
-        };
-    };
-    
-    /**
-     * This is a trainer for decision jungles
-     */
-    class JungleTrainer : public AbstractTrainer {
-    private:
+        bool isInterrupted() const
+        {
+            return interrupted;
+        }
+        
         /**
-         * Number of DAGs to train
+         * Returns the n log2(n) table. This is only valid during training. 
+         * 
+         * @return n log2(n) table
          */
-        int numDAGs;
+        const NLogNTable & getNLogNTable()
+        {
+            return *nlognTable;
+        }
         
         /**
-         * Number of training samples per DAG
+         * Sets the feature columns. The training set then only has to hold the class labels. 
+         * 
+         * @param _featureColumns
          */
-        int numTrainingSamples;
+        void setFeatureColumns(FeatureColumns::ptr _featureColumns)
+        {
+            featureColumns = _featureColumns;
+        }
         
         /**
-         * Maximum number of DAGs to train in parallel
+         * Returns the feature columns
+         * 
+         * @return feature columns
          */
-        int maxParallel;
-    public:
-        
-        typedef JungleTrainer self;
-        typedef self* ptr;
+        FeatureColumns::ptr getFeatureColumns()
+        {
+            return featureColumns;
+        }
+        
+        /**
+         * Sets the binned features. They must belong to the training set of the trainer
+         * 
+         * @param _featureBins
+         */
+        void setFeatureBins(FeatureBins::ptr _featureBins)
+        {
+            featureBins = _featureBins;
+        }
+        
+        /**
+         * Returns the binned features
+         * 
+         * @return binned features
+         */
+        FeatureBins::ptr getFeatureBins()
+        {
+            return featureBins;
+        }
+        
+        /**
+         * Sets the number of threads that partition a level. Inside another parallel region, e.g. if several DAGs 
+         * are trained at once, the threads are only started if nested parallelism is enabled (OMP_MAX_ACTIVE_LEVELS). 
+         * Otherwise the level is partitioned by the calling thread
+         * 
+         * @param _threads
+         */
+        void setThreads(int _threads)
+        {
+            threads = _threads;
+        }
+        
+        /**
+         * Returns the number of threads that partition a level
+         * 
+         * @return number of threads
+         */
+        int getThreads() const
+        {
+            return threads;
+        }
+        
+        /**
+         * Returns the bin histograms of a node. With shared feature sampling, they were counted for the whole level. 
+         * Otherwise, they are counted for the given features. 
+         * 
+         * @param _examples The training examples of the node
+         * @param _size The number of training examples
+         * @param _features The sampled features
+         * @return bin histograms, see getBinOffset()
+         */
+        const Count* getBinHistograms(const WeightedExample* _examples, size_t _size, const std::vector<int> & _features);
+        
+        /**
+         * Returns the offset of the bin histograms of a sampled feature within the histograms of a node
+         * 
+         * @param _index The position of the feature in the list of sampled features
+         * @return offset of the bin histograms
+         */
+        size_t getBinOffset(size_t _index)
+        {
+            return binOffsets[_index];
+        }
+        
+        /**
+         * Returns the position of a node's training examples in the example index
+         * 
+         * @param _examples The first training example of the node
+         * @return offset in the example index
+         */
+        size_t getExampleOffset(const WeightedExample* _examples)
+        {
+            return static_cast<size_t>(_examples - exampleIndex.data());
+        }
+        
+        /**
+         * Returns the partition of a node's training examples. This is only valid with feature columns. 
+         * 
+         * @param _examples The first training example of the node
+         * @return partition of the training examples
+         */
+        char* getPartition(const WeightedExample* _examples)
+        {
+            return partitionLeft.data() + getExampleOffset(_examples);
+        }
+        
+        /**
+         * Returns the example weights. The weights can be set before training in order to train on a bootstrap 
+         * sample of the training set. 
+         * 
+         * @return example weights
+         */
+        std::vector<int> & getExampleWeights()
+        {
+            return exampleWeights;
+        }
+        
+        /**
+         * Returns a list of sampled features. With shared feature sampling, these are the shared features. 
+         * 
+         * @return List of sampled features
+         */
+        void getSampledFeatures(std::vector<int> & sampledFeature);
+        
+        /**
+         * Returns the presorted column of a shared feature. This is only valid with shared feature sampling and 
+         * without feature columns. 
+         * 
+         * @param _index The position of the feature in the list of sampled features
+         * @return presorted column, indexed like the example index
+         */
+        const SortedExample* getSharedColumn(size_t _index)
+        {
+            return sharedColumns[_index].data();
+        }
+        
+        /**
+         * Trains the DAG. The trained DAG is returned in its compact representation and all training state is 
+         * released. The returned DAG lives in the arena that is returned by getArena(). 
+         * 
+         * @throws ConfigurationException If the configuration is invalid
+         * @throws RuntimeException If training fails unexpectedly
+         */
+        DAGNode::ptr train() throw(ConfigurationException, RuntimeException);
+        
+        /**
+         * Factory class for the trainer
+         */
+        class Factory : public AbstractTrainer::Factory {
+        private:
+            
+        public:
+            /**
+             * Creates a new DAG trainer for a specific training set
+             * 
+             * @param _trainingSet the set to train on
+             * @return new trainer instance
+             */
+            static DAGTrainer::ptr createForTraingSet(TrainingSet::ptr _trainingSet)
+            {
+                DAGTrainer::ptr trainer = new DAGTrainer();
+                trainer->trainingSet = _trainingSet;
+                trainer->histogramBins = 0;
+                trainer->interrupted = false;
+                trainer->threads = 1;
+                
+                // Initialize the trainer with the default parameters
+                init(trainer);
+                
+                return trainer;
+            }
+            
+            /**
+             * Creates a new DAG trainer from the settings of a jungle trainer
+             * 
+             * @param _jungleTrainer The jungle trainer
+             * @param _trainingSet The set to train on
+             * @return new trainer instance
+             */
+            static DAGTrainer::ptr createFromJungleTrainer(JungleTrainerPtr _jungleTrainer, TrainingSet::ptr _trainingSet);
+        };
+    };
+    
+    /**
+     * Estimates the generalization error of a bagged jungle from the training set alone. Every DAG votes for the 
+     * examples that were not drawn for its training (out-of-bag examples). The votes are accumulated as the DAGs are 
+     * completed and combined in the same way as Jungle::predict(). On a validation set, every DAG votes for all
+     * examples. 
+     */
+    class OutOfBagEstimate {
+    private:
+        /**
+         * The training set of the jungle
+         */
+        TrainingSet::ptr trainingSet;
+        
+        /**
+         * The number of classes
+         */
+        int classCount;
+        
+        /**
+         * The out-of-bag votes for every training example
+         */
+        std::vector<ClassHistogram> votes;
+        
+        /**
+         * The number of examples that got at least one vote
+         */
+        RowIndex coverage;
+        
+        /**
+         * The number of covered examples that are currently misclassified
+         */
+        RowIndex errors;
+        
+        /**
+         * Returns the predicted class label of an example or -1 if it did not get any votes
+         */
+        ClassLabel predict(size_t i) const;
+        
+        /**
+         * Adds the votes of a DAG for all examples that are not in its bag
+         * 
+         * @param _dag The trained DAG
+         * @param _weights The example weights or 0 if the DAG has not seen any of the examples
+         */
+        void addVotes(const DAGNode* _dag, const std::vector<int>* _weights);
+        
+    public:
+        typedef OutOfBagEstimate self;
+        typedef std::shared_ptr<self> ptr;
+        
+        /**
+         * Adds the votes of a trained DAG. Only the examples with weight 0 are classified. This function may be 
+         * called concurrently. 
+         * 
+         * @param _dag The trained DAG
+         * @param _weights The example weights the DAG was trained with
+         */
+        void addDAG(const DAGNode* _dag, const std::vector<int> & _weights);
+        
+        /**
+         * Adds the votes of a DAG that has not seen any of the examples, e.g. if the examples form a validation set
+         * 
+         * @param _dag The trained DAG
+         */
+        void addDAG(const DAGNode* _dag);
+        
+        /**
+         * Returns the out-of-bag error over all examples that got at least one vote. The error is maintained while
+         * the votes are added. 
+         * 
+         * @return out-of-bag error
+         */
+        float error() const;
+        
+        /**
+         * Returns the number of examples that got at least one vote
+         * 
+         * @return number of covered examples
+         */
+        RowIndex getCoverage() const;
+        
+        /**
+         * Returns the out-of-bag confusion matrix. The rows correspond to the true class labels and the columns to 
+         * the predicted ones. 
+         * 
+         * @return confusion matrix
+         */
+        Matrix confusionMatrix() const;
+        
+        /**
+         * A factory for this class
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new estimate without any votes
+             * 
+             * @param _trainingSet The training set of the jungle
+             * @return new estimate
+             */
+            static OutOfBagEstimate::ptr create(TrainingSet::ptr _trainingSet);
+        };
+    };
+    
+    /**
+     * This is a trainer for decision jungles
+     */
+    class JungleTrainer : public AbstractTrainer {
+    private:
+        /**
+         * Number of DAGs to train
+         */
+        int numDAGs;
+        
+        /**
+         * Number of training samples per DAG
+         */
+        Count numTrainingSamples;
+        
+        /**
+         * Maximum number of DAGs to train in parallel
+         */
+        int maxParallel;
+        
+        /**
+         * 0: No out-of-bag estimation, 1: Out-of-bag error, 2: Out-of-bag error and confusion matrix
+         */
+        int outOfBagLevel;
+        
+        /**
+         * The out-of-bag estimate of the last training run
+         */
+        OutOfBagEstimate::ptr outOfBagEstimate;
+        
+        /**
+         * The number of DAGs over which the error must improve. 0 disables early stopping
+         */
+        int earlyStoppingWindow;
+        
+        /**
+         * The minimum improvement of the error over the window
+         */
+        float earlyStoppingTolerance;
+        
+        /**
+         * The training time budget in seconds. 0 means unlimited
+         */
+        float timeBudget;
+        
+        /**
+         * Whether or not DAGs that are interrupted by the time budget are added to the jungle
+         */
+        bool keepInterruptedDAGs;
+        
+        /**
+         * Every DAG that is added to the jungle is appended to this file. Empty if there is no checkpoint file
+         */
+        std::string checkpointFileName;
+        
+        /**
+         * Whether or not training continues from the DAGs in the checkpoint file
+         */
+        bool resume;
+        
+        /**
+         * Whether or not the trained DAGs are kept in memory. If not, they are only written to the checkpoint file
+         */
+        bool keepDAGs;
+        
+        /**
+         * The DAGs of this jungle are part of the trained jungle. Only the remaining DAGs are trained
+         */
+        Jungle::ptr initialJungle;
+        
+        /**
+         * Without a seed, the seeds of the DAGs continue from this random seed. It is drawn once per training run, 
+         * such that the bagging weights of a DAG can be derived again from its index
+         */
+        unsigned int randomSeed;
+        
+        /**
+         * Loads all complete DAGs from the checkpoint file into the jungle. An incomplete block at the end of the 
+         * file, e.g. after a crash while writing, is removed from the file. The DAGs are completed out of order if 
+         * several of them are trained in parallel, hence every block records the index of its DAG. Blocks without 
+         * an index take the lowest free indices. 
+         * 
+         * @param _jungle The jungle to add the DAGs to. If empty, the DAGs are only counted
+         * @param _indices Receives the indices of the loaded DAGs
+         * @return The number of loaded DAGs
+         * @throws RuntimeException If the checkpoint file cannot be rewritten
+         */
+        int loadCheckpoint(Jungle::ptr _jungle, std::set<int> & _indices) throw(RuntimeException);
+        
+        /**
+         * If set, the DAGs are handed out to the workers of this coordinator instead of being trained locally
+         */
+        Coordinator::ptr coordinator;
+        
+        /**
+         * If set, the feature columns are held here instead of by the training set
+         */
+        FeatureColumns::ptr featureColumns;
+        
+        /**
+         * The maximum number of bins per feature. 0 disables binning
+         */
+        int featureBinCount;
+        
+        /**
+         * The binned features of the training set. They are shared by all DAG trainers
+         */
+        FeatureBins::ptr featureBins;
+        
+        /**
+         * The state of a training run that is updated as the DAGs are completed
+         */
+        struct TrainingProgress {
+            Jungle::ptr jungle;
+            TrainingSet::ptr trainingSet;
+            ModelWriter::ptr checkpoint;
+            OutOfBagEstimate::ptr stoppingEstimate;
+            std::vector<float> errorHistory;
+            bool stopped;
+            int keptDAGs;
+        };
+        
+        /**
+         * Adds a completed DAG to the jungle, the out-of-bag and early stopping estimates and the checkpoint file
+         * 
+         * @param _progress The state of the training run
+         * @param _index The index of the DAG
+         * @param _dag The compact root node of the DAG
+         * @param _arena The arena that holds the DAG
+         * @param _interrupted Whether or not the DAG was interrupted by the time budget
+         * @param _weights The bagging weights of the DAG
+         */
+        void addTrainedDAG(TrainingProgress & _progress, int _index, DAGNode::ptr _dag, MemoryArena::ptr _arena, 
+                bool _interrupted, const std::vector<int> & _weights) throw(RuntimeException);
+        
+    public:
+        
+        typedef JungleTrainer self;
+        typedef self* ptr;
         
         virtual ~JungleTrainer() {}
         
         /**
-         * Sets the number of training samples per DAG
-         * -1: The number is determined based on the training set
+         * Sets the number of training samples per DAG
+         * -1: The number is determined based on the training set
+         * 
+         * @param _numTrainingSamples 
+         */
+        void setNumTrainingSamples(Count _numTrainingSamples)
+        {
+            numTrainingSamples = _numTrainingSamples;
+        }
+        
+        /**
+         * Returns the number of training samples per DAG
+         * 
+         * @return Number of training samples per DAG
+         */
+        Count getNumTrainingSamples()
+        {
+            return numTrainingSamples;
+        }
+        
+        /**
+         * Sets the number of dags to train
+         * 
+         * @param _numDAGs
+         */
+        void setNumDAGs(int _numDAGs)
+        {
+            numDAGs = _numDAGs;
+        }
+        
+        /**
+         * Returns the number of DAGs to train
+         * 
+         * @return number of dags to train
+         */
+        int getNumDAGs()
+        {
+            return numDAGs;
+        }
+        
+        /**
+         * Sets maxParallel
+         * 
+         * @param _maxParallel
+         */
+        void setMaxParallel(int _maxParallel)
+        {
+            maxParallel = _maxParallel;
+        }
+        
+        /**
+         * Returns maxParallel
+         * 
+         * @return maxParallel
+         */
+        int getMaxParallel() const 
+        {
+            return maxParallel;
+        }
+        
+        /**
+         * Sets the out-of-bag level. The estimation requires bagging. 
+         * 0: No out-of-bag estimation, 1: Out-of-bag error, 2: Out-of-bag error and confusion matrix
+         * 
+         * @param _outOfBagLevel
+         */
+        void setOutOfBagLevel(int _outOfBagLevel)
+        {
+            outOfBagLevel = _outOfBagLevel;
+        }
+        
+        /**
+         * Returns the out-of-bag level
+         * 
+         * @return out-of-bag level
+         */
+        int getOutOfBagLevel() const
+        {
+            return outOfBagLevel;
+        }
+        
+        /**
+         * Sets the early stopping window. If the error does not improve by at least the tolerance over this many 
+         * DAGs, no further DAGs are trained. The error is the error on the validation set or, if there is none, 
+         * the out-of-bag error. 0 disables early stopping. 
+         * 
+         * @param _earlyStoppingWindow
+         */
+        void setEarlyStoppingWindow(int _earlyStoppingWindow)
+        {
+            earlyStoppingWindow = _earlyStoppingWindow;
+        }
+        
+        /**
+         * Returns the early stopping window
+         * 
+         * @return early stopping window
+         */
+        int getEarlyStoppingWindow() const
+        {
+            return earlyStoppingWindow;
+        }
+        
+        /**
+         * Sets the minimum improvement of the error over the early stopping window
+         * 
+         * @param _earlyStoppingTolerance
+         */
+        void setEarlyStoppingTolerance(float _earlyStoppingTolerance)
+        {
+            earlyStoppingTolerance = _earlyStoppingTolerance;
+        }
+        
+        /**
+         * Returns the minimum improvement of the error over the early stopping window
+         * 
+         * @return early stopping tolerance
+         */
+        float getEarlyStoppingTolerance() const
+        {
+            return earlyStoppingTolerance;
+        }
+        
+        /**
+         * Sets the training time budget in seconds. When the time is up, no new DAGs are started and the running
+         * DAGs stop after their current level. 0 means unlimited. 
+         * 
+         * @param _timeBudget
+         */
+        void setTimeBudget(float _timeBudget)
+        {
+            timeBudget = _timeBudget;
+        }
+        
+        /**
+         * Returns the training time budget in seconds
+         * 
+         * @return time budget
+         */
+        float getTimeBudget() const
+        {
+            return timeBudget;
+        }
+        
+        /**
+         * Sets whether or not DAGs that are interrupted by the time budget are added to the jungle. If no DAG was 
+         * completed, the first interrupted DAG is always added. 
+         * 
+         * @param _keepInterruptedDAGs
+         */
+        void setKeepInterruptedDAGs(bool _keepInterruptedDAGs)
+        {
+            keepInterruptedDAGs = _keepInterruptedDAGs;
+        }
+        
+        /**
+         * Returns whether or not DAGs that are interrupted by the time budget are added to the jungle
+         * 
+         * @return keepInterruptedDAGs
+         */
+        bool getKeepInterruptedDAGs() const
+        {
+            return keepInterruptedDAGs;
+        }
+        
+        /**
+         * Sets the checkpoint file. Every DAG that is added to the jungle is appended to it. An empty name disables
+         * checkpointing. 
+         * 
+         * @param _checkpointFileName
+         */
+        void setCheckpointFileName(const std::string & _checkpointFileName)
+        {
+            checkpointFileName = _checkpointFileName;
+        }
+        
+        /**
+         * Returns the checkpoint file name
+         * 
+         * @return checkpoint file name
+         */
+        const std::string & getCheckpointFileName() const
+        {
+            return checkpointFileName;
+        }
+        
+        /**
+         * Sets whether or not training continues from the DAGs in the checkpoint file. Only the remaining DAGs are
+         * trained. 
+         * 
+         * @param _resume
+         */
+        void setResume(bool _resume)
+        {
+            resume = _resume;
+        }
+        
+        /**
+         * Returns whether or not training continues from the checkpoint file
+         * 
+         * @return resume
+         */
+        bool getResume() const
+        {
+            return resume;
+        }
+        
+        /**
+         * Sets whether or not the trained DAGs are kept in memory. If not, every DAG is released as soon as it is 
+         * written to the checkpoint file and the returned jungle is empty. 
+         * 
+         * @param _keepDAGs
+         */
+        void setKeepDAGs(bool _keepDAGs)
+        {
+            keepDAGs = _keepDAGs;
+        }
+        
+        /**
+         * Returns whether or not the trained DAGs are kept in memory
+         * 
+         * @return keepDAGs
+         */
+        bool getKeepDAGs() const
+        {
+            return keepDAGs;
+        }
+        
+        /**
+         * Sets an initial jungle. Its DAGs become part of the trained jungle and only the remaining DAGs up to the
+         * number of DAGs are trained (warm start). 
+         * 
+         * @param _initialJungle
+         */
+        void setInitialJungle(Jungle::ptr _initialJungle)
+        {
+            initialJungle = _initialJungle;
+        }
+        
+        /**
+         * Returns the initial jungle
+         * 
+         * @return initial jungle
+         */
+        Jungle::ptr getInitialJungle()
+        {
+            return initialJungle;
+        }
+        
+        /**
+         * Sets a coordinator. The DAGs are then trained by its workers instead of locally. 
+         * 
+         * @param _coordinator
+         */
+        void setCoordinator(Coordinator::ptr _coordinator)
+        {
+            coordinator = _coordinator;
+        }
+        
+        /**
+         * Returns the coordinator
          * 
-         * @param _numTrainingSamples 
+         * @return coordinator
          */
-        void setNumTrainingSamples(int _numTrainingSamples)
+        Coordinator::ptr getCoordinator()
         {
-            numTrainingSamples = _numTrainingSamples;
+            return coordinator;
         }
         
         /**
-         * Returns the number of training samples per DAG
+         * Sets the feature columns, e.g. feature shards or an out-of-core column store. The training set then only 
+         * has to hold the class labels and the DAGs are trained one after another. 
          * 
-         * @return Number of training samples per DAG
+         * @param _featureColumns
          */
-        int getNumTrainingSamples()
+        void setFeatureColumns(FeatureColumns::ptr _featureColumns)
         {
-            return numTrainingSamples;
+            featureColumns = _featureColumns;
         }
         
         /**
-         * Sets the number of dags to train
+         * Returns the feature columns
          * 
-         * @param _numDAGs
+         * @return feature columns
          */
-        void setNumDAGs(int _numDAGs)
+        FeatureColumns::ptr getFeatureColumns()
         {
-            numDAGs = _numDAGs;
+            return featureColumns;
         }
         
         /**
-         * Returns the number of DAGs to train
+         * Sets the maximum number of bins per feature. The features are then quantized once before training and the 
+         * thresholds are searched on the class histograms of the bins. 0 disables binning
          * 
-         * @return number of dags to train
+         * @param _featureBinCount
          */
-        int getNumDAGs()
+        void setFeatureBinCount(int _featureBinCount)
         {
-            return numDAGs;
+            featureBinCount = _featureBinCount;
         }
         
         /**
-         * Sets maxParallel
+         * Returns the maximum number of bins per feature
          * 
-         * @param _maxParallel
+         * @return number of bins
          */
-        void setMaxParallel(int _maxParallel)
+        int getFeatureBinCount() const
         {
-            maxParallel = _maxParallel;
+            return featureBinCount;
         }
         
         /**
-         * Returns maxParallel
+         * Returns the seed of the DAG with the given index. If there is no seed, the seeds continue from a random seed 
+         * that is drawn at the start of train(). 
          * 
-         * @return maxParallel
+         * @param _index The index of the DAG
+         * @return seed of the DAG
          */
-        int getMaxParallel() const 
+        unsigned int getDAGSeed(int _index);
+        
+        /**
+         * Creates the trainer of a single DAG. The bagging weights and the seed of the DAG trainer only depend on 
+         * the seed of the DAG, hence every process that uses the same settings trains the same DAG. 
+         * 
+         * @param _trainingSet The training set
+         * @param _dagSeed The seed of the DAG, see getDAGSeed()
+         * @param _weights Output: The bagging weights. Empty if bagging is disabled
+         * @return new DAG trainer. The caller must delete it
+         */
+        DAGTrainer::ptr createDAGTrainer(TrainingSet::ptr _trainingSet, unsigned int _dagSeed, std::vector<int> & _weights);
+        
+        /**
+         * Returns the out-of-bag estimate of the last training run. This is empty if there was no estimation. 
+         * 
+         * @return out-of-bag estimate
+         */
+        OutOfBagEstimate::ptr getOutOfBagEstimate()
         {
-            return maxParallel;
+            return outOfBagEstimate;
         }
         
         /**
@@ -867,6 +2411,7 @@ namespace LibJungle {
     /**
      * Calculates the entropy for an entire row of nodes
      */
+    template <class Criterion>
     class RowEntropyErrorFunction {
     private:
         /**
@@ -911,27 +2456,64 @@ namespace LibJungle {
         {
             float result = 0.;
 
-            // Determine the complete data count over all nodes
-            int dataCount = 0;
+            // Determine the complete data count over all nodes. The histogram mass includes the example weights
+            Count dataCount = 0;
             for (NodeRow::iterator it = row.begin(); it != row.end(); ++it)
             {
-                dataCount += static_cast<int>((*it)->getTrainingSet()->size());
+                dataCount += (*it)->getClassHistogram()->getMass();
             }
             
             for (NodeRow::iterator it = row.begin(); it != row.end(); ++it)
             {
-                 result += static_cast<float>( (*it)->getTrainingSet()->size()) / static_cast<float>(dataCount) * (*it)->getClassHistogram()->entropy();
+                 result += static_cast<float>((*it)->getClassHistogram()->getMass()) / dataCount * (*it)->getClassHistogram()->impurity<Criterion>();
             }
 
             return result;
         }
     };
     
+    /**
+     * Selects the histogram types for the error functions. Bins is the compile-time number of bins or 0 if the
+     * number of bins is only known at run time. 
+     */
+    template <int Bins, class Criterion>
+    class HistogramTypes {
+    public:
+        typedef FixedClassHistogram<Bins> Histogram;
+        typedef FixedEntropyHistogram<Bins, Criterion> EntropyHistogram;
+    };
+    
+    template <class Criterion>
+    class HistogramTypes<0, Criterion> {
+    public:
+        typedef ClassHistogram Histogram;
+        typedef EfficientEntropyHistogram<Criterion> EntropyHistogram;
+    };
+    
+    /**
+     * Returns the number of compile-time bins that shall be used for a certain class count. This is the next power 
+     * of two up to 32, or 0 if the histograms shall be sized at run time. 
+     * 
+     * @param _classCount The number of classes
+     * @return number of bins
+     */
+    inline int selectHistogramBins(int _classCount)
+    {
+        for (int bins = 2; bins <= 32; bins *= 2)
+        {
+            if (_classCount <= bins) return bins;
+        }
+        return 0;
+    }
+    
     /**
      * Calculates the entropy error based on a child row
      */
+    template <int Bins, class Criterion>
     class ChildRowEntropyErrorFunction {
     private:
+        typedef typename HistogramTypes<Bins, Criterion>::Histogram Histogram;
+        
         /**
          * The row of nodes
          */
@@ -982,16 +2564,16 @@ namespace LibJungle {
             int classCount = (*row.begin())->getClassHistogram()->size();
             
             // We build up a histogram for every (virtual) child node
-            ClassHistogram* histograms = new ClassHistogram[childNodeCount];
+            Histogram* histograms = new Histogram[childNodeCount];
             
             // Initialize the histograms
             for (int i = 0; i < childNodeCount; i++)
             {
-                histograms[i].resize(classCount);
+                histograms[i].resizeAdaptive(classCount);
             }
 
             // We store the total data count in order to calculate the weighted entropy correctly
-            int dataCount = 0;
+            Count dataCount = 0;
 
             // Compute the histograms for all child nodes
             for (NodeRow::iterator it = row.begin(); it != row.end(); ++it)
@@ -1002,11 +2584,8 @@ namespace LibJungle {
                 ClassHistogram* rightHistogram = (*it)->getRightHistogram();
 
                 // Add the values to the histogram
-                for (int i = 0; i < classCount; i++)
-                {
-                    histograms[leftNode].add(i, leftHistogram->at(i));
-                    histograms[rightNode].add(i, rightHistogram->at(i));
-                }
+                histograms[leftNode].add(*leftHistogram);
+                histograms[rightNode].add(*rightHistogram);
 
                 dataCount += leftHistogram->getMass() + rightHistogram->getMass();
             }
@@ -1014,7 +2593,7 @@ namespace LibJungle {
             // Calculate the entropy based on the built up histograms
             for (int i = 0; i < childNodeCount; i++)
             {
-                result += histograms[i].getMass()/static_cast<float>(dataCount) * histograms[i].entropy();
+                result += histograms[i].getMass()/static_cast<float>(dataCount) * histograms[i].template impurity<Criterion>();
             }
 
             delete[] histograms;
@@ -1026,41 +2605,76 @@ namespace LibJungle {
     /**
      * Calculates the entropy error based on a child row
      */
+    template <int Bins, class Criterion>
     class ThresholdEntropyErrorFunction {
     private:
+        typedef typename HistogramTypes<Bins, Criterion>::Histogram Histogram;
+        typedef typename HistogramTypes<Bins, Criterion>::EntropyHistogram EntropyHistogram;
+        
         /**
          * The row of nodes
          */
-        NodeRow & row;
+        NodeRow* row;
         /**
          * The parent node that we optimize
          */
         TrainingDAGNode::ptr parent;
+        /**
+         * The class histogram of the node that we optimize
+         */
+        const ClassHistogram* nodeHistogram;
         /**
          * The left histogram base
          */
-        ClassHistogram leftHistogram;
+        Histogram leftHistogram;
         /**
          * The left histogram base
          */
-        ClassHistogram rightHistogram;
+        Histogram rightHistogram;
         /**
          * Current left/right histogram
          */
-        EfficientEntropyHistogram cleftHistogram;
-        EfficientEntropyHistogram crightHistogram;
+        EntropyHistogram cleftHistogram;
+        EntropyHistogram crightHistogram;
         
     public:
         /**
          * Default constructor
          * @return 
          */
-        ThresholdEntropyErrorFunction (NodeRow & _row, TrainingDAGNode::ptr parent) : row(_row), parent(parent) {}
+        ThresholdEntropyErrorFunction (NodeRow & _row, TrainingDAGNode::ptr parent) : row(&_row), parent(parent), 
+                nodeHistogram(parent->getClassHistogram()) {}
+        
+        /**
+         * Creates the error function of a node whose base histograms are already known. This is used by feature
+         * columns, which don't know the other nodes of the row. 
+         * 
+         * @param _leftBase The left histogram base
+         * @param _rightBase The right histogram base
+         * @param _nodeHistogram The class histogram of the node. It must outlive the error function
+         * @param _table The n log2(n) table
+         */
+        ThresholdEntropyErrorFunction (const ClassHistogram & _leftBase, const ClassHistogram & _rightBase, 
+                const ClassHistogram & _nodeHistogram, const NLogNTable & _table) : row(0), parent(0), nodeHistogram(&_nodeHistogram)
+        {
+            int classCount = _nodeHistogram.size();
+            
+            leftHistogram.resizeAdaptive(classCount);
+            rightHistogram.resizeAdaptive(classCount);
+            cleftHistogram.resize(classCount);
+            crightHistogram.resize(classCount);
+            cleftHistogram.setTable(_table);
+            crightHistogram.setTable(_table);
+            
+            leftHistogram.add(_leftBase);
+            rightHistogram.add(_rightBase);
+        }
         
         /**
          * Copy constructor
          */
-        ThresholdEntropyErrorFunction (const ThresholdEntropyErrorFunction & other) : row(other.row), parent(other.parent) {}
+        ThresholdEntropyErrorFunction (const ThresholdEntropyErrorFunction & other) : row(other.row), parent(other.parent), 
+                nodeHistogram(other.nodeHistogram) {}
         
         /**
          * Assignment operator
@@ -1072,6 +2686,7 @@ namespace LibJungle {
             {
                 row = other.row;
                 parent = other.parent;
+                nodeHistogram = other.nodeHistogram;
             }
             return *this;
         }
@@ -1086,15 +2701,17 @@ namespace LibJungle {
          */
         void initHistograms()
         {
-            int classCount = (*row.begin())->getClassHistogram()->size();
+            int classCount = (*row->begin())->getClassHistogram()->size();
 
-            leftHistogram.resize(classCount);
-            rightHistogram.resize(classCount);
+            leftHistogram.resizeAdaptive(classCount);
+            rightHistogram.resizeAdaptive(classCount);
             cleftHistogram.resize(classCount);
             crightHistogram.resize(classCount);
+            cleftHistogram.setTable(parent->getTrainer()->getNLogNTable());
+            crightHistogram.setTable(parent->getTrainer()->getNLogNTable());
 
             // Compute the histograms for all child nodes
-            for (NodeRow::iterator it = row.begin(); it != row.end(); ++it)
+            for (NodeRow::iterator it = row->begin(); it != row->end(); ++it)
             {
                 // Skip the parent node
                 if (*it == parent) continue;
@@ -1107,45 +2724,30 @@ namespace LibJungle {
                 if (leftNode == parent->getTempLeft())
                 {
                     // Add the values to the histogram
-                    for (int i = 0; i < classCount; i++)
-                    {
-                        leftHistogram.add(i, _leftHistogram->at(i));
-                    }
+                    leftHistogram.add(*_leftHistogram);
                 }
                 if (leftNode == parent->getTempRight())
                 {
                     // Add the values to the histogram
-                    for (int i = 0; i < classCount; i++)
-                    {
-                        rightHistogram.add(i, _leftHistogram->at(i));
-                    }
+                    rightHistogram.add(*_leftHistogram);
                 }
 
                 if (rightNode == parent->getTempLeft())
                 {
                     // Add the values to the histogram
-                    for (int i = 0; i < classCount; i++)
-                    {
-                        leftHistogram.add(i, _rightHistogram->at(i));
-                    }
+                    leftHistogram.add(*_rightHistogram);
                 }
                 if (leftNode == parent->getTempRight())
                 {
                     // Add the values to the histogram
-                    for (int i = 0; i < classCount; i++)
-                    {
-                        rightHistogram.add(i, _rightHistogram->at(i));
-                    }
+                    rightHistogram.add(*_rightHistogram);
                 }
             }
             
-            for (int i = 0; i < leftHistogram.size(); i++)
-            {
-                cleftHistogram.set(i, leftHistogram.at(i) + parent->getLeftHistogram()->at(i));
-                crightHistogram.set(i, rightHistogram.at(i) + parent->getRightHistogram()->at(i));
-            }
-            cleftHistogram.initEntropies();
-            crightHistogram.initEntropies();
+            cleftHistogram.add(leftHistogram);
+            cleftHistogram.add(*parent->getLeftHistogram());
+            crightHistogram.add(rightHistogram);
+            crightHistogram.add(*parent->getRightHistogram());
         }
         
         /**
@@ -1156,23 +2758,179 @@ namespace LibJungle {
             cleftHistogram.reset();
             crightHistogram.reset();
             
-            // Initialize the histograms
-            for (int i = 0; i < leftHistogram.size(); i++)
+            // Initialize the histograms. Only the occupied bins are touched
+            cleftHistogram.add(leftHistogram);
+            crightHistogram.add(rightHistogram);
+            crightHistogram.add(*nodeHistogram);
+        }
+        
+        /**
+         * Returns the left and right histogram bases as dense vectors
+         * 
+         * @param _left The left histogram base
+         * @param _right The right histogram base
+         */
+        void getBaseHistograms(std::vector<Count> & _left, std::vector<Count> & _right) const
+        {
+            _left.assign(nodeHistogram->size(), 0);
+            _right.assign(nodeHistogram->size(), 0);
+            leftHistogram.forEach([&_left](int i, Count c) { _left[i] = c; });
+            rightHistogram.forEach([&_right](int i, Count c) { _right[i] = c; });
+        }
+        
+        /**
+         * Tests all thresholds of a feature. The examples must be sorted by this feature. 
+         * 
+         * @param _examples The training examples of the node
+         * @param _size The number of training examples
+         * @param _feature The feature
+         * @param _bestError The error to beat. It is updated if a better threshold is found
+         * @param _bestThreshold The best threshold is stored here
+         * @return true if a threshold with a smaller error was found
+         */
+        bool sweep(const WeightedExample* _examples, size_t _size, int _feature, float & _bestError, float & _bestThreshold)
+        {
+            bool found = false;
+            
+            // Initialize the virtual left/right histograms
+            resetHistograms();
+            
+            // Test all possible splits
+            for (size_t j = 0; j + 1 < _size; j++)
+            {
+                TrainingExample* it = _examples[j].example;
+                TrainingExample* itp1 = _examples[j+1].example;
+                
+                if (advance(it->getClassLabel(), _examples[j].weight, it->getDataPoint()->at(_feature), 
+                        itp1->getDataPoint()->at(_feature), _bestError, _bestThreshold))
+                {
+                    found = true;
+                }
+            }
+            
+            return found;
+        }
+        
+        /**
+         * Tests all thresholds of a presorted feature column
+         * 
+         * @param _examples The column entries of the node
+         * @param _size The number of entries
+         * @param _bestError The error to beat. It is updated if a better threshold is found
+         * @param _bestThreshold The best threshold is stored here
+         * @return true if a threshold with a smaller error was found
+         */
+        bool sweep(const SortedExample* _examples, size_t _size, float & _bestError, float & _bestThreshold)
+        {
+            bool found = false;
+            
+            // Initialize the virtual left/right histograms
+            resetHistograms();
+            
+            for (size_t j = 0; j + 1 < _size; j++)
+            {
+                if (advance(_examples[j].classLabel, _examples[j].weight, _examples[j].value, _examples[j + 1].value, 
+                        _bestError, _bestThreshold))
+                {
+                    found = true;
+                }
+            }
+            
+            return found;
+        }
+        
+        /**
+         * Tests the thresholds between the bins of a feature. Only the class histograms of the bins are visited. 
+         * 
+         * @param _histograms The class histogram of every bin of the node, one after another
+         * @param _binCount The number of bins
+         * @param _thresholds The thresholds between the bins
+         * @param _bestError The error to beat. It is updated if a better threshold is found
+         * @param _bestThreshold The best threshold is stored here
+         * @return true if a threshold with a smaller error was found
+         */
+        bool sweep(const Count* _histograms, int _binCount, const float* _thresholds, float & _bestError, float & _bestThreshold)
+        {
+            bool found = false;
+            const int classCount = nodeHistogram->size();
+            
+            // Initialize the virtual left/right histograms
+            resetHistograms();
+            
+            // The right child node must not become empty
+            int lastBin = _binCount - 1;
+            while (lastBin > 0 && std::all_of(_histograms + lastBin * classCount, _histograms + (lastBin + 1) * classCount, 
+                    [](Count c) { return c == 0; }))
+            {
+                lastBin--;
+            }
+            
+            for (int b = 0; b < lastBin; b++)
+            {
+                const Count* bin = _histograms + b * classCount;
+                bool occupied = false;
+                for (int c = 0; c < classCount; c++)
+                {
+                    if (bin[c] != 0)
+                    {
+                        move(c, bin[c]);
+                        occupied = true;
+                    }
+                }
+                
+                // An empty bin doesn't change the error
+                if (!occupied) continue;
+                
+                const float currentError = error();
+                if (currentError < _bestError)
+                {
+                    _bestThreshold = _thresholds[b];
+                    _bestError = currentError;
+                    found = true;
+                }
+            }
+            
+            return found;
+        }
+        
+        /**
+         * Moves the next example of a sweep to the left histogram and tests the threshold between its value and the 
+         * value of the example after it. This allows to sweep over examples that are not in memory. 
+         * 
+         * @param _classLabel The class label of the example
+         * @param _weight The weight of the example
+         * @param _value The feature value of the example
+         * @param _nextValue The feature value of the next example
+         * @param _bestError The error to beat. It is updated if the threshold is better
+         * @param _bestThreshold The threshold is stored here if it is better
+         * @return true if the threshold has a smaller error
+         */
+        bool advance(int _classLabel, int _weight, float _value, float _nextValue, float & _bestError, float & _bestThreshold)
+        {
+            // Update the histograms
+            move(_classLabel, _weight);
+            
+            // Get the current entropy
+            const float currentError = error();
+            
+            // Only accept the split if the entropy decreases and the threshold is not insignificant
+            if (currentError < _bestError && (_nextValue - _value) >= 1e-6)
             {
-                cleftHistogram.set(i, leftHistogram.at(i));
-                crightHistogram.set(i, rightHistogram.at(i) + parent->getClassHistogram()->at(i));
+                // Choose the threshold as value between the two adjacent elements
+                _bestThreshold = (_value + _nextValue) / 2;
+                _bestError = currentError;
+                return true;
             }
-            cleftHistogram.initEntropies();
-            crightHistogram.initEntropies();
+            return false;
         }
         
         /**
-         * Moves one training example from the right to the left histogram
+         * Moves one training example with the given weight from the right to the left histogram
          */
-        void move(int classLabel)
+        void move(int classLabel, Count weight)
         {
-            cleftHistogram.addOne(classLabel);
-            crightHistogram.subOne(classLabel);
+            cleftHistogram.addWeighted(classLabel, weight);
+            crightHistogram.subWeighted(classLabel, weight);
         }
         
         /**
@@ -1180,15 +2938,18 @@ namespace LibJungle {
          */
         float error() const
         {
-            return  1/(cleftHistogram.getMass() + crightHistogram.getMass()) * (cleftHistogram.entropy() + crightHistogram.entropy());
+            return  1/static_cast<float>(cleftHistogram.getMass() + crightHistogram.getMass()) * (cleftHistogram.entropy() + crightHistogram.entropy());
         }
     };
     
     /**
      * Calculates the entropy error based on a child row
      */
+    template <int Bins, class Criterion>
     class AssignmentEntropyErrorFunction {
     private:
+        typedef typename HistogramTypes<Bins, Criterion>::Histogram Histogram;
+        
         /**
          * The row of nodes
          */
@@ -1200,9 +2961,9 @@ namespace LibJungle {
         /**
          * All child node histograms and data counts
          */
-        ClassHistogram* histograms;
+        Histogram* histograms;
         float* entropies;
-        int dataCount;
+        Count dataCount;
         
         /**
          * Number of child nodes
@@ -1254,11 +3015,11 @@ namespace LibJungle {
 
             dataCount = 0;
             // We build up a histogram for every (virtual) child node
-            histograms = new ClassHistogram[childNodeCount];
+            histograms = new Histogram[childNodeCount];
             // Initialize the histograms
             for (int i = 0; i < childNodeCount; i++)
             {
-                histograms[i].resize(classCount);
+                histograms[i].resizeAdaptive(classCount);
             }
 
             // Compute the histograms for all child nodes
@@ -1275,11 +3036,8 @@ namespace LibJungle {
                 if (*it == parent) continue;
 
                 // Add the values to the histogram
-                for (int i = 0; i < classCount; i++)
-                {
-                    histograms[leftNode].add(i, leftHistogram->at(i));
-                    histograms[rightNode].add(i, rightHistogram->at(i));
-                }
+                histograms[leftNode].add(*leftHistogram);
+                histograms[rightNode].add(*rightHistogram);
             }
 
             // Calculate the entropies based on the built up histograms
@@ -1287,7 +3045,7 @@ namespace LibJungle {
 
             for (int i = 0; i < childNodeCount; i++)
             {
-                entropies[i] = histograms[i].entropy();
+                entropies[i] = histograms[i].template impurity<Criterion>();
             }
         }
         
@@ -1304,24 +3062,24 @@ namespace LibJungle {
                 {
                     ClassHistogram* leftHistogram = parent->getLeftHistogram();
 
-                    error += leftHistogram->getMass(histograms[i])/dataCount * leftHistogram->entropy(histograms[i]);
+                    error += static_cast<float>(histograms[i].getMass(*leftHistogram))/dataCount * histograms[i].template impurity<Criterion>(*leftHistogram);
                 }
                 else if (i == parent->getTempRight() && i != parent->getTempLeft())
                 {
                     ClassHistogram* rightHistogram = parent->getRightHistogram();
 
-                    error += rightHistogram->getMass(histograms[i])/dataCount * rightHistogram->entropy(histograms[i]);
+                    error += static_cast<float>(histograms[i].getMass(*rightHistogram))/dataCount * histograms[i].template impurity<Criterion>(*rightHistogram);
                 }
                 else if (i == parent->getTempRight() && i == parent->getTempLeft())
                 {
                     ClassHistogram* leftHistogram = parent->getLeftHistogram();
                     ClassHistogram* rightHistogram = parent->getRightHistogram();
 
-                    error += rightHistogram->getMass(histograms[i], *leftHistogram)/dataCount * rightHistogram->entropy(histograms[i], *leftHistogram);
+                    error += static_cast<float>(histograms[i].getMass(*rightHistogram, *leftHistogram))/dataCount * histograms[i].template impurity<Criterion>(*rightHistogram, *leftHistogram);
                 }
                 else
                 {
-                    error += histograms[i].getMass()/dataCount * entropies[i];
+                    error += static_cast<float>(histograms[i].getMass())/dataCount * entropies[i];
                 }
             }
 
@@ -1382,6 +3140,18 @@ namespace LibJungle {
             return (lhs->getDataPoint()->at(featureDimension) < rhs->getDataPoint()->at(featureDimension));
         }
         
+        /**
+         * Compares two entries of an example index
+         * 
+         * @param lhs
+         * @param rhs
+         * @return whether or not a[f] < b[f]
+         */
+        bool operator() (const WeightedExample & lhs, const WeightedExample & rhs)
+        {
+            return (lhs.example->getDataPoint()->at(featureDimension) < rhs.example->getDataPoint()->at(featureDimension));
+        }
+        
         /**
          * Factory class for TrainingExampleComparator
          */
@@ -1434,16 +3204,45 @@ namespace LibJungle {
          * @param _trainingSet The training set
          */
         static void computHistogram(ClassHistogram & _hist, TrainingSet::ptr _trainingSet)
+        {
+            computHistogram(_hist, _trainingSet->data(), _trainingSet->data() + _trainingSet->size());
+        }
+        
+        /**
+         * Computes a histogram from a range of training examples. The histogram must already be set up correctly. 
+         * 
+         * @param _hist The histogram
+         * @param _begin The first training example
+         * @param _end The end of the range
+         */
+        static void computHistogram(ClassHistogram & _hist, TrainingExample::ptr* _begin, TrainingExample::ptr* _end)
+        {
+            // Initialize the histogram
+            _hist.reset();
+            
+            // Compute the histogram
+            for(TrainingExample::ptr* it = _begin; it != _end; ++it)
+            {
+                _hist.add((*it)->getClassLabel(), 1);
+            }
+        }
+        
+        /**
+         * Computes a histogram from a range of an example index. Every example contributes its weight. 
+         * 
+         * @param _hist The histogram
+         * @param _begin The first entry
+         * @param _end The end of the range
+         */
+        static void computHistogram(ClassHistogram & _hist, WeightedExample* _begin, WeightedExample* _end)
         {
             // Initialize the histogram
             _hist.reset();
             
             // Compute the histogram
-            const size_t trainingSetSize = _trainingSet->size();
-            for(size_t i = 0; i < trainingSetSize; i++)
+            for(WeightedExample* it = _begin; it != _end; ++it)
             {
-                TrainingExample* current = _trainingSet->at(i);
-                _hist.add(current->getClassLabel(), 1);
+                _hist.add(it->example->getClassLabel(), it->weight);
             }
         }
         
@@ -1455,19 +3254,17 @@ namespace LibJungle {
          */
         static ClassLabel histogramArgMax(const ClassHistogram & _hist)
         {
-            int classCount = _hist.size();
             ClassLabel bestClassLabel = -1;
-            int bestScore = 0;
+            Count bestScore = 0;
             
-            // Initialize the histogram
-            for (int i = 0; i < classCount; i++)
-            {
-                if (_hist.at(i) > bestScore)
+            // Only the occupied bins can be the arg max
+            _hist.forEach([&bestClassLabel, &bestScore](int i, Count c) {
+                if (c > bestScore)
                 {
                     bestClassLabel = i;
-                    bestScore = _hist.at(i);
+                    bestScore = c;
                 }
-            }
+            });
             
             return bestClassLabel;
         }
@@ -1478,18 +3275,14 @@ namespace LibJungle {
          * @param _hist The class histogram
          * @return The mode of the distribution
          */
-        static int histogramMax(const ClassHistogram & _hist)
+        static Count histogramMax(const ClassHistogram & _hist)
         {
-            int bestScore = 0;
+            Count bestScore = 0;
             
-            // Initialize the histogram
-            for (int i = _hist.begin(); i != _hist.end(); ++i)
-            {
-                if (_hist.at(i) > bestScore)
-                {
-                    bestScore = _hist.at(i);
-                }
-            }
+            // Only the occupied bins can be the max
+            _hist.forEach([&bestScore](int, Count c) {
+                bestScore = std::max(bestScore, c);
+            });
             
             return bestScore;
         }
@@ -1514,27 +3307,25 @@ namespace LibJungle {
          */
         static bool histogramIsAlmostDirichlet(const ClassHistogram & _hist, int _threshold)
         {
-            bool foundPeak = false;
+            int peaks = 0;
             
-            // Initialize the histogram
-            for (int i = _hist.begin(); i != _hist.end(); ++i)
+            // Empty bins are never peaks for non negative thresholds, so we only need to look at the occupied bins
+            if (_threshold >= 0)
+            {
+                _hist.forEach([&peaks, _threshold](int, Count c) {
+                    if (c > _threshold) peaks++;
+                });
+            }
+            else
             {
-                if (_hist.at(i) > _threshold)
+                for (int i = _hist.begin(); i != _hist.end(); ++i)
                 {
-                    // If this is the first peak, there is no problem
-                    if (!foundPeak)
-                    {
-                        foundPeak = true;
-                    }
-                    else
-                    {
-                        // This is the second peak, this is no dirichlet distribution
-                        return false;
-                    }
+                    if (_hist.at(i) > _threshold) peaks++;
                 }
             }
             
-            return true;
+            // A second peak means that this is no dirichlet distribution
+            return peaks <= 1;
         }
     };
     
@@ -1581,6 +3372,124 @@ namespace LibJungle {
             }
         };
     };
+    
+    /**
+     * Refits the leaves of an existing jungle to new data. Every example is routed through every DAG and the leaf
+     * histograms and class labels are replaced by the fresh counts. The structure of the DAGs (features and
+     * thresholds) is kept. 
+     */
+    class JungleRefitter {
+    private:
+        /**
+         * The weight of the old leaf counts. The new leaf histogram is given by the fresh counts plus the old counts
+         * times this weight. A weight of 0 discards the old counts. 
+         */
+        float oldCountWeight;
+        
+        /**
+         * The maximum number of DAGs that are refitted in parallel
+         */
+        int maxParallel;
+        
+        /**
+         * The number of leaves of the last refitted jungle
+         */
+        int leafCount;
+        
+        /**
+         * Refits a single compact DAG
+         * 
+         * @param _root The root node of the compact DAG
+         * @param _trainingSet The new data
+         * @param _classCount The number of classes of the refitted leaves
+         * @param _arena The arena for the new leaf histograms
+         * @return The number of leaves that were reached by the new data
+         */
+        int refitDAG(DAGNode::ptr _root, TrainingSet::ptr _trainingSet, int _classCount, MemoryArena & _arena);
+        
+    public:
+        typedef JungleRefitter self;
+        typedef std::shared_ptr<self> ptr;
+        
+        JungleRefitter() : oldCountWeight(0), maxParallel(1), leafCount(0) {}
+        
+        /**
+         * Returns the weight of the old leaf counts
+         * 
+         * @return old count weight
+         */
+        float getOldCountWeight() const
+        {
+            return oldCountWeight;
+        }
+        
+        /**
+         * Sets the weight of the old leaf counts
+         * 
+         * @param _oldCountWeight The new weight
+         */
+        void setOldCountWeight(float _oldCountWeight)
+        {
+            oldCountWeight = _oldCountWeight;
+        }
+        
+        /**
+         * Returns the maximum number of DAGs that are refitted in parallel
+         * 
+         * @return max parallel
+         */
+        int getMaxParallel() const
+        {
+            return maxParallel;
+        }
+        
+        /**
+         * Sets the maximum number of DAGs that are refitted in parallel
+         * 
+         * @param _maxParallel The new number
+         */
+        void setMaxParallel(int _maxParallel)
+        {
+            maxParallel = _maxParallel;
+        }
+        
+        /**
+         * Returns the number of leaves of the last refitted jungle
+         * 
+         * @return leaf count
+         */
+        int getLeafCount() const
+        {
+            return leafCount;
+        }
+        
+        /**
+         * Refits all DAGs of a jungle. Leaves that are not reached by the new data keep their old counts and class 
+         * labels. The histograms of all leaves are resized to the classes of the jungle and of the new data. 
+         * 
+         * @param _jungle The jungle. It must have been loaded from a model file or trained by a JungleTrainer.
+         * @param _trainingSet The new data
+         * @return The number of leaves that were reached by the new data
+         * @throws RuntimeException If the leaves of the jungle have different numbers of classes
+         */
+        int refit(Jungle::ptr _jungle, TrainingSet::ptr _trainingSet) throw(RuntimeException);
+        
+        /**
+         * A factory for this class
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new refitter that discards the old counts
+             * 
+             * @return new refitter
+             */
+            static JungleRefitter::ptr create() 
+            {
+                return JungleRefitter::ptr(new self());
+            }
+        };
+    };
 }
 
 #endif
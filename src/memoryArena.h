@@ -0,0 +1,265 @@
+/**
+ * This file contains a simple region based memory allocator. All nodes and histograms of a DAG are allocated from
+ * one arena. This way, we don't need thousands of small heap allocations per DAG and the entire DAG can be released
+ * at once.
+ *
+ * @version 1.0
+ */
+#ifndef MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include "misc.h"
+
+#ifdef __linux__
+    #include <sys/mman.h>
+#endif
+
+namespace LibJungle
+{
+    /**
+     * A memory arena hands out memory from large chunks. Memory is never released individually but only when the
+     * arena is destroyed. Objects that are created in an arena don't have their destructors called.
+     */
+    class MemoryArena {
+    private:
+        /**
+         * A single chunk of memory
+         */
+        struct Chunk {
+            /**
+             * The start of the chunk
+             */
+            char* memory;
+
+            /**
+             * The size of the chunk in bytes
+             */
+            size_t size;
+
+            /**
+             * True if the chunk was allocated using mmap
+             */
+            bool mapped;
+        };
+
+        /**
+         * All chunks that were allocated by this arena
+         */
+        std::vector<Chunk> chunks;
+
+        /**
+         * The next free byte in the current chunk
+         */
+        char* current;
+
+        /**
+         * The number of free bytes in the current chunk
+         */
+        size_t remaining;
+
+        /**
+         * The default chunk size
+         */
+        size_t chunkSize;
+
+        /**
+         * Whether or not the chunks shall be backed by huge pages
+         */
+        bool useHugePages;
+
+        /**
+         * The huge page size on x86_64
+         */
+        static const size_t hugePageSize = 2 * 1024 * 1024;
+
+        /**
+         * Allocates a new chunk of at least _minSize bytes
+         *
+         * @param _minSize The minimum size of the chunk
+         */
+        void allocateChunk(size_t _minSize)
+        {
+            Chunk chunk;
+            chunk.size = std::max(_minSize, chunkSize);
+            chunk.mapped = false;
+            chunk.memory = 0;
+
+#ifdef __linux__
+            if (useHugePages)
+            {
+                // Round the chunk size up to a multiple of the huge page size and ask the kernel to back the chunk
+                // by transparent huge pages
+                chunk.size = (chunk.size + hugePageSize - 1) / hugePageSize * hugePageSize;
+                void* memory = mmap(0, chunk.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if (memory != MAP_FAILED)
+                {
+#ifdef MADV_HUGEPAGE
+                    madvise(memory, chunk.size, MADV_HUGEPAGE);
+#endif
+                    chunk.memory = static_cast<char*>(memory);
+                    chunk.mapped = true;
+                }
+            }
+#endif
+            // Fall back to the default allocator
+            if (chunk.memory == 0)
+            {
+                chunk.memory = static_cast<char*>(::operator new(chunk.size));
+            }
+
+            chunks.push_back(chunk);
+            current = chunk.memory;
+            remaining = chunk.size;
+        }
+
+        /**
+         * Arenas must not be copied
+         */
+        MemoryArena(const MemoryArena &);
+        MemoryArena & operator=(const MemoryArena &);
+
+    public:
+        typedef MemoryArena self;
+        typedef std::shared_ptr<self> ptr;
+
+        /**
+         * Default constructor
+         *
+         * @param _chunkSize The size of a single chunk in bytes
+         * @param _useHugePages Whether or not the chunks shall be backed by huge pages
+         */
+        MemoryArena(size_t _chunkSize, bool _useHugePages) :
+                current(0), remaining(0), chunkSize(_chunkSize), useHugePages(_useHugePages) {}
+
+        /**
+         * Destructor. Releases all chunks at once
+         */
+        ~MemoryArena()
+        {
+            release();
+        }
+
+        /**
+         * Allocates a block of uninitialized memory
+         *
+         * @param _size The size in bytes
+         * @param _alignment The alignment of the block. Must be a power of two
+         * @return Pointer to the allocated memory
+         */
+        void* allocate(size_t _size, size_t _alignment)
+        {
+            size_t padding = (_alignment - reinterpret_cast<size_t>(current) % _alignment) % _alignment;
+
+            if (current == 0 || padding + _size > remaining)
+            {
+                allocateChunk(_size + _alignment);
+                padding = (_alignment - reinterpret_cast<size_t>(current) % _alignment) % _alignment;
+            }
+
+            void* result = current + padding;
+            current += padding + _size;
+            remaining -= padding + _size;
+
+            return result;
+        }
+
+        /**
+         * Allocates a zero initialized array
+         *
+         * @param _count The number of elements
+         * @return Pointer to the first element
+         */
+        template <typename T>
+        T* allocateArray(size_t _count)
+        {
+            T* result = static_cast<T*>(allocate(_count * sizeof(T), alignof(T)));
+            std::memset(result, 0, _count * sizeof(T));
+            return result;
+        }
+
+        /**
+         * Creates a new default constructed object inside the arena
+         *
+         * @return Pointer to the object
+         */
+        template <typename T>
+        T* create()
+        {
+            return new (allocate(sizeof(T), alignof(T))) T();
+        }
+
+        /**
+         * Releases all memory that was allocated by this arena
+         */
+        void release()
+        {
+            for (std::vector<Chunk>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+            {
+#ifdef __linux__
+                if (it->mapped)
+                {
+                    munmap(it->memory, it->size);
+                    continue;
+                }
+#endif
+                ::operator delete(it->memory);
+            }
+            chunks.clear();
+            current = 0;
+            remaining = 0;
+        }
+
+        /**
+         * Returns the number of bytes that were reserved by this arena
+         *
+         * @return reserved bytes
+         */
+        size_t getReservedBytes() const
+        {
+            size_t result = 0;
+            for (std::vector<Chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+            {
+                result += it->size;
+            }
+            return result;
+        }
+
+        /**
+         * A factory for memory arenas
+         */
+        class Factory {
+        public:
+            /**
+             * Creates a new arena
+             *
+             * @param _useHugePages Whether or not the chunks shall be backed by huge pages
+             * @return new arena
+             */
+            static MemoryArena::ptr create(bool _useHugePages)
+            {
+                return MemoryArena::ptr(new MemoryArena(hugePageSize, _useHugePages));
+            }
+
+            /**
+             * Creates a new arena with a specific chunk size
+             *
+             * @param _chunkSize The size of a single chunk in bytes
+             * @param _useHugePages Whether or not the chunks shall be backed by huge pages
+             * @return new arena
+             */
+            static MemoryArena::ptr create(size_t _chunkSize, bool _useHugePages)
+            {
+                return MemoryArena::ptr(new MemoryArena(_chunkSize, _useHugePages));
+            }
+        };
+    };
+}
+
+#endif
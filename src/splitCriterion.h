@@ -0,0 +1,174 @@
+/**
+ * This file contains the split criteria that can be used to train a DAG. Every criterion is a policy class that is
+ * passed to the histograms and error functions as template parameter.
+ *
+ * An impurity criterion is determined by a term h(c) per class count c and a function that combines the sum of all
+ * terms with the mass S of the histogram. The error functions weight every impurity by its mass S.
+ *
+ * @version 1.0
+ */
+#ifndef SPLIT_CRITERION_H
+#define SPLIT_CRITERION_H
+
+#include "entropyKernels.h"
+
+namespace LibJungle
+{
+    /**
+     * The available split criteria
+     */
+    enum SplitCriterion {
+        SplitCriterionEntropy,
+        SplitCriterionGini
+    };
+
+    /**
+     * Shannon entropy: h(c) = c log2(c), I = log2(S) - 1/S sum_i h(c_i)
+     */
+    class EntropyCriterion {
+    public:
+        /**
+         * Returns the term of a single class count
+         */
+        static float term(float c)
+        {
+            return c * fastlog2(c);
+        }
+
+        /**
+         * Returns the term of a single class count for the incremental updates. The value is looked up in the table 
+         * or computed in double precision beyond the table, see NLogNTable
+         */
+        static double exactTerm(Count c, const NLogNTable & _table)
+        {
+            return _table.get(c);
+        }
+
+        /**
+         * Returns the sum of the terms over one, two or three histograms (bin wise sums)
+         */
+        static float sumTerms(const Count* a, int n)
+        {
+            return EntropyKernels::sumNLogN(a, n);
+        }
+        static float sumTerms(const Count* a, const Count* b, int n)
+        {
+            return EntropyKernels::sumNLogN(a, b, n);
+        }
+        static float sumTerms(const Count* a, const Count* b, const Count* c, int n)
+        {
+            return EntropyKernels::sumNLogN(a, b, c, n);
+        }
+
+        /**
+         * Returns the impurity of a histogram
+         *
+         * @param mass The mass of the histogram
+         * @param sum The sum of the terms
+         * @return impurity
+         */
+        static float impurity(float mass, float sum)
+        {
+            return EntropyKernels::entropy(mass, sum);
+        }
+
+        /**
+         * Returns the impurity of a histogram weighted by its mass based on the terms of exactTerm()
+         *
+         * @param mass The mass of the histogram
+         * @param sum The sum of the terms of exactTerm()
+         * @param _table The n log2(n) table
+         * @return weighted impurity
+         */
+        static float weightedImpurity(Count mass, double sum, const NLogNTable & _table)
+        {
+            if (mass < 1) return 0;
+            return static_cast<float>(_table.get(mass) - sum);
+        }
+    };
+
+    /**
+     * Gini impurity: h(c) = c^2, I = 1 - 1/S^2 sum_i h(c_i)
+     */
+    class GiniCriterion {
+    private:
+        /**
+         * Returns the sum of squares of the bin wise sums
+         */
+        template <int K>
+        static float sumSquares(const Count* a, const Count* b, const Count* c, int n)
+        {
+            float result = 0;
+            for (int i = 0; i < n; i++)
+            {
+                Count x = a[i];
+                if (K > 1) x += b[i];
+                if (K > 2) x += c[i];
+                result += static_cast<float>(x) * x;
+            }
+            return result;
+        }
+
+    public:
+        /**
+         * Returns the term of a single class count
+         */
+        static float term(float c)
+        {
+            return c * c;
+        }
+
+        /**
+         * Returns the term of a single class count for the incremental updates. The values are exact up to 2^26.
+         */
+        static double exactTerm(Count c, const NLogNTable &)
+        {
+            return static_cast<double>(c) * c;
+        }
+
+        /**
+         * Returns the sum of the terms over one, two or three histograms (bin wise sums)
+         */
+        static float sumTerms(const Count* a, int n)
+        {
+            return sumSquares<1>(a, 0, 0, n);
+        }
+        static float sumTerms(const Count* a, const Count* b, int n)
+        {
+            return sumSquares<2>(a, b, 0, n);
+        }
+        static float sumTerms(const Count* a, const Count* b, const Count* c, int n)
+        {
+            return sumSquares<3>(a, b, c, n);
+        }
+
+        /**
+         * Returns the impurity of a histogram
+         *
+         * @param mass The mass of the histogram
+         * @param sum The sum of the terms
+         * @return impurity
+         */
+        static float impurity(float mass, float sum)
+        {
+            if (mass < 1) return 0;
+            return 1 - sum / (mass * mass);
+        }
+
+        /**
+         * Returns the impurity of a histogram weighted by its mass based on the terms of exactTerm()
+         *
+         * @param mass The mass of the histogram
+         * @param sum The sum of the terms of exactTerm()
+         * @param _table Unused
+         * @return weighted impurity
+         */
+        static float weightedImpurity(Count mass, double sum, const NLogNTable &)
+        {
+            if (mass < 1) return 0;
+            return static_cast<float>(mass - sum / mass);
+        }
+    };
+}
+
+#endif
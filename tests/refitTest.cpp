@@ -0,0 +1,91 @@
+/**
+ * Refits a jungle with data that has more classes than the training set. All leaves must be resized to the new class
+ * count, such that the refitted model can be saved, loaded and merged.
+ *
+ * @version 1.0
+ */
+
+#include "jungle.h"
+#include "jungleTrain.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace LibJungle;
+
+#define CHECK(condition) \
+    if (!(condition)) \
+    { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+        return 1; \
+    }
+
+/**
+ * Writes a data set with two features. The class label depends on the first feature. If _lowerHalfOnly is set, only
+ * the lower half of the feature space is used, such that the new data does not reach every leaf.
+ *
+ * @param _fileName The file name
+ * @param _classCount The number of classes
+ * @param _lowerHalfOnly Whether or not the examples are restricted to the lower half of the feature space
+ */
+static void writeDataSet(const std::string & _fileName, int _classCount, bool _lowerHalfOnly)
+{
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<float> dist(0, _lowerHalfOnly ? 0.5f : 1.0f);
+
+    std::ofstream out(_fileName);
+    for (int i = 0; i < 600; i++)
+    {
+        const float x = dist(generator);
+        const float y = dist(generator);
+        const int label = std::min(_classCount - 1, static_cast<int>(x * _classCount * (_lowerHalfOnly ? 2 : 1)));
+        out << label << ',' << x << ',' << y << '\n';
+    }
+}
+
+int main()
+{
+    writeDataSet("refitTest_train.csv", 3, false);
+    writeDataSet("refitTest_new.csv", 5, true);
+
+    TrainingSet::ptr trainingSet = TrainingSet::Factory::createFromFile("refitTest_train.csv", false);
+    TrainingSet::ptr newData = TrainingSet::Factory::createFromFile("refitTest_new.csv", false);
+
+    JungleTrainer::ptr trainer = JungleTrainer::Factory::create();
+    trainer->setNumDAGs(2);
+    trainer->setMaxDepth(6);
+    trainer->setSeed(1);
+    trainer->setVerboseMode(false);
+    Jungle::ptr jungle = trainer->train(trainingSet);
+    delete trainer;
+    CHECK(jungle->getClassCount() == 3);
+
+    // The new data only reaches the leaves of the lower half
+    JungleRefitter::ptr refitter = JungleRefitter::Factory::create();
+    const int reachedLeaves = refitter->refit(jungle, newData);
+    CHECK(reachedLeaves > 0);
+    CHECK(reachedLeaves < refitter->getLeafCount());
+    CHECK(jungle->getClassCount() == 5);
+
+    // The refitted model can be loaded and merged
+    Jungle::Factory::serialize(jungle, "refitTest_model.txt");
+    Jungle::ptr loaded = Jungle::Factory::createFromFile("refitTest_model.txt", false);
+    CHECK(loaded->getClassCount() == 5);
+    CHECK(loaded->getDAGs().size() == 2);
+
+    std::vector<std::string> models(2, "refitTest_model.txt");
+    Jungle::ptr merged = Jungle::Factory::merge(models, 1);
+    CHECK(merged->getClassCount() == 5);
+    CHECK(merged->getDAGs().size() == 4);
+
+    TrainingSet::freeTrainingExamples(trainingSet);
+    TrainingSet::freeTrainingExamples(newData);
+    std::remove("refitTest_train.csv");
+    std::remove("refitTest_new.csv");
+    std::remove("refitTest_model.txt");
+
+    return 0;
+}
@@ -0,0 +1,188 @@
+/**
+ * Streams synthetic rows through the code that counts rows: the line count of the loaders and their progress bar, the
+ * error of a row of nodes and the out-of-bag counters. The rows are generated on the fly instead of being stored. In
+ * builds with wide counts (cmake -DDecisionJungle_WIDE_COUNTS=ON), more than 2^32 rows are streamed. The default
+ * build streams fewer rows, such that its 32 bit counts don't overflow.
+ *
+ * @version 1.0
+ */
+
+#include "jungle.h"
+#include "jungleTrain.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+using namespace LibJungle;
+
+#define CHECK(condition) \
+    if (!(condition)) \
+    { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+        return 1; \
+    }
+
+/**
+ * The number of streamed rows
+ */
+#if USE_WIDE_COUNTS
+static const RowIndex streamedRows = (1ULL << 32) + 6;
+#else
+static const RowIndex streamedRows = (1U << 24) + 6;
+#endif
+
+/**
+ * A stream buffer that generates empty lines
+ */
+class LineGenerator : public std::streambuf {
+private:
+    /**
+     * The number of lines that are not generated yet
+     */
+    RowIndex remaining;
+
+    /**
+     * The generated lines are handed out from this buffer
+     */
+    std::vector<char> buffer;
+
+protected:
+    virtual int_type underflow()
+    {
+        if (remaining == 0) return traits_type::eof();
+
+        const size_t count = static_cast<size_t>(std::min(remaining, static_cast<RowIndex>(buffer.size())));
+        remaining -= count;
+        setg(buffer.data(), buffer.data(), buffer.data() + count);
+        return traits_type::to_int_type(buffer[0]);
+    }
+
+public:
+    LineGenerator(RowIndex _lines) : remaining(_lines), buffer(1 << 20, '\n') {}
+};
+
+/**
+ * Generates the rows of a level with two nodes. The even rows go to the first node and are all of class 0, the odd
+ * rows go to the second node and alternate between the classes 0 and 1.
+ */
+class RowGenerator {
+private:
+    /**
+     * The next row
+     */
+    RowIndex row;
+
+public:
+    RowGenerator() : row(0) {}
+
+    /**
+     * Generates the next row
+     *
+     * @param _node The node of the row
+     * @param _label The class label of the row
+     * @return false if there are no more rows
+     */
+    bool next(int & _node, int & _label)
+    {
+        if (row == streamedRows) return false;
+
+        _node = static_cast<int>(row % 2);
+        _label = _node == 0 ? 0 : static_cast<int>((row / 2) % 2);
+        row++;
+        return true;
+    }
+};
+
+int main()
+{
+    // The loaders count the lines of their file before they read it
+    LineGenerator lines(streamedRows);
+    std::istream in(&lines);
+    const size_t lineCount = ProgressBar::countLines(in);
+    CHECK(lineCount == streamedRows);
+
+    ProgressBar::ptr progressBar = ProgressBar::Factory::create(lineCount);
+    progressBar->update(lineCount);
+
+    // The rows are counted in blocks, like a loader that streams its file
+    TrainingDAGNode first, second;
+    first.getClassHistogram()->resize(2);
+    second.getClassHistogram()->resize(2);
+    NodeRow level;
+    level.push_back(&first);
+    level.push_back(&second);
+
+    RowGenerator generator;
+    const RowIndex blockSize = 1 << 16;
+    Count counts[2][2] = {{0, 0}, {0, 0}};
+    RowIndex blockRows = 0;
+    auto addBlock = [&]() {
+        for (int n = 0; n < 2; n++)
+        {
+            for (int c = 0; c < 2; c++)
+            {
+                if (counts[n][c] > 0) level[n]->getClassHistogram()->add(c, counts[n][c]);
+                counts[n][c] = 0;
+            }
+        }
+        blockRows = 0;
+    };
+    
+    int node, label;
+    while (generator.next(node, label))
+    {
+        counts[node][label]++;
+        if (++blockRows == blockSize)
+        {
+            addBlock();
+        }
+    }
+    addBlock();
+
+    Count mass = first.getClassHistogram()->getMass() + second.getClassHistogram()->getMass();
+    CHECK(static_cast<RowIndex>(mass) == streamedRows);
+    mass = second.getClassHistogram()->at(1);
+    CHECK(static_cast<RowIndex>(mass) == streamedRows / 4);
+
+    // The first node is pure and the second one is balanced
+    RowEntropyErrorFunction<EntropyCriterion> error(level);
+    CHECK(std::abs(error.error() - 0.5f) < 1e-3f);
+
+    // The out-of-bag estimate keeps a vote histogram for every row, hence it only gets as many rows as fit into memory
+    TrainingSet::ptr trainingSet = TrainingSet::Factory::create();
+    const int rows = 1 << 12;
+    for (int i = 0; i < rows; i++)
+    {
+        TrainingExample::ptr example = TrainingExample::Factory::createZeroInitialized(1, i % 2);
+        example->getDataPoint()->at(0) = static_cast<float>(i % 2);
+        trainingSet->push_back(example);
+    }
+
+    JungleTrainer::ptr trainer = JungleTrainer::Factory::create();
+    trainer->setNumDAGs(1);
+    trainer->setMaxDepth(2);
+    trainer->setSeed(1);
+    trainer->setVerboseMode(false);
+    Jungle::ptr jungle = trainer->train(trainingSet);
+    delete trainer;
+    const DAGNode* dag = *jungle->getDAGs().begin();
+
+    // Half of the rows are out of bag
+    std::vector<int> weights(rows);
+    for (int i = 0; i < rows; i++)
+    {
+        weights[i] = i % 4 < 2 ? 1 : 0;
+    }
+    OutOfBagEstimate::ptr estimate = OutOfBagEstimate::Factory::create(trainingSet);
+    estimate->addDAG(dag, weights);
+    CHECK(estimate->getCoverage() == static_cast<RowIndex>(rows / 2));
+    CHECK(estimate->error() == 0);
+
+    estimate->addDAG(dag);
+    CHECK(estimate->getCoverage() == static_cast<RowIndex>(rows));
+    CHECK(estimate->error() == 0);
+
+    return 0;
+}
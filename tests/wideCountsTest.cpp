@@ -0,0 +1,72 @@
+/**
+ * Adds more than 2^32 examples to the class histograms. The counts and masses must not overflow in builds with wide
+ * counts (cmake -DDecisionJungle_WIDE_COUNTS=ON). The test is skipped in the default build. 
+ *
+ * @version 1.0
+ */
+
+#include "jungle.h"
+#include "jungleTrain.h"
+#include <cmath>
+#include <iostream>
+
+using namespace LibJungle;
+
+#define CHECK(condition) \
+    if (!(condition)) \
+    { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+        return 1; \
+    }
+
+/**
+ * The return code that tells ctest that the test has been skipped
+ */
+static const int SKIPPED = 77;
+
+int main()
+{
+#if USE_WIDE_COUNTS
+    const Count half = 3000000000LL;
+    
+    // Plain histograms sum the counts up exactly
+    ClassHistogram histogram(3);
+    histogram.add(0, half);
+    histogram.add(1, half);
+    histogram.addOne(2);
+    CHECK(histogram.at(0) == half);
+    Count mass = histogram.getMass();
+    CHECK(mass == 2 * half + 1);
+    mass = histogram.getMass(histogram);
+    CHECK(mass == 4 * half + 2);
+    CHECK(std::abs(histogram.impurity<EntropyCriterion>() - 1.0f) < 1e-3f);
+    
+    ClassHistogram other(3);
+    other.add(2, half);
+    histogram.add(other);
+    CHECK(histogram.at(2) == half + 1);
+    mass = histogram.getMass();
+    CHECK(mass == 3 * half + 1);
+    
+    // The row indices address all of these examples
+    CHECK(static_cast<RowIndex>(mass) > 0xFFFFFFFFULL);
+    
+    // The masses of the entropy histograms are used to weight the impurities
+    EfficientEntropyHistogram<EntropyCriterion> entropyHistogram(2);
+    entropyHistogram.addWeighted(0, half);
+    entropyHistogram.addWeighted(1, half);
+    mass = entropyHistogram.getMass();
+    CHECK(mass == 2 * half);
+    CHECK(std::abs(entropyHistogram.entropy() / static_cast<float>(2 * half) - 1.0f) < 1e-2f);
+    
+    entropyHistogram.subWeighted(1, half);
+    mass = entropyHistogram.getMass();
+    CHECK(mass == half);
+    CHECK(std::abs(entropyHistogram.entropy()) < 1e-2f * half);
+    
+    return 0;
+#else
+    std::cout << "Counts are 32 bit wide, configure with -DDecisionJungle_WIDE_COUNTS=ON" << std::endl;
+    return SKIPPED;
+#endif
+}